@@ -3,25 +3,45 @@ QT += core gui
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = app
 DEFINES += QT_DEPRECATED_WARNINGS
-CONFIG += c++14
+CONFIG += c++14 thread
 
 SOURCES += \
+        src/Controller.cpp \
         src/Cpu6502.cpp \
+        src/EmulationThread.cpp \
+        src/FramePacer.cpp \
         src/GamePak.cpp \
+        src/Mapper.cpp \
         src/Memory.cpp \
         src/NES.cpp \
         src/Ppu.cpp \
+        src/Rewind.cpp \
+        src/Movie.cpp \
+        src/RunAhead.cpp \
+        src/RomImage.cpp \
         src/main.cpp \
         src/mainwindow.cpp
 
 INCLUDEPATH += include/
 
 HEADERS += \
+    include/Controller.h \
     include/Cpu6502.h \
+    include/EmulationThread.h \
+    include/FramePacer.h \
     include/GamePak.h \
+    include/Mapper.h \
     include/Memory.h \
     include/NES.h \
     include/Ppu.h \
+    include/Rewind.h \
+    include/Movie.h \
+    include/RunAhead.h \
+    include/RomImage.h \
+    include/SaveState.hpp \
+    include/CowPages.hpp \
+    include/SpscQueue.hpp \
+    include/TripleBuffer.hpp \
     include/functions.hpp \
     include/mainwindow.h \
     include/nametableview.hpp \
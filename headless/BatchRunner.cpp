@@ -0,0 +1,94 @@
+#include "BatchRunner.h"
+#include "Output.h"
+#include "NES.h"
+#include "SaveState.hpp" // fnv1a
+#include "functions.hpp" // UNUSED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#define BATCH_PIN_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+BatchRunner::BatchRunner(const Options& options) : options(options) {}
+
+unsigned BatchRunner::workers() const {
+    if (options.workers)
+        return options.workers;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+BatchRunner::Summary BatchRunner::run(const std::vector<std::string>& roms, const std::function<void(const Result&)>& onResult) const {
+    Summary summary;
+    summary.roms = roms.size();
+    summary.workers = static_cast<unsigned>(std::min<size_t>(workers(), std::max<size_t>(roms.size(), 1)));
+    std::atomic<size_t> next{0};
+    std::mutex resultMutex;
+    auto work = [&](const unsigned& worker) {
+        pin(worker);
+        for (size_t i = next++; i < roms.size(); i = next++) {
+            const Result result = runRom(roms[i]);
+            std::lock_guard<std::mutex> lock(resultMutex);
+            summary.failed += !result.error.empty();
+            summary.frames += result.frames;
+            onResult(result);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned worker = 0; worker != summary.workers; ++worker) {
+        threads.emplace_back(work, worker);
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
+
+// Called by the worker itself so it never runs a frame off its core
+void BatchRunner::pin(const unsigned& worker) const {
+#ifdef BATCH_PIN_THREADS
+    if (!options.pin)
+        return;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+    UNUSED(worker);
+#endif
+}
+
+BatchRunner::Result BatchRunner::runRom(const std::string& rom) const {
+    Result result;
+    result.rom = rom;
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        std::shared_ptr<NES> nes = std::make_shared<NES>();
+        nes->init();
+        nes->load(rom);
+        nes->powerUp();
+        nes->videoOutput = options.video;
+        for (; result.frames != options.frames; ++result.frames)
+            nes->runFrame();
+        result.screenHash = screenHash(*nes);
+        const std::vector<uint8_t> state = nes->saveState();
+        result.stateHash = fnv1a(state.data(), state.size());
+        if (!options.screenshotDir.empty())
+            writeScreenshot(*nes, options.screenshotDir + "/" + nes->getBaseName() + ".ppm");
+    }
+    catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs many roms for a number of frames each on a fixed pool of worker threads
+// Every rom gets its own NES, nothing in the core is shared between them but the static read only
+// tables, so workers never wait on each other and throughput scales with the cores.
+// Workers take the next rom as soon as they're done with one, and each result is handed out the
+// moment its rom finishes.
+class BatchRunner {
+public:
+    struct Options {
+        uint64_t frames = 600;
+        unsigned workers = 0; // 0 is one per core
+        bool pin = false; // Pins worker n to core n (Linux only, ignored elsewhere)
+        bool video = true; // See NES::videoOutput
+        std::string screenshotDir; // Writes <rom name>.ppm of the last frame here if not empty
+    };
+
+    struct Result {
+        std::string rom;
+        std::string error; // Empty if the rom ran
+        uint64_t frames = 0;
+        double seconds = 0.0;
+        uint64_t screenHash = 0; // Of the last frame, see screenHash()
+        uint64_t stateHash = 0; // FNV-1a of the save state after the last frame
+    };
+
+    struct Summary {
+        size_t roms = 0;
+        size_t failed = 0;
+        unsigned workers = 0;
+        uint64_t frames = 0;
+        double seconds = 0.0; // Wall time of the whole batch
+    };
+
+    explicit BatchRunner(const Options& options);
+
+    // The worker count the options give on this machine
+    unsigned workers() const;
+    // Runs every rom, onResult is called from the worker that ran it but never from two at once
+    Summary run(const std::vector<std::string>& roms, const std::function<void(const Result&)>& onResult) const;
+    // Runs a single rom on the calling thread, errors end up in the result instead of being thrown
+    Result runRom(const std::string& rom) const;
+
+private:
+    Options options;
+    void pin(const unsigned& worker) const;
+};
+
+#endif // BATCHRUNNER_H
@@ -0,0 +1,39 @@
+#include "Output.h"
+#include "NES.h"
+#include "SaveState.hpp" // fnv1a
+
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+void writeScreenshot(const NES& nes, const std::string& fname) {
+    std::ofstream file(fname, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Cannot open " + fname);
+    file << "P6\n256 240\n255\n";
+    std::vector<char> pixels;
+    pixels.reserve(256 * 240 * 3);
+    for (const auto& row : nes.screen) {
+        for (const uint8_t& chroma : row) {
+            const uint32_t argb = Ppu::ARGBPaletteTable[chroma & 0x3F];
+            pixels.push_back(static_cast<char>((argb >> 16) & 0xFF));
+            pixels.push_back(static_cast<char>((argb >> 8) & 0xFF));
+            pixels.push_back(static_cast<char>(argb & 0xFF));
+        }
+    }
+    file.write(pixels.data(), static_cast<std::streamsize>(pixels.size()));
+    if (!file)
+        throw std::runtime_error("Cannot write " + fname);
+}
+
+void writeSaveState(const NES& nes, const std::string& fname) {
+    const std::vector<uint8_t> state = nes.saveState();
+    std::ofstream file(fname, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(state.data()), static_cast<std::streamsize>(state.size()));
+    if (!file)
+        throw std::runtime_error("Cannot write " + fname);
+}
+
+uint64_t screenHash(const NES& nes) {
+    return fnv1a(nes.screen[0].data(), sizeof(nes.screen));
+}
@@ -0,0 +1,17 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstdint>
+#include <string>
+
+class NES;
+
+// What the headless runner writes out of a nes, all throw if the file can't be written
+
+// The screen as a binary PPM (P6) image, 256x240
+void writeScreenshot(const NES& nes, const std::string& fname);
+void writeSaveState(const NES& nes, const std::string& fname);
+// FNV-1a of the screen's palette indices, the same picture always has the same hash
+uint64_t screenHash(const NES& nes);
+
+#endif // OUTPUT_H
@@ -0,0 +1,37 @@
+TEMPLATE = app
+TARGET = yanes-headless
+CONFIG += console c++14 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+        ../src/Cpu6502.cpp \
+        ../src/Controller.cpp \
+        ../src/Memory.cpp \
+        ../src/GamePak.cpp \
+        ../src/Mapper.cpp \
+        ../src/Ppu.cpp \
+        ../src/RomImage.cpp \
+        ../src/NES.cpp \
+        ../src/Movie.cpp \
+        Output.cpp \
+        BatchRunner.cpp \
+        main.cpp
+
+INCLUDEPATH += ../include/
+
+HEADERS += \
+    ../include/Cpu6502.h \
+    ../include/Controller.h \
+    ../include/Memory.h \
+    ../include/GamePak.h \
+    ../include/Mapper.h \
+    ../include/Ppu.h \
+    ../include/RomImage.h \
+    ../include/NES.h \
+    ../include/Movie.h \
+    ../include/SaveState.hpp \
+    ../include/CowPages.hpp \
+    ../include/functions.hpp \
+    Output.h \
+    BatchRunner.h
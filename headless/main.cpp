@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NES.h"
+#include "Movie.h"
+#include "Output.h"
+#include "BatchRunner.h"
+#include "functions.hpp" // UNUSED
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HEADLESS_LIST_DIRS
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Runs roms without a display as fast as it can and reports how fast the core went
+// This is what runs on machines without a screen, it only needs the core and a C++14 compiler
+
+static const char* const USAGE =
+    "USAGE: yanes-headless ROM... [OPTION]...\n"
+    "A single rom is run and timed in detail, several roms or a directory of them run as a batch\n"
+    "Allowed options:\n"
+    "  --frames N            Frames to run, 600 by default or the whole movie with --movie\n"
+    "  --movie FILE          Plays the input of a movie recorded from power on, the\n"
+    "                        controllers are left released after it ends (single rom)\n"
+    "  --screenshot FILE     Writes the last frame as a binary PPM image (single rom)\n"
+    "  --save-state FILE     Writes a save state after the last frame (single rom)\n"
+    "  --no-video            Doesn't draw pixels, for runs that only need the state\n"
+    "  --jobs N              Worker threads of a batch, one per core by default\n"
+    "  --pin                 Pins each worker of a batch to its own core (Linux only)\n"
+    "  --screenshot-dir DIR  Writes the last frame of every rom of a batch to DIR\n"
+    "  --scaling             Runs the batch with 1 worker up to --jobs and reports\n"
+    "                        the speedup of each\n"
+    "  --help                Produce help message\n";
+
+struct Options {
+    std::vector<std::string> roms;
+    bool batch = false;
+    uint64_t frames = 600;
+    bool framesGiven = false;
+    std::string movie;
+    std::string screenshot;
+    std::string saveState;
+    bool video = true;
+    unsigned jobs = 0;
+    bool pin = false;
+    std::string screenshotDir;
+    bool scaling = false;
+};
+
+static bool isDirectory(const std::string& path) {
+#ifdef HEADLESS_LIST_DIRS
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#else
+    UNUSED(path);
+    return false;
+#endif
+}
+
+// Every .nes file in the directory, sorted so batches always run in the same order
+static std::vector<std::string> listRoms(const std::string& dir) {
+    std::vector<std::string> roms;
+#ifdef HEADLESS_LIST_DIRS
+    DIR* handle = opendir(dir.c_str());
+    if (!handle)
+        throw std::runtime_error("Cannot open directory " + dir);
+    while (const dirent* entry = readdir(handle)) {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".nes") == 0)
+            roms.push_back(dir + "/" + name);
+    }
+    closedir(handle);
+#endif
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+static uint64_t parseNumber(const std::string& option, const std::string& number) {
+    if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos)
+        throw std::invalid_argument(option + " needs a number, given " + number);
+    return std::stoull(number);
+}
+
+static Options parseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        // Options that take a value
+        auto value = [&]() -> std::string {
+            if (i + 1 == argc)
+                throw std::invalid_argument(arg + " needs a value");
+            return argv[++i];
+        };
+        if (arg == "--help") {
+            std::cout << USAGE;
+            std::exit(EXIT_SUCCESS);
+        }
+        else if (arg == "--frames") {
+            options.frames = parseNumber(arg, value());
+            options.framesGiven = true;
+        }
+        else if (arg == "--movie")
+            options.movie = value();
+        else if (arg == "--screenshot")
+            options.screenshot = value();
+        else if (arg == "--save-state")
+            options.saveState = value();
+        else if (arg == "--no-video")
+            options.video = false;
+        else if (arg == "--jobs") {
+            options.jobs = static_cast<unsigned>(parseNumber(arg, value()));
+            options.batch = true;
+        }
+        else if (arg == "--pin")
+            options.pin = true;
+        else if (arg == "--screenshot-dir")
+            options.screenshotDir = value();
+        else if (arg == "--scaling")
+            options.scaling = options.batch = true;
+        else if (arg.compare(0, 2, "--") == 0)
+            throw std::invalid_argument("Unknown option " + arg);
+        else if (isDirectory(arg)) {
+            const std::vector<std::string> roms = listRoms(arg);
+            options.roms.insert(options.roms.end(), roms.begin(), roms.end());
+            options.batch = true;
+        }
+        else
+            options.roms.push_back(arg);
+    }
+    if (options.roms.empty())
+        throw std::invalid_argument("No rom given");
+    options.batch |= options.roms.size() > 1;
+    if (options.batch && (!options.movie.empty() || !options.screenshot.empty() || !options.saveState.empty()))
+        throw std::invalid_argument("--movie, --screenshot and --save-state are for a single rom");
+    return options;
+}
+
+static int runSingle(const Options& options) {
+    std::shared_ptr<NES> nes = std::make_shared<NES>();
+    nes->init();
+    nes->load(options.roms.front());
+    nes->powerUp();
+    nes->videoOutput = options.video;
+    nes->profilePpu = true;
+
+    Movie movie;
+    uint64_t frames = options.frames;
+    if (!options.movie.empty()) {
+        movie.load(options.movie);
+        movie.seek(*nes, 0);
+        if (!options.framesGiven)
+            frames = movie.frames();
+    }
+
+    std::vector<double> frameTimes; // milliseconds
+    frameTimes.reserve(frames);
+    const uint64_t startInstructions = nes->cpu.instructions();
+    const auto start = std::chrono::steady_clock::now();
+    auto frameStart = start;
+    for (uint64_t frame = 0; frame != frames; ++frame) {
+        if (movie.empty() || !movie.playFrame(*nes))
+            nes->runFrame();
+        const auto frameEnd = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        frameStart = frameEnd;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t instructions = nes->cpu.instructions() - startInstructions;
+    const double ppuSeconds = nes->ppuNanoseconds / 1e9;
+
+    if (!options.screenshot.empty())
+        writeScreenshot(*nes, options.screenshot);
+    if (!options.saveState.empty())
+        writeSaveState(*nes, options.saveState);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Rom:          " << nes->getBaseName() << "\n";
+    std::cout << "Frames:       " << frames << " in " << seconds << " s\n";
+    if (frames == 0)
+        return EXIT_SUCCESS;
+    std::sort(frameTimes.begin(), frameTimes.end());
+    const size_t p99 = std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100);
+    std::cout << "Frames/s:     " << frames / seconds << " (" << frames / seconds / 60.0988 << "x NTSC)\n";
+    std::cout << "Frame time:   mean " << seconds * 1000 / frames << " ms, p99 " << frameTimes[p99] << " ms, max "
+              << frameTimes.back() << " ms\n";
+    std::cout << "Instructions: " << instructions << ", " << instructions / seconds / 1e6 << " million/s\n";
+    std::cout << "Cpu time:     " << seconds - ppuSeconds << " s (" << 100 * (seconds - ppuSeconds) / seconds << "%)\n";
+    std::cout << "Ppu time:     " << ppuSeconds << " s (" << 100 * ppuSeconds / seconds << "%)\n";
+    std::cout << "Frame hash:   " << std::hex << std::setw(16) << std::setfill('0') << screenHash(*nes) << std::dec << "\n";
+    return EXIT_SUCCESS;
+}
+
+static BatchRunner::Options batchOptions(const Options& options, const unsigned& workers) {
+    BatchRunner::Options batch;
+    batch.frames = options.frames;
+    batch.workers = workers;
+    batch.pin = options.pin;
+    batch.video = options.video;
+    batch.screenshotDir = options.screenshotDir;
+    return batch;
+}
+
+// One line per rom as it finishes, then the totals
+static int runBatch(const Options& options) {
+    const BatchRunner runner(batchOptions(options, options.jobs));
+    const BatchRunner::Summary summary = runner.run(options.roms, [](const BatchRunner::Result& result) {
+        if (result.error.empty()) {
+            std::cout << "ok     " << std::hex << std::setfill('0') << "frame " << std::setw(16) << result.screenHash
+                      << " state " << std::setw(16) << result.stateHash << std::dec << std::setfill(' ') << std::fixed
+                      << std::setprecision(2) << std::setw(9) << result.frames / result.seconds << " fps  " << result.rom << "\n";
+        }
+        else {
+            std::cout << "error  " << result.rom << ": " << result.error << "\n";
+        }
+        std::cout.flush();
+    });
+    std::cout << std::fixed << std::setprecision(2) << "Roms: " << summary.roms << " (" << summary.failed << " failed), "
+              << summary.frames << " frames in " << summary.seconds << " s on " << summary.workers << " workers, "
+              << summary.frames / summary.seconds << " frames/s\n";
+    return summary.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Throughput of the same batch with every worker count, efficiency is the speedup over the workers
+static int runScaling(const Options& options) {
+    const unsigned maxWorkers = BatchRunner(batchOptions(options, options.jobs)).workers();
+    std::cout << "Cores: " << std::thread::hardware_concurrency() << ", roms: " << options.roms.size() << ", frames each: "
+              << options.frames << "\n";
+    std::cout << "Workers  Seconds   Frames/s  Speedup  Efficiency\n";
+    double single = 0.0;
+    for (unsigned workers = 1; workers <= maxWorkers; ++workers) {
+        const BatchRunner::Summary summary = BatchRunner(batchOptions(options, workers)).run(options.roms, [](const BatchRunner::Result&) {});
+        const double fps = summary.frames / summary.seconds;
+        if (workers == 1)
+            single = fps;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(7) << workers << std::setw(9) << summary.seconds
+                  << std::setw(11) << fps << std::setw(9) << fps / single << std::setw(11) << 100 * fps / single / workers << "%\n";
+        if (summary.failed)
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const Options options = parseOptions(argc, argv);
+        if (options.scaling)
+            return runScaling(options);
+        return options.batch ? runBatch(options) : runSingle(options);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "yanes-headless: " << e.what() << "\n";
+        if (dynamic_cast<const std::invalid_argument*>(&e))
+            std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef CONTROLLER_HPP
+#define CONTROLLER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+class StateWriter;
+class StateReader;
+
+// Standard controller on $4016/$4017, see https://wiki.nesdev.com/w/index.php/Standard_controller
+// The buttons held are an atomic snapshot any thread can set at any time, the game only sees them
+// when it strobes $4016 which latches the snapshot into the shift register it then reads a bit at a time.
+class Controller {
+    friend struct Tests;
+public:
+    // Bits in the order the game reads them
+    enum Button : uint8_t {
+        A = 0x01,
+        B = 0x02,
+        SELECT = 0x04,
+        START = 0x08,
+        UP = 0x10,
+        DOWN = 0x20,
+        LEFT = 0x40,
+        RIGHT = 0x80
+    };
+
+    Controller() = default;
+    // Atomics can't be copied, copies take a snapshot of the other's state
+    Controller(const Controller&);
+    Controller& operator=(const Controller&);
+
+    // Safe from any thread, the event time is for latency measurement (steady clock nanoseconds),
+    // 0 to not measure this change
+    void setButtons(const uint8_t& buttons, const int64_t& eventTime = 0);
+    uint8_t getButtons() const;
+
+    // Emulation side, $4016 writes strobe both controllers and reads shift out one button
+    void write(const uint8_t& val);
+    uint8_t read();
+
+    // Time of the measured key event the game latched since the last call, and when it was latched,
+    // both 0 if it latched none
+    void takeLatchedEvent(int64_t& eventTime, int64_t& latchTime);
+
+    void clear();
+    // Only the shift register and strobe, the buttons held are input and not part of the state
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+private:
+    void latch();
+
+    std::atomic<uint8_t> buttons{0};
+    std::atomic<int64_t> eventTime{0}; // Of the last setButtons not latched yet
+    uint8_t shift = 0;
+    bool strobe = false;
+    int64_t latchedEvent = 0;
+    int64_t latchTime = 0;
+};
+
+#endif // CONTROLLER_HPP
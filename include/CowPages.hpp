@@ -0,0 +1,59 @@
+#ifndef COWPAGES_HPP
+#define COWPAGES_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Memory split into pages that copies share until one of them writes to a page, then only that page is copied
+// Pages that were never written aren't allocated and read as zeros, so a copy is a handful of shared_ptr copies.
+// Pointers handed out stay valid while the page isn't written through write() or cleared, owners keep
+// their own page tables and remap a page whenever write() gives them a new one.
+template<size_t PageSize, size_t Pages>
+class CowPages {
+public:
+    using Page = std::array<uint8_t, PageSize>;
+
+    const uint8_t* read(const size_t& page) const noexcept {
+        return pages[page] ? pages[page]->data() : zeros().data();
+    }
+    // The page's bytes if no copy shares them, nullptr if write() has to copy or allocate the page first
+    uint8_t* writable(const size_t& page) const noexcept {
+        if (!pages[page] || pages[page].use_count() != 1)
+            return nullptr;
+        // The last copy that shared the page may have let it go on another thread
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return pages[page]->data();
+    }
+    // Makes the page this copy's own, read() of the page may point somewhere else afterwards
+    uint8_t* write(const size_t& page) {
+        if (uint8_t* data = writable(page))
+            return data;
+        pages[page] = pages[page] ? std::make_shared<Page>(*pages[page]) : std::make_shared<Page>();
+        return pages[page]->data();
+    }
+    // Bytes of the pages only this copy holds, pages shared with a copy and unwritten pages aren't counted
+    size_t ownedBytes() const noexcept {
+        size_t bytes = 0;
+        for (const std::shared_ptr<Page>& page : pages)
+            bytes += page && page.use_count() == 1 ? PageSize : 0;
+        return bytes;
+    }
+    // Back to all zeros
+    void clear() noexcept {
+        for (std::shared_ptr<Page>& page : pages)
+            page.reset();
+    }
+
+private:
+    std::array<std::shared_ptr<Page>, Pages> pages;
+
+    static const Page& zeros() noexcept {
+        static const Page page{};
+        return page;
+    }
+};
+
+#endif // COWPAGES_HPP
@@ -32,6 +32,7 @@ namespace Inner {
 class Cpu6502 {
     friend struct Tests;
     friend class NES;
+    friend class LockstepCpu;
 
     // addressing mode function to be performed per instruction
     using AddressingPtr = uint16_t (Cpu6502::*)();
@@ -52,10 +53,26 @@ public:
 
     void signalNMI();
     void signalRESET();
+    // Irqs are level triggered, the line stays asserted until clearIRQ
+    // The interrupt is taken right away if allowed, otherwise once interrupts are enabled again
     void signalIRQ();
+    void clearIRQ() noexcept;
+    // Called by the write to $4014, the cpu stalls once the writing instruction is done
+    void signalDMA();
 
     void clear();
 
+    // Counted since the cpu was cleared, a loaded state brings its own counts
+    uint64_t instructions() const noexcept;
+    uint64_t cycles() const noexcept;
+
+    // Registers, counters, the irq line and the cpu's memory
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    // Run instructions through the member pointer opcode table instead of the
+    // compile time dispatcher, only useful for debugging the dispatcher
+    bool useOpcodeTable = false;
 
 private:
 
@@ -70,12 +87,29 @@ private:
     // Counters
     uint64_t cycleCount = 0;
     uint64_t instrCount = 0;
+    // Cycle timings of each opcode, see Cpu6502.cpp
+    static const std::array<const uint8_t, 0x100> cycleTable;
+    static const std::array<const uint8_t, 0x100> pageCrossTable;
+    // Set by indexed addressing modes when the address is on a different page than its base
+    uint8_t pageCrossed = 0;
+    // Set by signalDMA, the stall is added after the instruction's own cycles, see runCycle
+    bool pendingDMA = false;
 
     // Allow Decimal mode of Cpu, uneeded for NES
     bool cpuAllowDec = false;
-    // Opcode Table
-    void fillOpTable();
-    std::array<Instr, 0xFF> opcodeTable;
+    // Opcode Table, shared by every cpu. createOpTable is constexpr, so the compiler builds the table
+    // and it is read only data that exists before any code runs, no cpu or static initializer builds it
+    struct OpTable {
+        Instr instrs[0x100];
+        constexpr Instr& operator[](const size_t& opcode) { return instrs[opcode]; }
+        constexpr const Instr& operator[](const size_t& opcode) const { return instrs[opcode]; }
+    };
+    static constexpr OpTable createOpTable();
+    static const OpTable opcodeTable;
+    // Compile time dispatcher, see execute() in Cpu6502.cpp
+    template<InstrFuncPtr instrPtr, AddressingPtr adringPtr>
+    inline void dispatch();
+    void execute(const uint8_t& opcode);
 
     // Vectors are vector pointers pointing to an address where the pc should be
     // Each variable is where the signal's vector points to, the value is the low byte of the address
@@ -88,6 +122,9 @@ private:
 
     // General Interrupt Function
     inline void generateInterrupt(const uint16_t& vector);
+    // Only CLI, PLP and RTI can enable interrupts, so only they poll a held irq line
+    bool irqLine = false;
+    inline void pollIRQ();
 
     /// -- Flagging Operations --
     inline void setZero(const uint16_t&) noexcept;
@@ -0,0 +1,110 @@
+#ifndef EMULATIONTHREAD_H
+#define EMULATIONTHREAD_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "NES.h"
+#include "FramePacer.h"
+#include "Rewind.h"
+#include "Movie.h"
+#include "RunAhead.h"
+#include "TripleBuffer.hpp"
+#include "SpscQueue.hpp"
+
+// Runs a NES on its own thread so the ui and the emulation never stall each other
+// Commands go in on a wait free queue, finished frames come out of a triple buffer and errors come out
+// of another queue. Input skips the queue, it's an atomic snapshot on the controllers the game latches
+// whenever it strobes them. All the public functions are for the one thread that owns this
+// (the ui thread), the NES itself must not be touched by it while the thread runs.
+class EmulationThread {
+public:
+    struct Command {
+        // REWIND_START steps back a snapshot every frame until REWIND_STOP, not while a movie runs
+        // RECORD_MOVIE powers the rom up again and records until STOP_MOVIE, which saves it to fname
+        // PLAY_MOVIE loads the movie in fname and plays it from power on, input is back to the keys after it
+        // RUN_AHEAD shows the frame that many frames ahead from now on, see RunAhead (not while a movie plays or rewinding)
+        enum Type : uint8_t { LOAD, RESET, PAUSE, RESUME, QUIT, REWIND_START, REWIND_STOP, RECORD_MOVIE, PLAY_MOVIE, STOP_MOVIE,
+                              RUN_AHEAD };
+        Type type = QUIT;
+        std::string fname; // LOAD, RECORD_MOVIE and PLAY_MOVIE
+        unsigned frames = 0; // RUN_AHEAD
+    };
+
+    struct Frame {
+        std::array<uint32_t, 256 * 240> pixels{}; // ARGB32, pitch of 256 pixels
+        uint64_t number = 0; // Ppu frame count when the frame finished
+        FramePacer::Stats pacing; // Of the frames before this one, empty if unpaced
+        Rewind::Stats rewind; // What's left to rewind after this frame
+        // Input latency measurement, steady clock nanoseconds of the first measured key event the game
+        // latched during this frame and of when it latched it, both 0 if none
+        int64_t inputEvent = 0;
+        int64_t inputLatch = 0;
+        // Vram as it was when the frame finished, for the debug viewers, only while setVideoMemoryCopies is on
+        bool hasVideoMemory = false;
+        Ppu::VideoMemory videoMemory;
+    };
+
+    // A loaded nes (already powered up) starts running right away, otherwise it waits for a LOAD
+    // Unpaced runs frames as fast as it can, paced runs them at the NTSC frame rate with a FramePacer
+    explicit EmulationThread(std::shared_ptr<NES> nes, const bool& loaded = false, const bool& paced = true);
+    ~EmulationThread(); // Stops and joins the thread
+    EmulationThread(const EmulationThread&) = delete;
+    EmulationThread& operator=(const EmulationThread&) = delete;
+
+    // False if the command queue is full, the command was dropped
+    bool send(Command command);
+    // Swaps in the newest finished frame, false if there wasn't a new one since the last call
+    bool newFrame();
+    // The last frame swapped in by newFrame, stays valid until newFrame is called again
+    const Frame& frame() const;
+    // Pops the message of a command that failed, false if there's none
+    bool popError(std::string& message);
+    // Buttons of player 0 or 1 in Controller::Button bits, seen by the game the next time it strobes
+    // A non zero event time (steady clock nanoseconds) is measured until the game latches it
+    // While a movie records they are only sampled once a frame so the movie has what the game saw,
+    // while one plays they are ignored
+    void setButtons(const uint8_t& player, const uint8_t& buttons, const int64_t& eventTime = 0);
+    // While on every frame carries a copy of vram, off by default since it's 16KB per frame nobody looks at
+    void setVideoMemoryCopies(const bool& enabled);
+
+private:
+    void run();
+    void execute(Command& command);
+    void runFrame();
+    void rewindFrame();
+    void emulateFrame();
+    void stopMovie();
+
+    std::shared_ptr<NES> nes;
+    const bool paced;
+    // Only touched by the emulation thread
+    bool loaded;
+    bool paused = false;
+    bool quit = false;
+    bool rewinding = false;
+    FramePacer pacer;
+    Rewind rewind;
+    RunAhead runAhead;
+    enum MovieMode : uint8_t { NO_MOVIE, RECORDING, PLAYING };
+    MovieMode movieMode = NO_MOVIE;
+    Movie movie;
+    std::string movieFile; // Where the movie recording is saved
+    std::string romFile; // Of the last LOAD, empty if the nes came loaded
+    // Set by both threads, the buttons held and whether they go to the controllers right away
+    std::array<std::atomic<uint8_t>, 2> buttons{};
+    std::atomic<bool> liveInput{true};
+    std::atomic<bool> copyVideoMemory{false};
+
+    TripleBuffer<Frame> frames;
+    SpscQueue<Command, 64> commands;
+    SpscQueue<std::string, 16> errors;
+    // Started last, everything above must be constructed before the thread uses it
+    std::thread thread;
+};
+
+#endif // EMULATIONTHREAD_H
@@ -0,0 +1,52 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Paces a loop at a fixed frame rate by sleeping until each frame's deadline
+// Most of the wait is slept so the core is free, only the last few microseconds are spun
+// to make up for the os waking us late. Deadlines are from the start, so no drift builds up.
+class FramePacer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // In milliseconds, over the last SAMPLES frames
+    struct Stats {
+        double mean = 0.0; // Frame time
+        double p99 = 0.0; // 99th percentile frame time
+        double maxJitter = 0.0; // Largest difference of a frame time from the period
+        size_t frames = 0; // Frames the stats are from
+    };
+
+    static constexpr double NTSC_RATE = 60.0988;
+    static constexpr size_t SAMPLES = 600;
+
+    explicit FramePacer(const double& rate = NTSC_RATE, const std::chrono::microseconds& spin = std::chrono::microseconds(200));
+
+    // Starts counting frames from now, needed after the loop stopped for a while (pause, load)
+    void start();
+    // Waits for the next frame's deadline and records how long the frame took
+    void wait();
+    // Stats are recomputed every 60 frames, computing them is a sort of the samples
+    const Stats& stats() const;
+    double period() const; // In milliseconds
+
+private:
+    void record(const clock::time_point& now);
+    void computeStats();
+
+    const double periodNs;
+    const clock::duration spin;
+    clock::time_point origin; // Deadline of frame 0
+    uint64_t frame = 0;
+    clock::time_point lastWake;
+
+    std::array<double, SAMPLES> samples{}; // Frame times in milliseconds, a ring
+    size_t sampleCount = 0;
+    Stats current;
+};
+
+#endif // FRAMEPACER_H
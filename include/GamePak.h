@@ -8,35 +8,53 @@
 class Memory;
 class Ppu;
 class NES;
+class Mapper;
+class RomImage;
+class StateWriter;
+class StateReader;
 
 class GamePak {
     friend struct Tests;
 public:
-    // Type of mirroring of flag 6
+    // Type of mirroring of flag 6, single screen mirroring is only set by mappers
     enum MIRRORT {
         HORIZONTAL = 0,
-        VERTICAL = 1
+        VERTICAL = 1,
+        SINGLE_LOWER = 2,
+        SINGLE_UPPER = 3,
+        FOUR_SCREEN = 4 // flag 6 bit 3, overrides the others
     };
-    GamePak() = default;
+    GamePak();
     GamePak(std::shared_ptr<NES>);
+    ~GamePak();
+    // Copies have their own clone of the mapper, the rom is shared
+    GamePak(const GamePak&);
+    GamePak(GamePak&&);
+    GamePak& operator=(GamePak&&);
 
+    // Also points the nes' cpu and ppu at the mapper's banks if a cartridge is loaded
     void setNESHandle(std::shared_ptr<NES>) &;
 
     void load(const std::string& fname);
+    // A cpu write to 0x8000-0xFFFF, remaps the cpu and ppu if the mapper switched banks
+    void writeRegister(const uint16_t& adr, const uint8_t& val);
+    // The mapper's state, loading remaps the cpu and ppu to its banks
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
 
     uint8_t PRG_ROM_sz = 0; // Program Read only memory in 16kb size
     uint8_t CHR_ROM_sz = 0; // Character Read only memory in 8kb size
-    uint8_t mapper = 0; // Mapper number
+    uint8_t mapperNum = 0; // Mapper number
     MIRRORT mirror = MIRRORT::HORIZONTAL;
     uint8_t flags7 = 0, flags8 = 0, flags9 = 0, flags10 = 0; // flags used in header, currently unused in this project
 
+    std::shared_ptr<const RomImage> rom;
+    std::unique_ptr<Mapper> mapper;
+
 private:
-    std::shared_ptr<NES> nes;
-    static GamePak cpuLoad(Memory& memory, std::ifstream& ifs);
-    // Old ways of loading memory, used by load however.
-    // These are used by Tests
-    static GamePak load(Memory& memory, Ppu& ppu, const std::string& fname);
-    static GamePak load(Memory& memory, const std::string& fname);
+    NES* nes = nullptr;
+    // Points the cpu and ppu to the mapper's current banks
+    void mapBanks();
 };
 
 #endif // GAMEPAK_HPP
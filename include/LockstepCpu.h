@@ -0,0 +1,108 @@
+#ifndef LOCKSTEPCPU_H
+#define LOCKSTEPCPU_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Cpu6502.h"
+
+class RomImage;
+
+// Experimental: many 6502s of one program run in lockstep, for batches of copies of the same rom
+// The registers of every lane (a cpu) are kept as arrays, one byte per lane, and so is the work ram:
+// byte adr of every lane is in one row. Each step takes the lanes at the lowest pc as a group and runs
+// that instruction for all of them at once, BLOCK lanes per simd operation. Lanes that branch apart run
+// as smaller groups until their pcs meet again, and only indexed and stack accesses go lane by lane.
+// Instructions run exactly like Cpu6502 runs them, cycle counts included.
+// There is no ppu, apu, mapper or interrupt line, it's just the cpu: 0x0000-0x1FFF is the ram and its
+// mirrors, 0x8000-0xFFFF is a 16kb or 32kb prg rom that every lane shares, anything in between reads 0
+// and ignores writes. The vector code needs gcc's or clang's vector extensions.
+class LockstepCpu {
+public:
+    // Lanes per simd operation, 32 byte lanes fill an avx2 register
+    static constexpr size_t BLOCK = 32;
+
+    struct Registers {
+        uint8_t a = 0, x = 0, y = 0, sp = 0;
+        uint16_t pc = 0;
+        uint8_t status = 0; // As pushed by PHP, the b flag included
+        uint64_t cycles = 0;
+    };
+
+    // Throws if the prg rom isn't 16kb or 32kb or there are no lanes
+    LockstepCpu(const uint8_t* prg, const size_t& prgSize, const size_t& lanes);
+    // Only nrom (mapper 0) cartridges fit, throws for the others
+    LockstepCpu(const RomImage& rom, const size_t& lanes);
+
+    size_t lanes() const noexcept;
+
+    Registers registers(const size_t& lane) const;
+    void setRegisters(const size_t& lane, const Registers& regs);
+    uint8_t read(const size_t& lane, const uint16_t& adr) const;
+    void write(const size_t& lane, const uint16_t& adr, const uint8_t& val);
+
+    // Every lane jumps through the reset vector, like Cpu6502::signalRESET
+    void reset();
+    // Runs every lane until it has run atleast num more cycles, like NES::runCycles does
+    void runCycles(const uint64_t& num);
+
+    // Instructions run by all lanes, and the groups they ran in, their ratio is how many lanes ran together
+    uint64_t instructions() const noexcept;
+    uint64_t groups() const noexcept;
+    // Whether the avx2 code is used on this cpu, otherwise the same code runs on sse2 or scalars
+    static bool avx2();
+
+private:
+    size_t count = 0; // Lanes asked for, the rest of the last block is never active
+    size_t width = 0; // Lanes rounded up to BLOCK
+
+    // Registers and flags of each lane, flags are 0 or 1
+    std::vector<uint8_t> a, x, y, sp;
+    std::vector<uint8_t> c, z, i, d, b, v, n;
+    std::vector<uint16_t> pc;
+    std::vector<uint64_t> cycleCount, target;
+    // Cycles each lane may still run before runCycles looks at its target again, see runCycles
+    static constexpr int16_t MAX_BUDGET = 0x4000;
+    std::vector<int16_t> budget;
+    std::vector<int16_t> roundBudget; // budget as a round of runCycles started, to count what was used
+    // 0xFF for lanes with budget left
+    std::vector<uint8_t> active;
+
+    // Memory::RAM_SIZE rows of width bytes, row adr holds byte adr of every lane
+    std::vector<uint8_t> ram;
+    // Mirrored up to 32kb
+    std::vector<uint8_t> prg;
+
+    // Per step scratch, each only meaningful for the lanes of the group
+    std::vector<uint8_t> group; // 0xFF for lanes in the group
+    std::vector<size_t> groupBlocks; // First lane of each block with a lane in the group
+    std::vector<uint16_t> address;
+    std::vector<uint8_t> operand, result, delta;
+
+    uint64_t instrCount = 0;
+    uint64_t groupCount = 0;
+
+    // The operation and addressing mode of each opcode, taken from Cpu6502's opcode table
+    enum Op : uint8_t;
+    enum Mode : uint8_t;
+    struct Decoded {
+        Op op;
+        Mode mode;
+    };
+    static const std::array<Decoded, 0x100> decodeTable;
+    static std::array<Decoded, 0x100> createDecodeTable();
+
+    uint8_t readLane(const size_t& lane, const uint16_t& adr) const;
+    void writeLane(const size_t& lane, const uint16_t& adr, const uint8_t& val);
+    void push(const size_t& lane, const uint8_t& val);
+    uint8_t pop(const size_t& lane);
+    uint8_t statusByte(const size_t& lane) const;
+    void setStatus(const size_t& lane, const uint8_t& byte);
+
+    // Runs the next group, false once no lane is short of its target
+    bool step();
+};
+
+#endif // LOCKSTEPCPU_H
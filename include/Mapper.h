@@ -0,0 +1,141 @@
+#ifndef MAPPER_HPP
+#define MAPPER_HPP
+
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+#include "functions.hpp"
+#include "GamePak.h"
+#include "RomImage.h"
+
+class StateWriter;
+class StateReader;
+
+// A mapper maps the cartridge's rom into the cpu and ppu address space through windows
+// The rom is never modified, switching a bank only points a window somewhere else
+// Prg is mapped as four 8KB windows from 0x8000-0xFFFF, chr as eight 1KB windows from 0x0000-0x1FFF
+// Refer to https://wiki.nesdev.com/w/index.php/Mapper
+class Mapper {
+public:
+    Mapper(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    virtual ~Mapper() = default;
+    // Creates the mapper of the iNES mapper number, throws on an unsupported mapper
+    static std::unique_ptr<Mapper> create(const uint8_t& number, std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    // A copy with its own registers and chr ram, the rom is shared
+    virtual std::unique_ptr<Mapper> clone() const = 0;
+
+    // A cpu write to 0x8000-0xFFFF, returns true when the windows or mirroring changed
+    virtual bool writeRegister(const uint16_t& adr, const uint8_t& val);
+
+    // Scanline counters (MMC3) are clocked by the ppu once per rendered scanline
+    virtual bool hasScanlineCounter() const noexcept { return false; }
+    // Clocks the counter, returns true when it raises the irq
+    virtual bool clockScanline() noexcept { return false; }
+    // Amount of clocks until the counter raises the irq, 0 when it won't
+    virtual uint32_t clocksUntilIrq() const noexcept { return 0; }
+    // Level of the cartridge's irq line, held until the cpu acknowledges it through a register
+    bool irq = false;
+
+    // The windows are saved as offsets into the rom (or chr ram), so they come back without the registers
+    // being replayed. Mappers with registers save them after calling these
+    virtual void saveState(StateWriter& state) const;
+    virtual void loadState(StateReader& state);
+
+    // The mapper and its chr ram, the registers derived mappers add are a few bytes more. The rom is shared
+    size_t ownedBytes() const noexcept;
+
+    std::array<const uint8_t*, 4> prgBanks{};
+    std::array<const uint8_t*, 8> chrBanks{};
+    // Windows that can be written to are chr ram, chr rom windows are nullptr
+    std::array<uint8_t*, 8> chrWriteBanks{};
+    GamePak::MIRRORT mirror;
+
+protected:
+    // Windows into chr ram point into the copy's own chr ram
+    Mapper(const Mapper& other);
+    Mapper& operator=(const Mapper&) = delete;
+
+    std::shared_ptr<const RomImage> rom;
+    // Carts without chr rom have 8KB of chr ram instead, empty otherwise
+    std::vector<uint8_t> chrRam;
+
+    // Point a window to a bank, banks are in units of the window size and wrap around the rom's size
+    void setPrg8k(const uint8_t& window, const unsigned& bank) noexcept;
+    void setPrg16k(const uint8_t& window, const unsigned& bank) noexcept;
+    void setPrg32k(const unsigned& bank) noexcept;
+    void setChr1k(const uint8_t& window, const unsigned& bank) noexcept;
+    void setChr4k(const uint8_t& window, const unsigned& bank) noexcept;
+    void setChr8k(const unsigned& bank) noexcept;
+};
+
+// Mapper 0, no bank switching. NROM-128 mirrors its 16KB into both halves
+class NROM : public Mapper {
+public:
+    NROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+};
+
+// Mapper 1, https://wiki.nesdev.com/w/index.php/MMC1
+class MMC1 : public Mapper {
+public:
+    MMC1(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+    bool writeRegister(const uint16_t& adr, const uint8_t& val) override;
+    void saveState(StateWriter& state) const override;
+    void loadState(StateReader& state) override;
+private:
+    // Registers are written a bit at a time through a 5 bit shift register
+    uint8_t shift = 0x10;
+    uint8_t control = 0x0C;
+    uint8_t chrBank0 = 0, chrBank1 = 0, prgBank = 0;
+    void updateBanks() noexcept;
+};
+
+// Mapper 2, https://wiki.nesdev.com/w/index.php/UxROM
+class UxROM : public Mapper {
+public:
+    UxROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+    bool writeRegister(const uint16_t& adr, const uint8_t& val) override;
+};
+
+// Mapper 3, https://wiki.nesdev.com/w/index.php/INES_Mapper_003
+class CNROM : public Mapper {
+public:
+    CNROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+    bool writeRegister(const uint16_t& adr, const uint8_t& val) override;
+};
+
+// Mapper 7, https://wiki.nesdev.com/w/index.php/AxROM
+class AxROM : public Mapper {
+public:
+    AxROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+    bool writeRegister(const uint16_t& adr, const uint8_t& val) override;
+};
+
+// Mapper 4, https://wiki.nesdev.com/w/index.php/MMC3
+class MMC3 : public Mapper {
+public:
+    MMC3(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror);
+    std::unique_ptr<Mapper> clone() const override;
+    bool writeRegister(const uint16_t& adr, const uint8_t& val) override;
+    bool hasScanlineCounter() const noexcept override { return true; }
+    bool clockScanline() noexcept override;
+    uint32_t clocksUntilIrq() const noexcept override;
+    void saveState(StateWriter& state) const override;
+    void loadState(StateReader& state) override;
+private:
+    uint8_t bankSelect = 0;
+    std::array<uint8_t, 8> registers{}; // R0-R7, R0 and R1 are 2KB chr banks
+    uint8_t irqLatch = 0;
+    uint8_t irqCounter = 0;
+    bool irqReload = false;
+    bool irqEnable = false;
+    void updateBanks() noexcept;
+};
+
+#endif // MAPPER_HPP
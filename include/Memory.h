@@ -4,32 +4,89 @@
 #include <array>
 #include <memory>
 #include "GamePak.h"
+#include "CowPages.hpp"
 
 class NES;
+class Mapper;
+class StateWriter;
+class StateReader;
 
 class Memory {
-    friend struct GamePak;
+    friend class GamePak;
     friend struct Tests;
     // Max amount of memory in bytes (64KB)
-    static constexpr uint16_t MAXBYTES = 0xFFFF;
+    static constexpr uint32_t MAXBYTES = 0x10000;
+    // The cpu's address space is split into 256 pages of 256 bytes
+    static constexpr uint16_t PAGES = 0x100;
 public:
+    // Work ram, 0x0000-0x07FF and mirrored up to 0x1FFF
+    static constexpr uint16_t RAM_SIZE = 0x800;
+
     Memory();
     Memory(std::shared_ptr<NES> nes);
+    // Copies share every page until either side writes to it, see CowPages
+    Memory(const Memory&);
+    Memory& operator=(const Memory&);
 
     // These two read/write functions are necessary for later
-    uint8_t read(const uint16_t& adr) const;
-    void write(const uint16_t& adr, const uint8_t& val);
+    // Plain pages are a single indexed load, I/O pages go through the ppu/io handlers
+    inline uint8_t read(const uint16_t& adr) const;
+    inline void write(const uint16_t& adr, const uint8_t& val);
 
     // For 'hard writing' into memory
     uint8_t& operator[](const size_t&);
     const uint8_t& operator[](const size_t&) const;
 
     void clear();
+    // Copies the RAM_SIZE bytes of work ram into out
+    void copyRam(uint8_t* out) const;
+    // Bytes of ram this memory holds on its own, pages still shared with a copy aren't counted
+    size_t ownedBytes() const noexcept;
     void setNESHandle(std::shared_ptr<NES> nes);
 
+    // Ram, the io registers and prg ram (0x6000-0x7FFF), the rest is the rom or mirrors
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
 private:
-    std::array<uint8_t, MAXBYTES> memory{};
-    std::shared_ptr<NES> nes;
+    CowPages<0x100, PAGES> memory;
+    NES* nes = nullptr;
+
+    // Page tables, a page either points directly to where it's bytes are or is nullptr
+    // when reading or writing it has side effects, then the io handler is used instead
+    // Writes to a page shared with a copy also go through the io handler, which makes the page ours first.
+    // Copying takes the write pages away from the memory copied from too, hence mutable
+    std::array<const uint8_t*, PAGES> readPages{};
+    mutable std::array<uint8_t*, PAGES> writePages{};
+    // Resolves all mirrors of the address space into the page tables
+    void mapPages();
+    void mapPage(const uint16_t& page);
+    // Makes a page of memory (not a cpu page, those can be mirrors) ours to write and remaps every cpu page it backs
+    uint8_t* ownPage(const uint16_t& page);
+    // The cartridge's mapper, 0x8000-0xFFFF read from its prg windows and writes go to its registers
+    // Without a mapper the whole address space is plain memory, which the tests rely on
+    const Mapper* mapper = nullptr;
+    void setMapper(const Mapper* mapper);
+    // Only remaps 0x8000-0xFFFF, done on every bank switch
+    void mapPrgPages();
+
+    uint8_t readIO(const uint16_t& adr) const;
+    void writeIO(const uint16_t& adr, const uint8_t& val);
 };
 
+uint8_t Memory::read(const uint16_t& adr) const {
+    const uint8_t* page = readPages[adr >> 8];
+    if (page)
+        return page[adr & 0xFF];
+    return readIO(adr);
+}
+
+void Memory::write(const uint16_t& adr, const uint8_t& val) {
+    uint8_t* page = writePages[adr >> 8];
+    if (page)
+        page[adr & 0xFF] = val;
+    else
+        writeIO(adr, val);
+}
+
 #endif // MEMORY_HPP
@@ -0,0 +1,57 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class NES;
+
+// Controller input of every frame from power on, played back it makes the exact same run again
+// Every keyframeInterval frames the whole machine state is kept as a keyframe, seeking loads the last
+// keyframe before the frame and only emulates the rest, so a seek never runs more than keyframeInterval frames.
+// Keyframe 0 is the power on state, which makes playback independent of what the nes did before.
+class Movie {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    explicit Movie(const unsigned& keyframeInterval = 300);
+
+    // Starts an empty movie from the nes, which must have just been loaded and powered up
+    void startRecording(const NES& nes);
+    // Runs the frame at the current position with the given buttons and records them
+    // Recording after seeking back replaces everything after the position
+    void recordFrame(NES& nes, const uint8_t& player1, const uint8_t& player2);
+    // Runs the frame at the current position with its recorded buttons, false at the end of the movie
+    bool playFrame(NES& nes);
+    // Puts the nes at the start of the given frame (0 is power on, frames() is after the last one)
+    void seek(NES& nes, const uint64_t& frame);
+
+    uint64_t frames() const;
+    uint64_t position() const; // The next frame played or recorded
+    bool empty() const;
+    size_t keyframes() const;
+
+    // The file is the magic "YNMV", the version, the keyframe interval, the frame count, 2 bytes of buttons
+    // per frame and then the keyframes as (frame, size, save state)
+    void save(std::vector<uint8_t>& data) const;
+    void save(const std::string& fname) const;
+    // Throws on anything that isn't a whole movie of this version, which leaves the movie untouched
+    // Keyframes are only checked against the rom when seeking
+    void load(const uint8_t* data, const size_t& size);
+    void load(const std::string& fname);
+
+private:
+    struct Keyframe {
+        uint64_t frame;
+        std::vector<uint8_t> state;
+    };
+
+    unsigned keyframeInterval;
+    std::vector<uint8_t> input; // player 1 and player 2 buttons of each frame
+    std::vector<Keyframe> keyframeList; // sorted by frame, the first is frame 0
+    uint64_t pos = 0;
+};
+
+#endif // MOVIE_H
@@ -2,11 +2,13 @@
 #define NES_HPP
 
 #include <memory>
+#include <vector>
 
 #include "Memory.h"
 #include "Cpu6502.h"
 #include "Ppu.h"
 #include "GamePak.h"
+#include "Controller.h"
 
 // This class acts as the main bus that connects everything
 // It communicates with the cpu and ppu and allows interaction between the two
@@ -14,25 +16,95 @@
 
 
 class NES : public std::enable_shared_from_this<NES> {
+    friend struct Tests;
 public:
+    NES() = default;
     void init(); // This function must be called right after the constructor
     Cpu6502 cpu;
     Ppu ppu;
     GamePak gamepak;
+    // Player 1 on $4016 and player 2 on $4017, their buttons can be set from any thread
+    std::array<Controller, 2> controllers;
     std::shared_ptr<NES> getPtr();
 
     void load(const std::string& fname);
     void clear();
-    void step();
+    void step(); // Runs a single cpu instruction and catches the ppu up to it
+    void runCycles(const uint64_t& cycles); // Runs atleast the given amount of cpu cycles
+    void runFrame(); // Runs until the ppu completes a frame
     void powerUp(); // Creates the powerup state
 
-    // adds a chroma colour to the screen
-    void addVideoData(const uint8_t& x, const uint8_t& y, const uint8_t& chroma);
+    // When set runCycles and runFrame only run the ppu when the cpu can see it
+    // Otherwise the ppu is caught up after every instruction like step()
+    bool lazyPpu = true;
+    // When set whole scanlines the cpu didn't touch are rendered at once, see Ppu::runScanline
+    bool scanlineRenderer = true;
+    // When cleared the ppu runs as usual but draws no pixels, neither to screen nor to the frame buffer
+    // For frames that are only emulated to be thrown away, like the ones run-ahead rolls back
+    bool videoOutput = true;
+    // When set the time spent running the ppu is added up in ppuNanoseconds, everything else a frame
+    // takes is the cpu's. Costs two clock reads each time the ppu is caught up.
+    bool profilePpu = false;
+    uint64_t ppuNanoseconds = 0;
+    // Runs the ppu up to the cpu's current cycle, must be called before the cpu
+    // interacts with the ppu so it sees the ppu's state at the right time
+    void catchUpPpu();
+    // Recomputes when the ppu must be caught up next, needed after a write that changes when the ppu's events happen
+    void updatePpuDeadline();
+
+    // adds a chroma colour to the screen, and its ARGB colour to the frame buffer if one is set
+    inline void addVideoData(const uint8_t& x, const uint8_t& y, const uint8_t& chroma);
     std::array<std::array<uint8_t, 256>, 240> screen{};
+    // Sets a 256x240 ARGB32 (0xFFRRGGBB) buffer the ppu draws into along with screen, nullptr to stop
+    // Pitch is the amount of bytes between the start of each row, must be a multiple of 4 and atleast 1024
+    void setFrameBuffer(uint32_t* buffer, const size_t& pitch);
 
     std::string getBaseName() const;
+
+    // Save states of the whole machine, a versioned binary blob
+    // The rom isn't stored, only its hash, a state can only be loaded with the same rom loaded
+    static constexpr uint32_t STATE_VERSION = 2;
+    // Replaces the contents of state, reusing its capacity
+    void saveState(std::vector<uint8_t>& state) const;
+    std::vector<uint8_t> saveState() const;
+    // Throws if the state is of another version or of another rom, which leaves the nes untouched
+    // A damaged state that passes those checks throws part way through, the nes must be reloaded or reset then
+    void loadState(const uint8_t* state, const size_t& size);
+    void loadState(const std::vector<uint8_t>& state);
+
+    // An independent copy of the whole machine, ready to run (no init or load needed)
+    // The rom, the opcode table and every page of ram and vram are shared, a page is only copied once either
+    // side writes to it. The copy has no frame buffer, it only draws into its own screen.
+    std::shared_ptr<NES> clone() const;
+
+    // Bytes this nes holds on its own: the object, the pages of ram and vram it doesn't share with a clone
+    // and its mapper. The rom image and the opcode table are shared by every nes and aren't counted.
+    // On x86-64 a running nrom game comes to about 82kb, see footprintTest:
+    //  60kb the screen, written once a frame
+    //   8kb the cpu, nearly all of it the page tables of the cpu's address space
+    //   9kb the ppu, 8kb of it the decoded tile cache
+    //   4kb the pages of ram and vram written to, about 2kb of each for Donkey Kong
+    // Prg ram adds up to 8kb once a game writes to it, and chr ram carts add 8kb in the mapper
+    size_t footprint() const;
 private:
+    // Only for clone, the copy's parts still point at this nes until they are given the copy's handle
+    NES(const NES& other);
     std::string baseName;
+    uint32_t* frameBuffer = nullptr;
+    size_t frameBufferPitch = 0; // in pixels
+    // Ppu cycles ran, kept at 3 ppu cycles per cpu cycle
+    uint64_t ppuCycleCount = 0;
+    // The ppu cycle the ppu must be caught up at, an event the cpu will see happens after it
+    uint64_t ppuDeadline = 0;
+    // Runs the cpu without the ppu until the deadline or the given cpu cycle is reached
+    void runCpuUntil(const uint64_t& cycle);
+    void runPpuUntil(const uint64_t& target);
 };
 
+void NES::addVideoData(const uint8_t& x, const uint8_t& y, const uint8_t& chroma) {
+    screen[y][x] = chroma;
+    if (frameBuffer)
+        frameBuffer[y * frameBufferPitch + x] = Ppu::ARGBPaletteTable[chroma & 0x3F];
+}
+
 #endif // NES_HPP
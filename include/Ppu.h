@@ -6,8 +6,11 @@
 
 #include "functions.hpp"
 #include "GamePak.h"
+#include "CowPages.hpp"
 
 class NES;
+class StateWriter;
+class StateReader;
 
 // Inner status registers used by the ppu
 namespace Inner {
@@ -69,6 +72,18 @@ public:
 
     // Runs a cycle of the ppu
     void runCycle();
+    // Runs the rest of a visible scanline at once, only when it starts at its first cycle
+    // Gives the same result as calling runCycle for every cycle of the line, returns the amount of cycles ran
+    uint16_t runScanline();
+    // If runScanline can be used, A12 tracking needs to see every cycle
+    inline bool atScanlineStart() const noexcept;
+    // Most cycles a scanline can take
+    static constexpr uint16_t SCANLINE_CYCLES = 341;
+    // Amount of cycles that can be ran before the cpu can notice the ppu, the vblank NMI, the end of a frame
+    // and the mapper's scanline irq
+    uint32_t cyclesUntilEvent() const noexcept;
+    // Works out when the mapper's scanline counter is clocked from PPUCTRL and PPUMASK, see Ppu.cpp
+    void updateScanlineIrq() noexcept;
 
     // Read Write Register Functions
     // Read Write onto the NES ram bus
@@ -77,6 +92,11 @@ public:
     // Read write onto the ppu's own ram bus
     void vRamWrite(const uint16_t& adr, const uint8_t& val);
     uint8_t vRamRead(const uint16_t& adr) const;
+    // Points the pattern tables at the cartridge's chr banks, 1KB each
+    // Banks that cannot be written to (chr rom) are nullptr in writeBanks
+    void setChrBanks(const std::array<const uint8_t*, 8>& banks, const std::array<uint8_t*, 8>& writeBanks) noexcept;
+    // Routes the four nametables, done when a cartridge is loaded or its mapper changes mirroring
+    void setMirroring(const GamePak::MIRRORT& mirror) noexcept;
 
     //////  ------------- Tester/Viewer Functions --------------
     // This functions are mainly used by the viewer classes to see inside the contents of the ppu
@@ -99,28 +119,60 @@ public:
 
     // Converts a NES's chroma color to regular RGB values
     static PaletteT getRGBPalette(const uint8_t& paletteNum);
+    // The same colours as a 32 bit ARGB pixel (0xFFRRGGBB), indexed by the chroma
+    static const std::array<uint32_t, 0x40> ARGBPaletteTable;
     // Get the Palette Selection (0,1,2,3) based on nametable address
     uint8_t getPaletteFromNameTable(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const;
     // Get A color set from the palette addresses (defined in wiki where)
     ColorSetT getColorSetFromAdr(const uint16_t& paletteAdr) const;
     // Gets a chroma colour from the id of palette and bit of pixel
     uint8_t getChromaFromPaletteRam(const uint8_t& paletteID, const uint8_t& pixel) const;
+
+    // All of vram (0x0000-0x3FFF) as vRamRead sees it, copied once a frame is done so the viewers
+    // can look at it on another thread while the ppu runs on
+    struct VideoMemory {
+        std::array<uint8_t, 0x4000> vram{};
+        // The ppu's tile cache, so the viewers don't decode every tile again
+        std::array<PatternTableT, 0x200> tiles{};
+
+        uint8_t read(const uint16_t& adr) const { return vram[adr & 0x3FFF]; }
+        // The same as the viewer functions of the ppu, but reading from the copy
+        PatternTableT getPatternTile(const uint16_t& tileAddress) const;
+        PatternTableT getPatternTile(const uint8_t& tileID, bool isLeft) const;
+        uint8_t getPaletteFromNameTable(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const;
+        ColorSetT getColorSetFromAdr(const uint16_t& paletteAdr) const;
+    };
+    // Copies all of vram into out
+    void copyVideoMemory(VideoMemory& out) const;
 private:
     // Helper functions for getPalette
     // Get the bit shift required from the byte of the attribute table for the nametable
     // for the correct palette to be selected
-    uint8_t getShift(const uint16_t& nameTableRelativeAdr) const;
+    static uint8_t getShift(const uint16_t& nameTableRelativeAdr);
     // Get the Attribute tile address from the nametable address
-    uint16_t getAtrAddress(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const;
+    static uint16_t getAtrAddress(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart);
+    // The viewer functions of the ppu and of VideoMemory only differ in where vram is read from,
+    // read(adr) is either vRamRead or VideoMemory::read
+    template<typename Read> static PatternTableT readPatternTile(const Read& read, const uint16_t& tileAddress);
+    template<typename Read> static uint8_t readPaletteFromNameTable(const Read& read, const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart);
+    template<typename Read> static ColorSetT readColorSet(const Read& read, const uint16_t& paletteAdr);
 
 public:
     // Indicator variable for when an entire frame of the ppu has completed
     // at this point its best to draw
     bool completeFrame = false;
+    // Amount of frames completed, unlike completeFrame this is never cleared by the ppu
+    uint64_t frameCount = 0;
     // Completely clears all variables
     void clear();
+    // Bytes of vram this ppu holds on its own, pages still shared with a copy aren't counted
+    size_t ownedBytes() const noexcept;
+    // Registers, position, latches and shifters, nametables, palettes and OAM
+    // The pattern tables and mirroring belong to the mapper, loading must be followed by setting them
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
 private:
-    std::shared_ptr<NES> nes;
+    NES* nes = nullptr;
     static const std::array<const PaletteT, 0x40 > RGBPaletteTable;
 
 
@@ -153,10 +205,38 @@ private:
 
     // Ppu has its own RAM on its own bus separate from the CPU
     // See memory map https://wiki.nesdev.com/w/index.php/PPU_memory_map for it's details
-    std::array<uint8_t, memsize::KB16> memory{};
+    // It's 1KB pages a copy of the ppu shares until one of them writes to it, so every write goes through writableMemory
+    CowPages<0x400, 16> memory;
+    // Pattern tables 0x0000-0x1FFF are eight 1KB pages belonging to the cartridge
+    std::array<const uint8_t*, 8> chrPages{};
+    std::array<uint8_t*, 8> chrWritePages{};
+    // Without a cartridge they're the first 8 pages of memory instead
+    bool chrInMemory = false;
+    void mapChrToMemory() noexcept;
+    // Points the pattern tables (without a cartridge), nametables and palette at the pages they are in
+    void mapMemory() noexcept;
+    // A page of memory that isn't shared with a copy anymore
+    uint8_t* writableMemory(const uint8_t& page);
+
+    // Every tile of both pattern tables already decoded into PatternTableT lines
+    // A tile is decoded again the next time it's used after its bytes were written or its bank switched
+    static constexpr uint16_t TILES = 0x200;
+    mutable std::array<PatternTableT, TILES> tileCache{};
+    mutable std::array<bool, TILES> tileDirty{};
+    void invalidateTiles(const uint16_t& first, const uint16_t& count) noexcept;
+    // A line of a tile from its pattern table address, the address of the line's low bit plane
+    inline uint16_t getTileRow(const uint16_t& rowAddress) const;
+    const PatternTableT& getCachedTile(const uint16_t& tile) const;
+    // The 1KB of memory each of the four logical nametables is, see setMirroring
+    std::array<const uint8_t*, 4> nameTables{};
+    std::array<uint8_t, 4> nameTablePages{};
+    // Palette ram, 32 bytes at 0x3F00
+    const uint8_t* palette = nullptr;
+    // Palette ram address of each of the 32 palette entries, including mirrors
+    static const std::array<const uint8_t, 0x20> paletteIndex;
     // Oam is list of 64 sprites, each having info of 4 bytes
     // Description of each byte : https://wiki.nesdev.com/w/index.php/PPU_OAM
-    std::array<uint8_t, 0xFF> OAM{};
+    std::array<uint8_t, 0x100> OAM{};
     // Secondary OAM is the oam that is used during the next scanline, only 8 sprites are in this.
     // During rendering secondary oam is the sprites that are on the current scanline
     std::array<uint8_t, 0x20> secondOAM{};
@@ -169,20 +249,20 @@ private:
     // once the 8 cycles are done (then the shift registers has the next 8 pixels)
     uint8_t nameTableLatch = 0;
     uint8_t attrTableLatch = 0;
-    uint8_t patternTableLowLatch = 0;
-    uint8_t patternTableHighLatch = 0;
+    uint16_t patternRowLatch = 0; // both bit planes of the tile's line, decoded like PatternTableT
     // Functions used to fetch each latch
     void fetchNameTableByte();
     void fetchAttrTableByte();
-    void fetchPatternLowByte();
-    void fetchPatternHighByte();
+    void fetchPatternRow(); // both bit planes come from the tile cache in one fetch
     // Background Shift registers
     uint16_t attrShiftLow = 0;
     uint16_t attrShiftHigh = 0;
-    uint16_t bkShiftLow = 0;
-    uint16_t bkShiftHigh = 0;
+    // 16 pixels of 2 bits, the pixel being drawn in the lowest bits and the next tile in the upper 16 bits
+    uint32_t bkShift = 0;
     void shiftRegisters() noexcept;
     void updateShifters() noexcept;
+    // Used by runScanline, renders the 8 pixels of a tile from the shift registers and shifts them out
+    void renderTile(const uint16_t& firstCycle);
     // Four operations are done throughout the proccess of cycling
     // Increment the coarse X and Y variables to select a new tile
     void coraseXIncr(); // done every 8 cycles(needs the next tile)
@@ -194,6 +274,25 @@ private:
     void setVBlank();
     void clearVBlank();
 
+    // ----------- Mapper scanline counter -----------
+    // The counter is clocked by rising edges of A12 of the ppu address, normally once per scanline at a known cycle
+    static constexpr uint16_t NO_IRQ_DOT = 0xFFFF;
+    uint16_t scanlineIrqDot = NO_IRQ_DOT;
+    void clockScanlineIrq();
+    // Unusual pattern table setups watch A12 for every cycle instead
+    bool a12Tracking = false;
+    bool a12High = false;
+    uint64_t a12LowSince = 0;
+    void trackA12();
+
 
 };
+uint16_t Ppu::getTileRow(const uint16_t& rowAddress) const {
+    return getCachedTile(rowAddress >> 4)[rowAddress & 7];
+}
+
+bool Ppu::atScanlineStart() const noexcept {
+    return cycle == 0 && scanline >= 0 && scanline < 240 && !a12Tracking;
+}
+
 #endif // PPU_HPP
@@ -0,0 +1,54 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+class NES;
+
+// Keeps save states of the last frames to step back through, within a byte budget
+// Only the newest state is kept whole, every older one is the XOR against the one after it run length
+// encoded. Most of the ram, vram and OAM don't change between frames so those are mostly zero runs.
+// When over the budget the oldest states are dropped.
+class Rewind {
+public:
+    struct Stats {
+        size_t snapshots = 0;
+        size_t bytes = 0; // Used, including the whole newest state
+        size_t rawBytes = 0; // What the snapshots would take as whole states
+        double ratio = 0.0; // rawBytes / bytes
+        double seconds = 0.0; // Of play that can be rewound
+    };
+
+    // Takes a snapshot every interval frames
+    explicit Rewind(const size_t& budget = 64 * 1024 * 1024, const unsigned& interval = 1);
+
+    // Called after every frame, snapshots the nes when the interval is up
+    void frameDone(const NES& nes);
+    // Loads the newest snapshot into the nes and forgets it, false if there are none left
+    bool rewind(NES& nes);
+    void clear();
+
+    Stats stats() const;
+
+    // XOR of two equally sized buffers, run length encoded as pairs of (zero run, literal run) varints,
+    // each followed by the literal bytes
+    static void encodeDelta(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to, std::vector<uint8_t>& out);
+    // XORs an encoded delta back into the buffer, the buffer becomes the other side of the delta
+    static void applyDelta(const std::vector<uint8_t>& delta, std::vector<uint8_t>& buffer);
+
+private:
+    const size_t budget;
+    const unsigned interval;
+    unsigned frames = 0;
+
+    std::vector<uint8_t> newest; // Whole state of the newest snapshot, empty when there are none
+    std::vector<uint8_t> scratch;
+    // Each delta turns the snapshot after it into itself, the back is the one before newest
+    std::deque<std::vector<uint8_t>> deltas;
+    size_t deltaBytes = 0;
+};
+
+#endif // REWIND_H
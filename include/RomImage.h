@@ -0,0 +1,61 @@
+#ifndef ROMIMAGE_HPP
+#define ROMIMAGE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "GamePak.h"
+
+// An iNES file mapped into memory, see https://wiki.nesdev.com/w/index.php/INES
+// The file is mmap'd where possible, otherwise it is read once into a single aligned buffer
+// Prg and chr rom are read only spans into it, mappers map their banks straight from them
+class RomImage {
+public:
+    // Header of the file, validated against the file's size before anything is mapped
+    struct Header {
+        uint8_t prgBanks = 0; // in 16kb units
+        uint8_t chrBanks = 0; // in 8kb units, 0 means the cart has chr ram
+        uint8_t mapper = 0;
+        GamePak::MIRRORT mirror = GamePak::HORIZONTAL;
+        bool trainer = false; // 512 bytes before the prg rom
+        bool fourScreen = false;
+        uint8_t flags6 = 0, flags7 = 0, flags8 = 0, flags9 = 0, flags10 = 0;
+    };
+
+    // Throws if the file can't be opened or is not a valid iNES file
+    // A file that is already open gives the image that's open, every nes of one rom shares a single image
+    static std::shared_ptr<const RomImage> open(const std::string& fname);
+    // Parses and validates a header given the size of the whole file, throws if it's invalid
+    static Header parseHeader(const uint8_t* bytes, const size_t& fileSize);
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+    ~RomImage();
+
+    const uint8_t* prg() const noexcept { return prgRom; }
+    const uint8_t* chr() const noexcept { return chrRom; }
+    size_t prgSize = 0;
+    size_t chrSize = 0;
+    Header header;
+    // FNV-1a of the prg and chr, save states record it instead of the rom
+    uint64_t hash = 0;
+
+private:
+    RomImage() = default;
+    // Maps or reads the file, open() first looks for an image of it that's already open
+    static std::shared_ptr<const RomImage> load(const std::string& fname);
+    // The whole file, either mapped or in buffer
+    const uint8_t* file = nullptr;
+    size_t fileSize = 0;
+    bool mapped = false;
+    std::unique_ptr<uint8_t[]> buffer;
+    const uint8_t* prgRom = nullptr;
+    const uint8_t* chrRom = nullptr;
+
+    bool mapFile(const std::string& fname);
+    void readFile(const std::string& fname);
+};
+
+#endif // ROMIMAGE_HPP
@@ -0,0 +1,36 @@
+#ifndef RUNAHEAD_H
+#define RUNAHEAD_H
+
+#include <cstdint>
+#include <vector>
+
+class NES;
+
+// Hides the input lag a game has internally by showing the frame that is some frames ahead of the real one
+// The real frame is run without drawing and saved, then the frames ahead are run with the input held now,
+// only the last of them drawn, and the nes is put back to the real frame. A game that reacts to a button a
+// frame or two late then shows the reaction on the frame the button was pressed.
+// Each frame ahead costs a whole extra frame of cpu, plus one save state and one load.
+class RunAhead {
+public:
+    static constexpr unsigned MAX_FRAMES = 4;
+
+    explicit RunAhead(const unsigned& frames = 0);
+
+    // Clamped to MAX_FRAMES, 0 turns it off
+    void setFrames(const unsigned& frames);
+    unsigned frames() const;
+
+    // Runs the next real frame of the nes and draws the one frames() ahead of it
+    void runFrame(NES& nes);
+    // The same for a real frame the caller runs (like a movie frame), call these around it
+    // Before it the drawing is turned off if running ahead, after it the frames ahead are run and the nes put back
+    void startFrame(NES& nes) const;
+    void finishFrame(NES& nes);
+
+private:
+    unsigned ahead;
+    std::vector<uint8_t> state; // Of the real frame, kept to reuse its capacity
+};
+
+#endif // RUNAHEAD_H
@@ -0,0 +1,76 @@
+#ifndef SAVESTATE_HPP
+#define SAVESTATE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Save states are a flat binary blob, each component appends its fields in a fixed order and reads them
+// back in the same order. Values are stored as their in-memory bytes (little endian on every platform we
+// build for), so nothing is encoded and a whole state is a handful of memcpys.
+// The layout is versioned by NES::STATE_VERSION, bump it whenever a field is added, removed or reordered.
+
+class StateWriter {
+public:
+    // Appends to the end of the given buffer, reusing its capacity
+    explicit StateWriter(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+
+    template<typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be saved");
+        write(&value, sizeof(T));
+    }
+    void write(const void* data, const size_t& size) {
+        const size_t at = buffer.size();
+        buffer.resize(at + size);
+        std::memcpy(buffer.data() + at, data, size);
+    }
+
+private:
+    std::vector<uint8_t>& buffer;
+};
+
+class StateReader {
+public:
+    StateReader(const uint8_t* data, const size_t& size) : data(data), size(size) {}
+
+    template<typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values can be loaded");
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+    template<typename T>
+    void read(T& value) {
+        value = read<T>();
+    }
+    void read(void* out, const size_t& count) {
+        if (count > size - pos)
+            throw std::runtime_error("Save state is truncated");
+        std::memcpy(out, data + pos, count);
+        pos += count;
+    }
+    bool atEnd() const noexcept {
+        return pos == size;
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+};
+
+// 64 bit FNV-1a, identifies the rom a state belongs to
+inline uint64_t fnv1a(const uint8_t* data, const size_t& size, uint64_t hash = 0xCBF29CE484222325ull) {
+    for (size_t i = 0; i != size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+#endif // SAVESTATE_HPP
@@ -0,0 +1,43 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Wait free bounded queue for a single producer thread and a single consumer thread
+// push and pop never block or loop, they fail instead when the queue is full or empty
+// Size must be a power of two
+template<typename T, size_t Size>
+class SpscQueue {
+    static_assert(Size != 0 && (Size & (Size - 1)) == 0, "SpscQueue size must be a power of two");
+public:
+    // Producer side, false if the queue is full and the value was not added
+    bool push(T value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Size)
+            return false;
+        slots[t & (Size - 1)] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, false if the queue is empty and value was untouched
+    bool pop(T& value) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(slots[h & (Size - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Size> slots{};
+    // Only ever increase, the slot is the count modulo Size
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif // SPSCQUEUE_HPP
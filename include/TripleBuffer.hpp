@@ -0,0 +1,48 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock free hand off of whole values from one writer thread to one reader thread
+// The writer fills writeBuffer() then publishes it, the reader calls update() to swap in the newest
+// published buffer and reads it with readBuffer(). Neither side ever waits on the other, if the writer is
+// faster the frames the reader didn't pick up are dropped, if the reader is faster it keeps the last one.
+template<typename T>
+class TripleBuffer {
+public:
+    // Writer side
+    T& writeBuffer() {
+        return buffers[back];
+    }
+    // Makes the write buffer the newest, the writer gets the old middle buffer to write into next
+    void publish() {
+        back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side
+    // Swaps in the newest published buffer, false if nothing was published since the last update
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & DIRTY))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& readBuffer() const {
+        return buffers[front];
+    }
+
+private:
+    // middle holds the index of the buffer between the two threads, DIRTY is set when it was published
+    // and not yet picked up by the reader
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t DIRTY = 0x4;
+    std::array<T, 3> buffers{};
+    // The two sides are on seperate cache lines so they don't bounce between the threads
+    alignas(64) uint8_t back = 0;
+    alignas(64) uint8_t front = 1;
+    alignas(64) std::atomic<uint8_t> middle{2};
+};
+
+#endif // TRIPLEBUFFER_HPP
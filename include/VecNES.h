@@ -0,0 +1,85 @@
+#ifndef VECNES_H
+#define VECNES_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NES.h"
+
+// Steps many independent NES of one rom a frame at a time, for training agents on them
+// Every step runs one frame of each nes with its action (player 1's buttons) and leaves the observations
+// of all of them in one contiguous buffer each, which are allocated once up front. Each step is split
+// over a pool of threads that take the next nes as soon as they finish one, so a slow nes only holds up
+// the thread that runs it. The rom is parsed once, every nes is a clone of the first one and a reset
+// loads the power on state saved when it was made.
+class VecNES {
+public:
+    enum Observation : uint8_t {
+        SCREEN = 0x1, // Palette indices of the frame, 256x240 per nes, see Ppu::ARGBPaletteTable
+        RAM = 0x2 // The work ram, Memory::RAM_SIZE per nes
+    };
+    static constexpr size_t SCREEN_SIZE = 256 * 240;
+
+    // Threads 0 uses one per core, the thread calling step is one of them
+    VecNES(const std::string& rom, const size_t& count, const uint8_t& observations = SCREEN | RAM, const unsigned& threads = 0);
+    ~VecNES(); // Stops and joins the pool
+    VecNES(const VecNES&) = delete;
+    VecNES& operator=(const VecNES&) = delete;
+
+    size_t size() const;
+    unsigned threads() const;
+
+    // Runs a frame of every nes with actions[i] held on nes i's player 1, then fills the observations
+    // Rethrows the first error a nes threw, the other nes still ran their frame
+    void step(const uint8_t* actions);
+    void step(const std::vector<uint8_t>& actions);
+    // Back to the power on state, with its observation
+    void reset(const size_t& index);
+    void resetAll();
+
+    // Nes i's observation starts at screens() + i * SCREEN_SIZE and ram() + i * Memory::RAM_SIZE
+    // nullptr if not observed, both stay valid for the VecNES's lifetime
+    const uint8_t* screens() const;
+    const uint8_t* ram() const;
+
+    // For anything not observed, not to be touched while step runs
+    NES& operator[](const size_t& index);
+    const NES& operator[](const size_t& index) const;
+
+private:
+    const uint8_t observations;
+    std::vector<std::shared_ptr<NES>> nes;
+    std::vector<uint8_t> powerOnState;
+    std::vector<uint8_t> screenBuffer;
+    std::vector<uint8_t> ramBuffer;
+
+    void observe(const size_t& index);
+    void runFrame(const size_t& index);
+    // Runs frames until every nes of the step was taken
+    void work();
+    void poolThread();
+
+    // The step being run, workers take the next nes from next
+    const uint8_t* actions = nullptr;
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    std::mutex mutex;
+    std::condition_variable wake; // A new step or quitting
+    std::condition_variable finished; // Every nes of the step is done
+    uint64_t generation = 0; // Steps started, guarded by mutex
+    size_t working = 0; // Pool threads still in the step, guarded by mutex
+    bool quit = false;
+    std::vector<std::thread> pool;
+};
+
+#endif // VECNES_H
@@ -2,8 +2,13 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QImage>
+#include <QElapsedTimer>
 #include <memory>
+#include <array>
+#include <map>
 #include "NES.h"
+#include "EmulationThread.h"
 
 #include "nametableview.hpp"
 #include "patterntableview.hpp"
@@ -29,18 +34,50 @@ protected:
     void virtual keyReleaseEvent(QKeyEvent* key) override;
 
 private:
-    static inline void setPaintColour(QPainter& painter, const QColor& c);
     void paint();
+    void setupScreen();
+    QRect screenRect() const;
     void timeTick();
 
     void loadFile();
+    void recordMovie();
+    void playMovie();
+    void sendCommand(const EmulationThread::Command::Type& type);
+    void loadKeyMap();
+    void setKey(QKeyEvent* key, const bool& pressed);
+    void reportLatency(const EmulationThread::Frame& frame);
     void sendMessage(const QString&, const QString& title = "Message");
 
     Ui::MainWindow *ui;
     std::shared_ptr<NES> nes;
-    NameTableView* nameTableViewer;
-    PatternTableView* patternTableViewer;
+    // Not made by the debugging constructor
+    NameTableView* nameTableViewer = nullptr;
+    PatternTableView* patternTableViewer = nullptr;
     QTimer* timer;
+    // The nes runs on this thread, the ui only ever reads its finished frames
+    // The debug viewers get the copies of vram that come with the frames
+    std::unique_ptr<EmulationThread> emulator;
+    static constexpr int POLL_MS = 2;
+
+    // Qt key to the controller button it presses, read from the keymap group of the settings
+    struct KeyBinding {
+        uint8_t player;
+        uint8_t button;
+    };
+    std::map<int, KeyBinding> keyMap;
+    std::array<uint8_t, 2> held{}; // Buttons held by each player
+    int rewindKey = 0; // Rewinds while held, 0 if unbound
+    // When set key events are timestamped, and the time until the game latched them and until the
+    // frame they were latched in was painted are printed
+    bool measureLatency = false;
+    uint64_t lastLatencyFrame = 0;
+    // When set the presentation time of the last frames, the pacing and the rewind buffer are shown in
+    // the title every PRESENT_REPORT frames, otherwise it's just YaNES
+    bool showFrameStats = false;
+    QElapsedTimer presentTimer;
+    qint64 presentNs = 0;
+    int presentCount = 0;
+    static constexpr int PRESENT_REPORT = 60;
 
 };
 
@@ -6,23 +6,25 @@
 #include <QPainter>
 #include <iostream>
 #include "ui_nametableview.h"
-#include "NES.h"
+#include "Ppu.h"
 #include "functions.hpp"
 
 namespace Ui {
 class NameTableView;
 }
 
+// Draws the first nametable from the vram copies handed over with the emulation thread's frames,
+// it never touches the running nes
 class NameTableView : public QWidget {
     Q_OBJECT
 public:
-    inline NameTableView(std::shared_ptr<NES> nes, QWidget *parent = nullptr);
-    inline NameTableView(std::shared_ptr<NES> nes, bool shouldStepNes, QWidget *parent = nullptr);
+    inline explicit NameTableView(QWidget *parent = nullptr);
     inline ~NameTableView() override;
+    // Keeps a copy of video, it's drawn on the next repaint
+    inline void setVideoMemory(const Ppu::VideoMemory& video);
 
 private:
-    inline void stepTimeTick();
-    inline void noStepTimeTick();
+    inline void timeTick();
     inline void paintEvent(QPaintEvent*) override;
     inline void paint();
     inline QColor getPalQColor(const uint8_t& colorByte) const;
@@ -30,50 +32,34 @@ private:
     inline void setColorSet(const uint16_t&);
     Ppu::ColorSetT colorSet;
     Ui::NameTableView *ui;
-    std::shared_ptr<NES> nes;
+    Ppu::VideoMemory video;
+    bool hasVideo = false;
     QTimer* timer;
 };
 
-NameTableView::NameTableView(std::shared_ptr<NES> nes, QWidget *parent) : QWidget(parent), ui(new Ui::NameTableView) {
+NameTableView::NameTableView(QWidget *parent) : QWidget(parent), ui(new Ui::NameTableView) {
     ui->setupUi(this);
-    this->nes = nes;
-}
-
-NameTableView::NameTableView(std::shared_ptr<NES> nes, bool shouldStepNes, QWidget *parent) : QWidget(parent), ui(new Ui::NameTableView) {
-    ui->setupUi(this);
-    this->nes = nes;
     timer = new QTimer(this);
-    if (shouldStepNes) {
-        connect(timer, &QTimer::timeout, this, &NameTableView::stepTimeTick);
-        timer->start(0);
-    }
-    else {
-        connect(timer, &QTimer::timeout, this, &NameTableView::noStepTimeTick);
-        timer->start(3000);
-    }
+    connect(timer, &QTimer::timeout, this, &NameTableView::timeTick);
+    timer->start(3000);
 }
 
 NameTableView::~NameTableView() {
     delete ui;
 }
 
-void NameTableView::stepTimeTick() {
-    for(unsigned i = 0 ; i != 15; ++i) nes->step();
-
-    if (nes->ppu.completeFrame) {
-        nes->ppu.completeFrame = false;
-        repaint();
-    }
+void NameTableView::setVideoMemory(const Ppu::VideoMemory& video) {
+    this->video = video;
+    hasVideo = true;
 }
 
-void NameTableView::noStepTimeTick() {
-    // very hacky way to tell if the NES is running something
-    if (nes->getBaseName().size() > 1)
+void NameTableView::timeTick() {
+    if (hasVideo)
         this->repaint();
 }
 
 void NameTableView::paintEvent(QPaintEvent *) {
-    if (nes->getBaseName().size() > 1)
+    if (hasVideo)
         paint();
 }
 
@@ -95,16 +81,16 @@ QColor NameTableView::getColor(const uint8_t &n) const {
 void NameTableView::setColorSet(const uint16_t& relNameTableAdr) {
     // PaletteId of the nametable determines which palette to talk to
     // and what bits the colours represent.
-    uint8_t paletteID = nes->ppu.getPaletteFromNameTable(relNameTableAdr, 0x23C0);
+    uint8_t paletteID = video.getPaletteFromNameTable(relNameTableAdr, 0x23C0);
     switch (paletteID) {
         case 0:
-            colorSet = nes->ppu.getColorSetFromAdr(0x3F01); break;
+            colorSet = video.getColorSetFromAdr(0x3F01); break;
         case 1:
-            colorSet = nes->ppu.getColorSetFromAdr(0x3F05); break;
+            colorSet = video.getColorSetFromAdr(0x3F05); break;
         case 2:
-            colorSet = nes->ppu.getColorSetFromAdr(0x3F09); break;
+            colorSet = video.getColorSetFromAdr(0x3F09); break;
         case 3:
-            colorSet = nes->ppu.getColorSetFromAdr(0x3F0D); break;
+            colorSet = video.getColorSetFromAdr(0x3F0D); break;
         default:
             throw std::runtime_error("Could not get proper palette id");
     }
@@ -131,10 +117,10 @@ void NameTableView::paint() {
         // The screen is a 32x30 tile screen, so to put it on, 32*8 and 30*8 for 256x240 NES screen size
         uint8_t addressX = tileNum % 32;
         uint8_t addressY = static_cast<uint8_t>(static_cast<int>(tileNum / 32));
-        uint8_t byte = nes->ppu.vRamRead(address);
+        uint8_t byte = video.read(address);
         // NOTE/TODO: It was noticed in donkey kong its always the 2nd/left pattern table
         // In other games it's probably determined by the bit in the ppu's ctrl
-        Ppu::PatternTableT tile = nes->ppu.getPatternTile(byte, false);
+        Ppu::PatternTableT tile = video.getPatternTile(byte, false);
         for (uint8_t tileY = 0; tileY != 8; tileY++) {
             uint16_t line = tile[tileY];
             for (uint8_t tileX = 0; tileX != 8; tileX++) {
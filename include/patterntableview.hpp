@@ -9,7 +9,6 @@
 #include <memory>
 #include <iostream>
 #include "ui_patterntableview.h"
-#include "NES.h"
 #include "Ppu.h"
 #include "functions.hpp" // apply_from_tuple()
 
@@ -17,16 +16,19 @@ namespace Ui {
 class PatternTableView;
 }
 
+// Draws both pattern tables and the palettes from the vram copies handed over with the emulation
+// thread's frames, it never touches the running nes
 class PatternTableView : public QWidget {
     Q_OBJECT
 public:
-    inline explicit PatternTableView(std::shared_ptr<NES> nes, bool stepNES, QWidget *parent = nullptr);
+    inline explicit PatternTableView(QWidget *parent = nullptr);
     inline virtual ~PatternTableView() override;
+    // Keeps a copy of video, it's drawn on the next repaint
+    inline void setVideoMemory(const Ppu::VideoMemory& video);
 
 private:
     inline void paint();
-    inline void stepNES();
-    inline void noStepNES();
+    inline void timeTick();
 
     inline void paintEvent(QPaintEvent*) override;
     static inline constexpr auto getColor(const uint8_t&);
@@ -37,49 +39,36 @@ private:
     inline void drawPalette(QPainter& painter, const uint16_t& startAdr, const int& originX, const int& originY, const bool& isGroup = true);
 
     Ui::PatternTableView *ui;
-    std::shared_ptr<NES> nes;
+    Ppu::VideoMemory video;
+    bool hasVideo = false;
     QTimer* timer;
     uint8_t resizeFactor = 2;
 };
 
-PatternTableView::PatternTableView(std::shared_ptr<NES> nes, bool stepNES, QWidget *parent) : QWidget(parent), ui(new Ui::PatternTableView) {
+PatternTableView::PatternTableView(QWidget *parent) : QWidget(parent), ui(new Ui::PatternTableView) {
     ui->setupUi(this);
-    this->nes = nes;
     timer = new QTimer(this);
-    if (stepNES) {
-        connect(timer, &QTimer::timeout, this, &PatternTableView::stepNES);
-        timer->start(0);
-    }
-    else {
-        connect(timer, &QTimer::timeout, this, &PatternTableView::noStepNES);
-        timer->start(5000);
-    }
-
+    connect(timer, &QTimer::timeout, this, &PatternTableView::timeTick);
+    timer->start(5000);
 }
 
 PatternTableView::~PatternTableView() {
     delete ui;
 }
 
-inline void PatternTableView::stepNES() {
-    for(unsigned i = 0 ; i != 5; ++i) nes->step();
-
-    if (nes->ppu.completeFrame) {
-        nes->ppu.completeFrame = false;
-        repaint();
-    }
+void PatternTableView::setVideoMemory(const Ppu::VideoMemory& video) {
+    this->video = video;
+    hasVideo = true;
 }
 
-
-inline void PatternTableView::noStepNES() {
-    // very hacky way to tell if the NES is running something
-    if (nes->getBaseName().size() > 1)
+inline void PatternTableView::timeTick() {
+    if (hasVideo)
         repaint();
 }
 
 
 void PatternTableView::paintEvent(QPaintEvent *) {
-    if (nes->getBaseName().size() > 1)
+    if (hasVideo)
         paint();
 }
 
@@ -100,7 +89,7 @@ void PatternTableView::setColor(QPainter& painter, const QColor& color) {
 
 inline void PatternTableView::drawPatternTable(QPainter& painter, const uint16_t& startAdr, const int& originX, const int& originY) {
     for (uint16_t tileAddr = startAdr, tileCount = 0 ; tileAddr < startAdr + 0x1000; tileAddr += 16, ++tileCount) {
-        Ppu::PatternTableT tile = nes->ppu.getPatternTile(tileAddr);
+        Ppu::PatternTableT tile = video.getPatternTile(tileAddr);
         for (uint8_t y = 0; y != 8; y++) {
             uint16_t line = tile[y];
             for (uint8_t x = 0; x != 8; x++) {
@@ -117,7 +106,7 @@ inline void PatternTableView::drawPatternTable(QPainter& painter, const uint16_t
 }
 
 QColor PatternTableView::getPalQColor(const uint16_t &address) const {
-    uint8_t colorByte = nes->ppu.vRamRead(address);
+    uint8_t colorByte = video.read(address);
     Ppu::PaletteT universalPalette = Ppu::getRGBPalette(colorByte & 0x3F);
     return apply_from_tuple(qRgb, universalPalette);
 }
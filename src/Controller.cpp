@@ -0,0 +1,78 @@
+#include "Controller.h"
+#include "SaveState.hpp"
+
+#include <chrono>
+
+Controller::Controller(const Controller& other) {
+    *this = other;
+}
+
+Controller& Controller::operator=(const Controller& other) {
+    buttons = other.buttons.load();
+    eventTime = other.eventTime.load();
+    shift = other.shift;
+    strobe = other.strobe;
+    latchedEvent = other.latchedEvent;
+    latchTime = other.latchTime;
+    return *this;
+}
+
+// The buttons are stored before the event time so whoever sees the time also sees the buttons
+void Controller::setButtons(const uint8_t& buttons, const int64_t& eventTime) {
+    this->buttons.store(buttons, std::memory_order_release);
+    if (eventTime)
+        this->eventTime.store(eventTime, std::memory_order_release);
+}
+
+uint8_t Controller::getButtons() const {
+    return buttons.load(std::memory_order_relaxed);
+}
+
+// Latched while the strobe is high and once more when it goes low, the game reads what was held then
+void Controller::write(const uint8_t& val) {
+    const bool high = val & 0x1;
+    if (strobe || high)
+        latch();
+    strobe = high;
+}
+
+// After all 8 buttons an official controller returns 1s
+uint8_t Controller::read() {
+    if (strobe)
+        latch();
+    const uint8_t bit = shift & 0x1;
+    shift = static_cast<uint8_t>((shift >> 1) | 0x80);
+    return bit;
+}
+
+void Controller::latch() {
+    // Only pays for the clock when a measured event is waiting
+    const int64_t event = eventTime.exchange(0, std::memory_order_acquire);
+    shift = buttons.load(std::memory_order_acquire);
+    if (event && !latchedEvent) {
+        latchedEvent = event;
+        latchTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+void Controller::takeLatchedEvent(int64_t& eventTime, int64_t& latchTime) {
+    eventTime = latchedEvent;
+    latchTime = this->latchTime;
+    latchedEvent = this->latchTime = 0;
+}
+
+void Controller::clear() {
+    shift = 0;
+    strobe = false;
+    latchedEvent = latchTime = 0;
+}
+
+void Controller::saveState(StateWriter& state) const {
+    state.write(shift);
+    state.write(strobe);
+}
+
+void Controller::loadState(StateReader& state) {
+    state.read(shift);
+    state.read(strobe);
+}
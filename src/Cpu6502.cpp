@@ -1,24 +1,74 @@
-#include <iostream>
 #include <algorithm>
 #include <sstream>
 #include "Cpu6502.h"
 #include "functions.hpp" // toHex()
+#include "SaveState.hpp"
 
 #define EXECOPCODE(instrPtr, adringPtr) (this->*(instrPtr))((adringPtr))
 #define EXECADDRESSING(adringPtr) (this->*(adringPtr))()
 
+// Forces everything called inside a function to be inlined into it, used by the dispatcher
+#if defined(__GNUC__)
+#define FLATTEN __attribute__((flatten))
+#else
+#define FLATTEN
+#endif
+
 constexpr uint16_t Cpu6502::vectorNMI;
 constexpr uint16_t Cpu6502::vectorRESET;
 constexpr uint16_t Cpu6502::vectorIRQ;
 
-Cpu6502::Cpu6502() {
-    fillOpTable();
-
-}
-
-void Cpu6502::fillOpTable() {
+// Base cycles taken by each opcode, illegal opcodes are 0
+// https://www.masswerk.at/6502/6502_instruction_set.html
+const std::array<const uint8_t, 0x100> Cpu6502::cycleTable = {
+    //  X0 X1 X2 X3 X4 X5 X6 X7 X8 X9 XA XB XC XD XE XF
+/*0X*/ 7, 6, 0, 0, 0, 3, 5, 0, 3, 2, 2, 0, 0, 4, 6, 0,
+/*1X*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
+/*2X*/ 6, 6, 0, 0, 3, 3, 5, 0, 4, 2, 2, 0, 4, 4, 6, 0,
+/*3X*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
+/*4X*/ 6, 6, 0, 0, 0, 3, 5, 0, 3, 2, 2, 0, 3, 4, 6, 0,
+/*5X*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
+/*6X*/ 6, 6, 0, 0, 0, 3, 5, 0, 4, 2, 2, 0, 5, 4, 6, 0,
+/*7X*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
+/*8X*/ 0, 6, 0, 0, 3, 3, 3, 0, 2, 0, 2, 0, 4, 4, 4, 0,
+/*9X*/ 2, 6, 0, 0, 4, 4, 4, 0, 2, 5, 2, 0, 0, 5, 0, 0,
+/*AX*/ 2, 6, 2, 0, 3, 3, 3, 0, 2, 2, 2, 0, 4, 4, 4, 0,
+/*BX*/ 2, 5, 0, 0, 4, 4, 4, 0, 2, 4, 2, 0, 4, 4, 4, 0,
+/*CX*/ 2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
+/*DX*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0,
+/*EX*/ 2, 6, 0, 0, 3, 3, 5, 0, 2, 2, 2, 0, 4, 4, 6, 0,
+/*FX*/ 2, 5, 0, 0, 0, 4, 6, 0, 2, 4, 0, 0, 0, 4, 7, 0
+};
+
+// Opcodes that take one more cycle when their indexed address crosses a page boundary
+// Only reading instructions pay this, stores and read-modify-writes always take the longer path
+const std::array<const uint8_t, 0x100> Cpu6502::pageCrossTable = {
+    //  X0 X1 X2 X3 X4 X5 X6 X7 X8 X9 XA XB XC XD XE XF
+/*0X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*1X*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
+/*2X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*3X*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
+/*4X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*5X*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
+/*6X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*7X*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
+/*8X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*9X*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*AX*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*BX*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0,
+/*CX*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*DX*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0,
+/*EX*/ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+/*FX*/ 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0
+};
+
+Cpu6502::Cpu6502() = default;
+
+constexpr Cpu6502::OpTable Cpu6502::createOpTable() {
     constexpr Instr illegalFunc = {&Cpu6502::OP_ILLEGAL, &Cpu6502::ADR_IMPLICIT};
-    std::fill(opcodeTable.begin(), opcodeTable.end(), illegalFunc);
+    OpTable opcodeTable{};
+    for (Instr& instr : opcodeTable.instrs)
+        instr = illegalFunc;
 
     /// ----- Storage Instructions ------
     ///
@@ -215,18 +265,262 @@ void Cpu6502::fillOpTable() {
     /// ----- System Instructions ------
     opcodeTable[0xEA] = {&Cpu6502::OP_NOP, &Cpu6502::ADR_IMPLICIT};
     opcodeTable[0x00] = {&Cpu6502::OP_BRK, &Cpu6502::ADR_IMPLICIT};
+    return opcodeTable;
+}
+
+// Constant initialized from the constexpr createOpTable
+const Cpu6502::OpTable Cpu6502::opcodeTable = Cpu6502::createOpTable();
+
+
+// Each (instruction, addressing) pair gets its own instantiation, both member pointers
+// are compile time constants so the opcode and its addressing mode can be inlined into execute()
+template<Cpu6502::InstrFuncPtr instrPtr, Cpu6502::AddressingPtr adringPtr>
+FLATTEN inline void Cpu6502::dispatch() {
+    AddressingPtr adr = adringPtr;
+    EXECOPCODE(instrPtr, adr);
+}
+
+#define DISPATCH(opcode, instr, adring) case opcode: dispatch<&Cpu6502::OP_##instr, &Cpu6502::ADR_##adring>(); break;
+
+// Same mapping as fillOpTable(), but resolved at compile time into a single jump table
+void Cpu6502::execute(const uint8_t& opcode) {
+    switch(opcode) {
+        /// ----- Storage Instructions ------
+        ///
+        ///
+        // LDA
+        DISPATCH(0xA9, LDA, IMMEDIATE)
+        DISPATCH(0xA5, LDA, ZEROPAGE)
+        DISPATCH(0xB5, LDA, ZEROPAGEX)
+        DISPATCH(0xAD, LDA, ABS)
+        DISPATCH(0xBD, LDA, ABSX)
+        DISPATCH(0xB9, LDA, ABSY)
+        DISPATCH(0xA1, LDA, INDEXINDIRECT)
+        DISPATCH(0xB1, LDA, INDRECTINDEX)
+        // LDX
+        DISPATCH(0xA2, LDX, IMMEDIATE)
+        DISPATCH(0xA6, LDX, ZEROPAGE)
+        DISPATCH(0xB6, LDX, ZEROPAGEY)
+        DISPATCH(0xAE, LDX, ABS)
+        DISPATCH(0xBE, LDX, ABSY)
+        // LDY
+        DISPATCH(0xA0, LDY, IMMEDIATE)
+        DISPATCH(0xA4, LDY, ZEROPAGE)
+        DISPATCH(0xB4, LDY, ZEROPAGEX)
+        DISPATCH(0xAC, LDY, ABS)
+        DISPATCH(0xBC, LDY, ABSX)
+        // STA
+        DISPATCH(0x85, STA, ZEROPAGE)
+        DISPATCH(0x95, STA, ZEROPAGEX)
+        DISPATCH(0x8D, STA, ABS)
+        DISPATCH(0x9D, STA, ABSX)
+        DISPATCH(0x99, STA, ABSY)
+        DISPATCH(0x81, STA, INDEXINDIRECT)
+        DISPATCH(0x91, STA, INDRECTINDEX)
+        // STX
+        DISPATCH(0x86, STX, ZEROPAGE)
+        DISPATCH(0x96, STX, ZEROPAGEY)
+        DISPATCH(0x8E, STX, ABS)
+        // STY
+        DISPATCH(0x84, STY, ZEROPAGE)
+        DISPATCH(0x94, STY, ZEROPAGEX)
+        DISPATCH(0x8C, STY, ABS)
+        // Transfer instr
+        DISPATCH(0xAA, TAX, IMPLICIT)
+        DISPATCH(0xA8, TAY, IMPLICIT)
+        DISPATCH(0xBA, TSX, IMPLICIT)
+        DISPATCH(0x8A, TXA, IMPLICIT)
+        DISPATCH(0x9A, TXS, IMPLICIT)
+        DISPATCH(0x98, TYA, IMPLICIT)
+        /// ----- Math Instructions ------
+        ///
+        ///
+        // ADC
+        DISPATCH(0x69, ADC, IMMEDIATE)
+        DISPATCH(0x65, ADC, ZEROPAGE)
+        DISPATCH(0x75, ADC, ZEROPAGEX)
+        DISPATCH(0x6D, ADC, ABS)
+        DISPATCH(0x7D, ADC, ABSX)
+        DISPATCH(0x79, ADC, ABSY)
+        DISPATCH(0x61, ADC, INDEXINDIRECT)
+        DISPATCH(0x71, ADC, INDRECTINDEX)
+        // SBC
+        DISPATCH(0xE9, SBC, IMMEDIATE)
+        DISPATCH(0xE5, SBC, ZEROPAGE)
+        DISPATCH(0xF5, SBC, ZEROPAGEX)
+        DISPATCH(0xED, SBC, ABS)
+        DISPATCH(0xFD, SBC, ABSX)
+        DISPATCH(0xF9, SBC, ABSY)
+        DISPATCH(0xE1, SBC, INDEXINDIRECT)
+        DISPATCH(0xF1, SBC, INDRECTINDEX)
+        // Decrementing
+        DISPATCH(0xC6, DEC, ZEROPAGE)
+        DISPATCH(0xD6, DEC, ZEROPAGEX)
+        DISPATCH(0xCE, DEC, ABS)
+        DISPATCH(0xDE, DEC, ABSX)
+        DISPATCH(0xCA, DEX, IMPLICIT)
+        DISPATCH(0x88, DEY, IMPLICIT)
+        // Incrementing
+        DISPATCH(0xE6, INC, ZEROPAGE)
+        DISPATCH(0xF6, INC, ZEROPAGEX)
+        DISPATCH(0xEE, INC, ABS)
+        DISPATCH(0xFE, INC, ABSX)
+        DISPATCH(0xE8, INX, IMPLICIT)
+        DISPATCH(0xC8, INY, IMPLICIT)
+        /// ----- Bitwise Instructions -----
+        ///
+        ///
+        // AND
+        DISPATCH(0x29, AND, IMMEDIATE)
+        DISPATCH(0x25, AND, ZEROPAGE)
+        DISPATCH(0x35, AND, ZEROPAGEX)
+        DISPATCH(0x2D, AND, ABS)
+        DISPATCH(0x3D, AND, ABSX)
+        DISPATCH(0x39, AND, ABSY)
+        DISPATCH(0x21, AND, INDEXINDIRECT)
+        DISPATCH(0x31, AND, INDRECTINDEX)
+        // OR
+        DISPATCH(0x09, ORA, IMMEDIATE)
+        DISPATCH(0x05, ORA, ZEROPAGE)
+        DISPATCH(0x15, ORA, ZEROPAGEX)
+        DISPATCH(0x0D, ORA, ABS)
+        DISPATCH(0x1D, ORA, ABSX)
+        DISPATCH(0x19, ORA, ABSY)
+        DISPATCH(0x01, ORA, INDEXINDIRECT)
+        DISPATCH(0x11, ORA, INDRECTINDEX)
+        // EOR
+        DISPATCH(0x49, EOR, IMMEDIATE)
+        DISPATCH(0x45, EOR, ZEROPAGE)
+        DISPATCH(0x55, EOR, ZEROPAGEX)
+        DISPATCH(0x4D, EOR, ABS)
+        DISPATCH(0x5D, EOR, ABSX)
+        DISPATCH(0x59, EOR, ABSY)
+        DISPATCH(0x41, EOR, INDEXINDIRECT)
+        DISPATCH(0x51, EOR, INDRECTINDEX)
+        // BIT
+        DISPATCH(0x24, BIT, ZEROPAGE)
+        DISPATCH(0x2C, BIT, ABS)
+        // ASL
+        DISPATCH(0x0A, ASL, ACCUM)
+        DISPATCH(0x06, ASL, ZEROPAGE)
+        DISPATCH(0x16, ASL, ZEROPAGEX)
+        DISPATCH(0x0E, ASL, ABS)
+        DISPATCH(0x1E, ASL, ABSX)
+        // LSR
+        DISPATCH(0x4A, LSR, ACCUM)
+        DISPATCH(0x46, LSR, ZEROPAGE)
+        DISPATCH(0x56, LSR, ZEROPAGEX)
+        DISPATCH(0x4E, LSR, ABS)
+        DISPATCH(0x5E, LSR, ABSX)
+        // ROL
+        DISPATCH(0x2A, ROL, ACCUM)
+        DISPATCH(0x26, ROL, ZEROPAGE)
+        DISPATCH(0x36, ROL, ZEROPAGEX)
+        DISPATCH(0x2E, ROL, ABS)
+        DISPATCH(0x3E, ROL, ABSX)
+        // ROR
+        DISPATCH(0x6A, ROR, ACCUM)
+        DISPATCH(0x66, ROR, ZEROPAGE)
+        DISPATCH(0x76, ROR, ZEROPAGEX)
+        DISPATCH(0x6E, ROR, ABS)
+        DISPATCH(0x7E, ROR, ABSX)
+        /// ----- Branch Instructions -----
+        ///
+        ///
+        DISPATCH(0x10, BPL, RELATIVE)
+        DISPATCH(0x30, BMI, RELATIVE)
+        DISPATCH(0x50, BVC, RELATIVE)
+        DISPATCH(0x70, BVS, RELATIVE)
+        DISPATCH(0x90, BCC, RELATIVE)
+        DISPATCH(0xB0, BCS, RELATIVE)
+        DISPATCH(0xD0, BNE, RELATIVE)
+        DISPATCH(0xF0, BEQ, RELATIVE)
+
+        /// ----- Jump Instructions ------
+        ///
+        ///
+        DISPATCH(0x4C, JMP, ABS)
+        DISPATCH(0x6C, JMP, INDIRECT)
+        DISPATCH(0x20, JSR, ABS)
+        DISPATCH(0x60, RTS, IMPLICIT)
+        DISPATCH(0x40, RTI, IMPLICIT)
+
+        /// ----- Register Instructions ------
+        ///
+        ///
+        DISPATCH(0x18, CLC, IMPLICIT)
+        DISPATCH(0x38, SEC, IMPLICIT)
+        DISPATCH(0x58, CLI, IMPLICIT)
+        DISPATCH(0x78, SEI, IMPLICIT)
+        DISPATCH(0xB8, CLV, IMPLICIT)
+        DISPATCH(0xD8, CLD, IMPLICIT)
+        DISPATCH(0xF8, SED, IMPLICIT)
+        // CMP
+        DISPATCH(0xC9, CMP, IMMEDIATE)
+        DISPATCH(0xC5, CMP, ZEROPAGE)
+        DISPATCH(0xD5, CMP, ZEROPAGEX)
+        DISPATCH(0xCD, CMP, ABS)
+        DISPATCH(0xDD, CMP, ABSX)
+        DISPATCH(0xD9, CMP, ABSY)
+        DISPATCH(0xC1, CMP, INDEXINDIRECT)
+        DISPATCH(0xD1, CMP, INDRECTINDEX)
+        // CPX
+        DISPATCH(0xE0, CPX, IMMEDIATE)
+        DISPATCH(0xE4, CPX, ZEROPAGE)
+        DISPATCH(0xEC, CPX, ABS)
+        // CPY
+        DISPATCH(0xC0, CPY, IMMEDIATE)
+        DISPATCH(0xC4, CPY, ZEROPAGE)
+        DISPATCH(0xCC, CPY, ABS)
+        /// ----- Stack Instructions -------
+        DISPATCH(0x48, PHA, IMPLICIT)
+        DISPATCH(0x68, PLA, IMPLICIT)
+        DISPATCH(0x08, PHP, IMPLICIT)
+        DISPATCH(0x28, PLP, IMPLICIT)
+        /// ----- System Instructions ------
+        DISPATCH(0xEA, NOP, IMPLICIT)
+        DISPATCH(0x00, BRK, IMPLICIT)
+
+        default: {
+            AddressingPtr adr = &Cpu6502::ADR_IMPLICIT;
+            OP_ILLEGAL(adr);
+        }
+    }
 }
 
+#undef DISPATCH
 
 void Cpu6502::runCycle(const uint64_t& num) {
     for (uint64_t i = num; i != 0; --i) {
         uint8_t opcode = memory.read(pc);
-        Instr instruction = opcodeTable[opcode];
-        EXECOPCODE(instruction.instr, instruction.addr);
+        // The opcode table is kept as a slower reference path for debugging the dispatcher
+        if (useOpcodeTable) {
+            Instr instruction = opcodeTable[opcode];
+            EXECOPCODE(instruction.instr, instruction.addr);
+        }
+        else {
+            execute(opcode);
+        }
+        cycleCount += cycleTable[opcode] + (pageCrossed & pageCrossTable[opcode]);
+        pageCrossed = 0;
         ++instrCount;
+        // OAM DMA: the cpu is suspended while 256 bytes are copied to the ppu
+        // One more cycle is needed to align to an even cycle, counted from the end of the write
+        if (pendingDMA) {
+            pendingDMA = false;
+            cycleCount += 513 + (cycleCount & 1);
+        }
     }
 }
 
+uint64_t Cpu6502::instructions() const noexcept {
+    return instrCount;
+}
+
+uint64_t Cpu6502::cycles() const noexcept {
+    return cycleCount;
+}
+
 // A vector is a 'vector pointer' that consists of two parts a low and a high
 // Both parts cretae a program counter high and low value to where the pc should point
 //http://users.telenet.be/kim1-6502/6502/proman.html#90
@@ -237,33 +531,50 @@ void Cpu6502::runCycle(const uint64_t& num) {
 void Cpu6502::signalNMI() {
     status.b = 0;
     generateInterrupt(vectorNMI);
+    cycleCount += 7;
 }
 
 // Reset Signal: An interrupt that sends the pc to the reset vector
 // note that no stack operations are done
 void Cpu6502::signalRESET() {
     // Assumption that this also resets the state as well
-    pc = static_cast<uint16_t>( (static_cast<uint16_t>(memory[vectorRESET + 1]) << 8) | memory[vectorRESET] );
+    pc = static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(vectorRESET + 1)) << 8) | memory.read(vectorRESET) );
     status.reset();
     sp = 0xFD; // <- This is NES specific
     a = x = y = 0;
+    cycleCount += 7;
 }
 
 // Interrupt Request:
 void Cpu6502::signalIRQ() {
-    if (status.i == 0) {// allow interrupt
+    irqLine = true;
+    pollIRQ();
+}
+
+void Cpu6502::clearIRQ() noexcept {
+    irqLine = false;
+}
+
+inline void Cpu6502::pollIRQ() {
+    if (irqLine && status.i == 0) {// allow interrupt
         status.b = 0;
         generateInterrupt(vectorIRQ);
+        cycleCount += 7;
     }
 }
 
+// The write happens during the instruction, which isn't counted yet
+void Cpu6502::signalDMA() {
+    pendingDMA = true;
+}
+
 // Generates an interrupt by pushing the pc and stack and pointing pc to the new vector
 inline void Cpu6502::generateInterrupt(const uint16_t& vector) {
     PUSH((pc & 0xFF00) >> 8);
     PUSH(pc & 0xFF);
     PUSH(status);
     status.i = 1;
-    pc =  static_cast<uint16_t>( (static_cast<uint16_t>(memory[vector + 1]) << 8) | memory[vector] );
+    pc =  static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(vector + 1)) << 8) | memory.read(vector) );
 }
 
 ///
@@ -336,7 +647,9 @@ uint16_t Cpu6502::ADR_ABS() {
 // AbsoluteX: Similar to Absolute, but address is added with register X
 // Assumption that no wrapping occurs
 uint16_t Cpu6502::ADR_ABSX() {
-    uint16_t address = static_cast<uint16_t>( ((static_cast<uint16_t>(memory.read(pc + 2)) << 8) | memory.read(pc + 1)) + x );
+    uint16_t base = static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(pc + 2)) << 8) | memory.read(pc + 1) );
+    uint16_t address = base + x;
+    pageCrossed = (base & 0xFF00) != (address & 0xFF00);
     pc += 3;
     return address;
 }
@@ -344,7 +657,9 @@ uint16_t Cpu6502::ADR_ABSX() {
 // AbsoluteX: Similar to Absolute, but address is added with register Y
 // Assumption that no wrapping occurs
 uint16_t Cpu6502::ADR_ABSY() {
-    uint16_t address = static_cast<uint16_t>( ((static_cast<uint16_t>(memory.read(pc + 2)) << 8) | memory.read(pc + 1)) + y );
+    uint16_t base = static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(pc + 2)) << 8) | memory.read(pc + 1) );
+    uint16_t address = base + y;
+    pageCrossed = (base & 0xFF00) != (address & 0xFF00);
     pc += 3;
     return address;
 }
@@ -361,6 +676,7 @@ uint16_t Cpu6502::ADR_INDRECTINDEX() {
         address = static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(0)) << 8) | memory.read(p) );
     else
         address = static_cast<uint16_t>( (static_cast<uint16_t>(memory.read(p + 1)) << 8) | memory.read(p) );
+    pageCrossed = (address & 0xFF00) != ((address + y) & 0xFF00);
     address += y;
     pc += 2;
     return address;
@@ -402,7 +718,6 @@ uint16_t Cpu6502::ADR_INDIRECT() {
 
     if (lowByte == 0xFF) { // wraps to higbyte only, lowbits are all 0
         adrhByte = memory.read( static_cast<uint16_t>(static_cast<uint16_t>(highByte) << 8) );
-        std::cerr << "jmp indirect zero page boundary taken\n";
     }
     else
         adrhByte = memory.read(static_cast<uint16_t>( (static_cast<uint16_t>(highByte) << 8) | lowByte) + 1);
@@ -425,7 +740,10 @@ uint16_t Cpu6502::ADR_RELATIVE() {
     ++pc;
     if (offset & 0x80)
         offset |= 0xFF00;
-    return pc + offset;
+    uint16_t address = pc + offset;
+    // A taken branch is one cycle longer, and another if it lands on a different page
+    cycleCount += 1 + ((pc & 0xFF00) != (address & 0xFF00));
+    return address;
     /*
     uint16_t byte = memory.read(pc + 1);
     bool isPositive = (0x80 & byte) >> 7 == 0;
@@ -514,10 +832,6 @@ inline uint8_t Cpu6502::POP() {
 
 [[ noreturn ]]
 void Cpu6502::OP_ILLEGAL(AddressingPtr&) {
-    std::cerr << " In " << __FILE__ << std::hex
-              << " opcode " << static_cast<int>(memory.read(pc))
-              << " is ILLEGAL at address " << static_cast<int>(pc) << std::dec << "\n";
-
     throw std::runtime_error("Cpu illegal opcode failure, opcode : " + toHex(memory.read(pc)) + ", pc : " + toHex(pc));
 }
 
@@ -841,6 +1155,7 @@ void Cpu6502::OP_RTI(AddressingPtr& adr) {
     uint8_t low = POP(), high = POP();
     uint16_t address = static_cast<uint16_t>( (static_cast<uint16_t>(high) << 8) | low );
     pc = address;
+    pollIRQ();
 }
 
 
@@ -868,6 +1183,7 @@ void Cpu6502::OP_SEI(AddressingPtr& adr) {
 void Cpu6502::OP_CLI(AddressingPtr& adr) {
     EXECADDRESSING(adr);
     status.i = 0;
+    pollIRQ();
 }
 
 // Set Decimal
@@ -934,6 +1250,7 @@ void Cpu6502::OP_PLA(AddressingPtr& adr) {
 void Cpu6502::OP_PLP(AddressingPtr& adr) {
     EXECADDRESSING(adr);
     status.fromByte(POP());
+    pollIRQ();
 }
 
 
@@ -953,11 +1270,41 @@ void Cpu6502::OP_BRK(AddressingPtr& adr) {
 
 
 
+void Cpu6502::saveState(StateWriter& state) const {
+    state.write(a);
+    state.write(x);
+    state.write(y);
+    state.write(sp);
+    state.write(pc);
+    state.write(static_cast<uint8_t>(status));
+    state.write(cycleCount);
+    state.write(instrCount);
+    state.write(irqLine);
+    memory.saveState(state);
+}
+
+void Cpu6502::loadState(StateReader& state) {
+    state.read(a);
+    state.read(x);
+    state.read(y);
+    state.read(sp);
+    state.read(pc);
+    status.fromByte(state.read<uint8_t>());
+    state.read(cycleCount);
+    state.read(instrCount);
+    state.read(irqLine);
+    memory.loadState(state);
+}
+
 void Cpu6502::clear() {
     a = x = y = 0;
     sp = 0;
     pc = 0;
     cycleCount = 0;
+    instrCount = 0;
+    pageCrossed = 0;
+    pendingDMA = false;
+    irqLine = false;
     status.clear();
     memory.clear();
 }
@@ -0,0 +1,213 @@
+#include "EmulationThread.h"
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+EmulationThread::EmulationThread(std::shared_ptr<NES> nes, const bool& loaded, const bool& paced)
+    : nes(nes), paced(paced), loaded(loaded), thread(&EmulationThread::run, this) {}
+
+EmulationThread::~EmulationThread() {
+    Command command;
+    command.type = Command::QUIT;
+    // The thread drains the queue every millisecond at worst, so a full queue frees up quickly
+    while (!commands.push(command))
+        std::this_thread::yield();
+    thread.join();
+}
+
+bool EmulationThread::send(Command command) {
+    return commands.push(std::move(command));
+}
+
+bool EmulationThread::newFrame() {
+    return frames.update();
+}
+
+const EmulationThread::Frame& EmulationThread::frame() const {
+    return frames.readBuffer();
+}
+
+bool EmulationThread::popError(std::string& message) {
+    return errors.pop(message);
+}
+
+// Only touches the controller's atomics, which is why it's safe while the thread runs
+void EmulationThread::setButtons(const uint8_t& player, const uint8_t& buttons, const int64_t& eventTime) {
+    this->buttons[player & 0x1] = buttons;
+    if (liveInput)
+        nes->controllers[player & 0x1].setButtons(buttons, eventTime);
+}
+
+void EmulationThread::setVideoMemoryCopies(const bool& enabled) {
+    copyVideoMemory = enabled;
+}
+
+void EmulationThread::run() {
+    while (!quit) {
+        Command command;
+        while (!quit && commands.pop(command))
+            execute(command);
+        if (quit)
+            break;
+        if (!loaded || paused) {
+            // Nothing to run, check for commands again shortly
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            pacer.start();
+            continue;
+        }
+        if (rewinding)
+            rewindFrame();
+        else {
+            runFrame();
+            rewind.frameDone(*nes);
+        }
+        if (paced)
+            pacer.wait();
+    }
+    stopMovie();
+    nes->setFrameBuffer(nullptr, 0);
+}
+
+void EmulationThread::execute(Command& command) {
+    switch (command.type) {
+        case Command::LOAD:
+            try {
+                stopMovie();
+                nes->init();
+                nes->load(command.fname);
+                nes->powerUp();
+                romFile = command.fname;
+                rewind.clear();
+                loaded = true;
+                paused = false;
+            }
+            catch (const std::exception& e) {
+                // If the last rom was working it keeps running
+                errors.push(e.what());
+            }
+            break;
+        case Command::RESET:
+            if (loaded)
+                nes->powerUp();
+            break;
+        case Command::PAUSE:
+            paused = true;
+            break;
+        case Command::RESUME:
+            paused = false;
+            break;
+        case Command::QUIT:
+            quit = true;
+            break;
+        case Command::REWIND_START:
+            rewinding = movieMode == NO_MOVIE;
+            break;
+        case Command::REWIND_STOP:
+            rewinding = false;
+            break;
+        case Command::RECORD_MOVIE:
+        case Command::PLAY_MOVIE:
+            try {
+                if (romFile.empty())
+                    throw std::runtime_error("Load a rom before starting a movie");
+                stopMovie();
+                // Movies start from power on, not from wherever the running game is
+                nes->clear();
+                nes->init();
+                nes->load(romFile);
+                nes->powerUp();
+                if (command.type == Command::RECORD_MOVIE) {
+                    movie.startRecording(*nes);
+                    movieFile = command.fname;
+                    movieMode = RECORDING;
+                }
+                else {
+                    movie.load(command.fname);
+                    movie.seek(*nes, 0);
+                    movieMode = PLAYING;
+                }
+                liveInput = false;
+                rewinding = false;
+                rewind.clear();
+            }
+            catch (const std::exception& e) {
+                errors.push(e.what());
+            }
+            break;
+        case Command::STOP_MOVIE:
+            stopMovie();
+            break;
+        case Command::RUN_AHEAD:
+            runAhead.setFrames(command.frames);
+            break;
+    }
+}
+
+// The nes draws straight into the triple buffer's write buffer, which is published once the frame is done
+void EmulationThread::runFrame() {
+    Frame& frame = frames.writeBuffer();
+    nes->setFrameBuffer(frame.pixels.data(), 256 * sizeof(uint32_t));
+    emulateFrame();
+    nes->ppu.completeFrame = false;
+    frame.number = nes->ppu.frameCount;
+    frame.pacing = pacer.stats();
+    frame.rewind = rewind.stats();
+    frame.inputEvent = frame.inputLatch = 0;
+    for (Controller& controller : nes->controllers) {
+        int64_t event, latch;
+        controller.takeLatchedEvent(event, latch);
+        if (event && (!frame.inputEvent || event < frame.inputEvent)) {
+            frame.inputEvent = event;
+            frame.inputLatch = latch;
+        }
+    }
+    frame.hasVideoMemory = copyVideoMemory;
+    if (frame.hasVideoMemory)
+        nes->ppu.copyVideoMemory(frame.videoMemory);
+    frames.publish();
+}
+
+// Steps back to the newest snapshot and runs the frame after it again so there's a picture of it, that
+// frame isn't recorded so the next rewind goes further back. Out of snapshots it just holds still.
+void EmulationThread::rewindFrame() {
+    if (rewind.rewind(*nes))
+        runFrame();
+}
+
+// Only frames of live input or a recording run ahead, a movie that plays has no input lag to hide
+// and rewinding shows the frames as they were
+void EmulationThread::emulateFrame() {
+    if (movieMode == PLAYING) {
+        if (movie.playFrame(*nes))
+            return;
+        stopMovie();
+    }
+    if (rewinding) {
+        nes->runFrame();
+        return;
+    }
+    runAhead.startFrame(*nes);
+    if (movieMode == RECORDING)
+        movie.recordFrame(*nes, buttons[0], buttons[1]);
+    else
+        nes->runFrame();
+    runAhead.finishFrame(*nes);
+}
+
+// Saves a recording, and gives the controllers back to the keys
+void EmulationThread::stopMovie() {
+    if (movieMode == RECORDING) {
+        try {
+            movie.save(movieFile);
+        }
+        catch (const std::exception& e) {
+            errors.push(e.what());
+        }
+    }
+    movieMode = NO_MOVIE;
+    liveInput = true;
+    for (size_t player = 0; player != buttons.size(); ++player)
+        nes->controllers[player].setButtons(buttons[player]);
+}
@@ -0,0 +1,87 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// clock_nanosleep with an absolute deadline, std::this_thread::sleep_until elsewhere
+#if defined(__linux__)
+#define FRAMEPACER_NANOSLEEP
+#include <cerrno>
+#include <time.h>
+#endif
+
+constexpr double FramePacer::NTSC_RATE;
+constexpr size_t FramePacer::SAMPLES;
+
+FramePacer::FramePacer(const double& rate, const std::chrono::microseconds& spin)
+    : periodNs(1e9 / rate), spin(spin) {
+    if (!(rate > 0.0))
+        throw std::invalid_argument("Frame pacer rate must be positive");
+    start();
+}
+
+void FramePacer::start() {
+    origin = lastWake = clock::now();
+    frame = 0;
+}
+
+void FramePacer::wait() {
+    ++frame;
+    const clock::time_point deadline = origin + std::chrono::nanoseconds(std::llround(frame * periodNs));
+    clock::time_point now = clock::now();
+    // More than a frame behind, start over from now instead of running a burst of frames to catch up
+    if (now > deadline + std::chrono::nanoseconds(std::llround(periodNs))) {
+        record(now);
+        origin = now;
+        frame = 0;
+        return;
+    }
+
+    if (deadline - now > spin) {
+        const clock::time_point wake = deadline - spin;
+#ifdef FRAMEPACER_NANOSLEEP
+        // steady_clock is CLOCK_MONOTONIC on linux
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wake.time_since_epoch()).count();
+        timespec ts;
+        ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+        ts.tv_nsec = static_cast<long>(ns % 1000000000);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+        std::this_thread::sleep_until(wake);
+#endif
+    }
+    do {
+        now = clock::now();
+    } while (now < deadline);
+    record(now);
+}
+
+void FramePacer::record(const clock::time_point& now) {
+    samples[sampleCount % SAMPLES] = std::chrono::duration<double, std::milli>(now - lastWake).count();
+    lastWake = now;
+    if (++sampleCount % 60 == 0)
+        computeStats();
+}
+
+void FramePacer::computeStats() {
+    const size_t count = std::min(sampleCount, SAMPLES);
+    std::vector<double> sorted(samples.begin(), samples.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+    const double period = this->period();
+    current.frames = count;
+    current.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / count;
+    current.p99 = sorted[std::min(count - 1, static_cast<size_t>(std::ceil(count * 0.99)) - 1)];
+    current.maxJitter = std::max(std::abs(sorted.front() - period), std::abs(sorted.back() - period));
+}
+
+const FramePacer::Stats& FramePacer::stats() const {
+    return current;
+}
+
+double FramePacer::period() const {
+    return periodNs / 1e6;
+}
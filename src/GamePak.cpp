@@ -1,125 +1,87 @@
 #include "GamePak.h"
+#include "Mapper.h"
+#include "RomImage.h"
 #include "Memory.h"
 #include "Ppu.h"
 #include <string>
-#include <fstream>
-#include <iostream>
+#include <stdexcept>
 
 #include "functions.hpp"
 #include "NES.h"
 
+GamePak::GamePak() = default;
+
 GamePak::GamePak(std::shared_ptr<NES> nesptr) {
-    nes = nesptr;
+    nes = nesptr.get();
 }
 
+GamePak::~GamePak() = default;
+GamePak::GamePak(GamePak&&) = default;
+GamePak& GamePak::operator=(GamePak&&) = default;
+
+GamePak::GamePak(const GamePak& other) : PRG_ROM_sz(other.PRG_ROM_sz), CHR_ROM_sz(other.CHR_ROM_sz), mapperNum(other.mapperNum),
+    mirror(other.mirror), flags7(other.flags7), flags8(other.flags8), flags9(other.flags9), flags10(other.flags10),
+    rom(other.rom), mapper(other.mapper ? other.mapper->clone() : nullptr), nes(other.nes) {}
+
 void GamePak::setNESHandle(std::shared_ptr<NES> nes) & {
-    this->nes = nes;
+    this->nes = nes.get();
+    if (mapper)
+        mapBanks();
 }
 
+// Breaks down a INES file into components used by the emulator and tests
+// The rom is mapped once into a RomImage, the mapper then maps windows of it into the cpu and ppu
+// Refer to https://wiki.nesdev.com/w/index.php/CPU_memory_map and
+//  https://wiki.nesdev.com/w/index.php/INES
 void GamePak::load(const std::string& fname) {
     if (!nes) {
         throw std::runtime_error("Gamepak must have a NES handle before loading a file.");
     }
-    GamePak gamepak = load(nes->cpu.memory, nes->ppu, fname);
+    GamePak gamepak;
+    gamepak.nes = nes;
+    gamepak.rom = RomImage::open(fname);
+    const RomImage::Header& header = gamepak.rom->header;
+    gamepak.PRG_ROM_sz = header.prgBanks;
+    gamepak.CHR_ROM_sz = header.chrBanks;
+    gamepak.mapperNum = header.mapper;
+    gamepak.mirror = header.mirror;
+    gamepak.flags7 = header.flags7;
+    gamepak.flags8 = header.flags8;
+    gamepak.flags9 = header.flags9;
+    gamepak.flags10 = header.flags10;
+    gamepak.mapper = Mapper::create(gamepak.mapperNum, gamepak.rom, gamepak.mirror);
+
     std::swap(gamepak, *this);
+    mapBanks();
 }
 
-
-GamePak GamePak::load(Memory& memory, Ppu& ppu, const std::string& fname) {
-    std::ifstream ifs(fname, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
-    if (!ifs.good()) {
-        std::cerr << "File not found" << std::endl;
-        throw std::runtime_error("File not found, given path:" + fname);
-    }
-    GamePak pak = cpuLoad(memory, ifs);
-    // Remaining bytes are CHR_ROM
-    uint8_t byte;
-    auto read = [&ifs, &byte]() -> uint8_t {
-            ifs.read(reinterpret_cast<char*>(&byte), sizeof (uint8_t) );
-            return byte;
-    };
-    // Load the bytes of CHROM one to one onto the PPU memory bus
-    for (unsigned index = 0; index != memsize::KB16; index++) {
-        ppu.memory.at(index) = read();
-    }
-
-    return pak;
+// The ppu must see the old banks and irq counter up to this write
+void GamePak::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    if (!mapper)
+        return;
+    nes->catchUpPpu();
+    if (mapper->writeRegister(adr, val))
+        mapBanks();
+    if (!mapper->irq)
+        nes->cpu.clearIRQ();
+    // Irq registers change when the next irq happens
+    if (mapper->hasScanlineCounter())
+        nes->updatePpuDeadline();
 }
 
-
-// This loading scheme is used only by the
-GamePak GamePak::load(Memory& memory, const std::string& fname) {
-    std::ifstream ifs(fname, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
-    if (!ifs.good()) {
-        std::cerr << "File not found" << std::endl;
-        throw std::runtime_error("File not found, given path:" + fname);
-    }
-    return cpuLoad(memory, ifs);
+void GamePak::saveState(StateWriter& state) const {
+    mapper->saveState(state);
 }
 
-
-// Breaks down a INES file into components used by the emulator and tests
-// Refer to https://wiki.nesdev.com/w/index.php/CPU_memory_map and
-//  https://wiki.nesdev.com/w/index.php/INES
-GamePak GamePak::cpuLoad(Memory& memory, std::ifstream& ifs) {
-    GamePak gamepak;
-
-    // Get file size, might be helpful for later in the project
-    long sizeOfFile = ifs.tellg();
-    ifs.seekg( ifs.beg );
-    UNUSED(sizeOfFile);
-
-    // Read function to grab a single byte from the file
-    uint8_t byte;
-    auto read = [&ifs, &byte]() -> uint8_t {
-            ifs.read(reinterpret_cast<char*>(&byte), sizeof (uint8_t) );
-            return byte;
-    };
-    // Check if the iNES header contains the NES bytes to check if its a correct file
-    bool isNESFile = read() == 'N' && read() == 'E' && read() == 'S' && read() == 0x1A;
-    if (!isNESFile) {
-        std::cerr << "Given file is not an NES 2.0 file" << std::endl;
-        throw std::runtime_error("Unsupported file type");
-    }
-    // Get flags
-
-    gamepak.PRG_ROM_sz = read(); // in 16kb units
-    gamepak.CHR_ROM_sz = read(); // in 8 kb units
-    uint8_t flags6 = read();
-    uint8_t mapperNum = (flags6 & 0xF0) >> 4;
-    gamepak.mirror = static_cast<GamePak::MIRRORT>(flags6 & 1);
-
-    // these flags will be used later on with other mappers
-    gamepak.flags7 = read();
-    gamepak.flags8 = read();
-    gamepak.flags9 = read();
-    gamepak.flags10 = read();
-    // skip padding of header
-    for (short i = 0; i != 5; i++)
-        read();
-
-    // Only supporting NROM
-    if (mapperNum != 0) {
-        std::cerr << "Non NROM not supported" << std::endl;
-        throw std::runtime_error("Unsupported Mapper type (" + std::to_string(mapperNum) + ")");
-    }
-
-    long startOfPROM = ifs.tellg();
-
-    // Write PRG ROM @ 0x8000 in 16 kb units
-    for (uint16_t index = 0x8000, times = 0; times != gamepak.PRG_ROM_sz * memsize::KB16; times++, index++) {
-        memory[index] = read();
-    }
-    // In NROM 128, after 0xBFFF is just a mirror of the rom of 0x8000 - 0xBFFF
-    // For now most mirrors will actually write to memory
-    if (gamepak.PRG_ROM_sz == 1) {
-        ifs.seekg(startOfPROM);
-        for (uint16_t index = 0xC000, times = 0; times != gamepak.PRG_ROM_sz * memsize::KB16; times++, index++) {
-            memory[index] = read();
-        }
-    }
-    return gamepak;
+void GamePak::loadState(StateReader& state) {
+    mapper->loadState(state);
+    mapBanks();
 }
 
-
-
+void GamePak::mapBanks() {
+    mirror = mapper->mirror;
+    nes->ppu.setMirroring(mirror);
+    nes->cpu.memory.setMapper(mapper.get());
+    nes->ppu.setChrBanks(mapper->chrBanks, mapper->chrWriteBanks);
+    nes->ppu.updateScanlineIrq();
+}
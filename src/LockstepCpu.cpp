@@ -0,0 +1,760 @@
+#include "LockstepCpu.h"
+#include "Memory.h"
+#include "RomImage.h"
+#include "functions.hpp" // toHex()
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if !defined(__GNUC__)
+#error "LockstepCpu needs the vector extensions of gcc or clang"
+#endif
+
+// Every helper below is inlined into step(), which is built once for avx2 and once for the baseline,
+// so vectors passed between them never cross an abi boundary
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// Forces everything called inside a function to be inlined into it, see Cpu6502.cpp
+#define FLATTEN __attribute__((flatten))
+
+// The loader picks the avx2 build of a function on cpus that have it, through an ifunc
+#if defined(__x86_64__) && defined(__linux__)
+#define LOCKSTEP_AVX2
+#define AVX2_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define AVX2_CLONES
+#endif
+
+constexpr size_t LockstepCpu::BLOCK;
+constexpr int16_t LockstepCpu::MAX_BUDGET;
+
+enum LockstepCpu::Op : uint8_t {
+    ILLEGAL,
+    LDA, LDX, LDY, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA,
+    ADC, SBC, DEC, DEX, DEY, INC, INX, INY,
+    AND, ORA, EOR, BIT, ASL, LSR, ROL, ROR,
+    BMI, BPL, BCC, BCS, BEQ, BNE, BVS, BVC,
+    JMP, JSR, RTS, RTI,
+    SEC, CLC, SEI, CLI, SED, CLD, CLV, CMP, CPX, CPY,
+    PHA, PHP, PLA, PLP,
+    NOP, BRK
+};
+
+enum LockstepCpu::Mode : uint8_t {
+    IMPLICIT, ACCUM, IMMEDIATE, ZEROPAGE, ZEROPAGEX, ZEROPAGEY, RELATIVE,
+    ABS, ABSX, ABSY, INDIRECT, INDEXINDIRECT, INDRECTINDEX
+};
+
+namespace {
+    // A block of lanes, one element per lane. Nothing is wider than an avx2 register, gcc splits
+    // wider comparisons and conversions into single elements, so words are done half a block at a time
+    constexpr size_t HALF = LockstepCpu::BLOCK / 2;
+    typedef uint8_t Bytes __attribute__((vector_size(LockstepCpu::BLOCK)));
+    typedef int8_t Signed __attribute__((vector_size(LockstepCpu::BLOCK)));
+    typedef uint8_t HalfBytes __attribute__((vector_size(HALF)));
+    typedef int8_t SignedHalfBytes __attribute__((vector_size(HALF)));
+    typedef uint16_t Words __attribute__((vector_size(HALF * 2)));
+    typedef int16_t SignedWords __attribute__((vector_size(HALF * 2)));
+    typedef uint16_t HalfWords __attribute__((vector_size(HALF)));
+
+    template<typename V, typename T>
+    inline V load(const T* lanes) {
+        V vec;
+        std::memcpy(&vec, lanes, sizeof(vec));
+        return vec;
+    }
+
+    template<typename V, typename T>
+    inline void store(T* lanes, const V& vec) {
+        std::memcpy(lanes, &vec, sizeof(vec));
+    }
+
+    // Comparisons give 0xFF or 0 per lane, flags are 1 or 0
+    inline Bytes flag(const Signed& cmp) {
+        return reinterpret_cast<const Bytes&>(cmp) & 1;
+    }
+
+    inline Bytes mask(const Signed& cmp) {
+        return reinterpret_cast<const Bytes&>(cmp);
+    }
+
+    // The words of the lanes in one half of a block
+    inline Words widen(const Bytes& bytes, const size_t& half) {
+        return __builtin_convertvector(load<HalfBytes>(reinterpret_cast<const uint8_t*>(&bytes) + half * HALF), Words);
+    }
+
+    inline Words wordMask(const Bytes& mask, const size_t& half) {
+        const SignedWords words = __builtin_convertvector(load<SignedHalfBytes>(reinterpret_cast<const uint8_t*>(&mask) + half * HALF), SignedWords);
+        return reinterpret_cast<const Words&>(words);
+    }
+
+    inline Bytes narrowMask(const SignedWords& low, const SignedWords& high) {
+        const SignedHalfBytes halves[2] = {__builtin_convertvector(low, SignedHalfBytes), __builtin_convertvector(high, SignedHalfBytes)};
+        return load<Bytes>(halves);
+    }
+
+    // Only the lanes set in mask take val
+    inline void blend(uint8_t* lanes, const Bytes& val, const Bytes& mask) {
+        store(lanes, (val & mask) | (load<Bytes>(lanes) & ~mask));
+    }
+
+    inline void blend(uint16_t* lanes, const uint16_t& val, const Bytes& mask) {
+        for (size_t half = 0; half != 2; ++half) {
+            const Words words = wordMask(mask, half);
+            store(lanes + half * HALF, (val & words) | (load<Words>(lanes + half * HALF) & ~words));
+        }
+    }
+
+    inline bool any(const Bytes& mask) {
+        uint64_t parts[sizeof(mask) / sizeof(uint64_t)];
+        std::memcpy(parts, &mask, sizeof(mask));
+        uint64_t all = 0;
+        for (const uint64_t& part : parts)
+            all |= part;
+        return all != 0;
+    }
+
+    inline size_t firstSet(const Bytes& mask) {
+        uint64_t parts[sizeof(mask) / sizeof(uint64_t)];
+        std::memcpy(parts, &mask, sizeof(mask));
+        size_t lane = 0;
+        for (const uint64_t& part : parts) {
+            if (part)
+                return lane + static_cast<size_t>(__builtin_ctzll(part)) / 8;
+            lane += sizeof(part);
+        }
+        return lane;
+    }
+
+    inline size_t countSet(const Bytes& mask) {
+        uint64_t parts[sizeof(mask) / sizeof(uint64_t)];
+        std::memcpy(parts, &mask, sizeof(mask));
+        size_t bits = 0;
+        for (const uint64_t& part : parts)
+            bits += static_cast<size_t>(__builtin_popcountll(part));
+        return bits / 8;
+    }
+
+    template<typename V>
+    inline V lower(const V& lhs, const V& rhs) {
+        const auto less = lhs < rhs;
+        const V lanes = reinterpret_cast<const V&>(less);
+        return (lhs & lanes) | (rhs & ~lanes);
+    }
+
+    // Folds the words in halves before looking at single ones
+    inline uint16_t lowest(const Words& words) {
+        HalfWords halves[2];
+        std::memcpy(halves, &words, sizeof(words));
+        const HalfWords half = lower(halves[0], halves[1]);
+        uint16_t low = half[0];
+        for (size_t lane = 1; lane != sizeof(half) / sizeof(uint16_t); ++lane)
+            low = std::min<uint16_t>(low, half[lane]);
+        return low;
+    }
+}
+
+const std::array<LockstepCpu::Decoded, 0x100> LockstepCpu::decodeTable = LockstepCpu::createDecodeTable();
+
+// Cpu6502's table is constant initialized, so it's there before this static is
+std::array<LockstepCpu::Decoded, 0x100> LockstepCpu::createDecodeTable() {
+    const std::pair<Cpu6502::InstrFuncPtr, Op> ops[] = {
+        {&Cpu6502::OP_LDA, LDA}, {&Cpu6502::OP_LDX, LDX}, {&Cpu6502::OP_LDY, LDY},
+        {&Cpu6502::OP_STA, STA}, {&Cpu6502::OP_STX, STX}, {&Cpu6502::OP_STY, STY},
+        {&Cpu6502::OP_TAX, TAX}, {&Cpu6502::OP_TAY, TAY}, {&Cpu6502::OP_TSX, TSX},
+        {&Cpu6502::OP_TXA, TXA}, {&Cpu6502::OP_TXS, TXS}, {&Cpu6502::OP_TYA, TYA},
+        {&Cpu6502::OP_ADC, ADC}, {&Cpu6502::OP_SBC, SBC},
+        {&Cpu6502::OP_DEC, DEC}, {&Cpu6502::OP_DEX, DEX}, {&Cpu6502::OP_DEY, DEY},
+        {&Cpu6502::OP_INC, INC}, {&Cpu6502::OP_INX, INX}, {&Cpu6502::OP_INY, INY},
+        {&Cpu6502::OP_AND, AND}, {&Cpu6502::OP_ORA, ORA}, {&Cpu6502::OP_EOR, EOR}, {&Cpu6502::OP_BIT, BIT},
+        {&Cpu6502::OP_ASL, ASL}, {&Cpu6502::OP_LSR, LSR}, {&Cpu6502::OP_ROL, ROL}, {&Cpu6502::OP_ROR, ROR},
+        {&Cpu6502::OP_BMI, BMI}, {&Cpu6502::OP_BPL, BPL}, {&Cpu6502::OP_BCC, BCC}, {&Cpu6502::OP_BCS, BCS},
+        {&Cpu6502::OP_BEQ, BEQ}, {&Cpu6502::OP_BNE, BNE}, {&Cpu6502::OP_BVS, BVS}, {&Cpu6502::OP_BVC, BVC},
+        {&Cpu6502::OP_JMP, JMP}, {&Cpu6502::OP_JSR, JSR}, {&Cpu6502::OP_RTS, RTS}, {&Cpu6502::OP_RTI, RTI},
+        {&Cpu6502::OP_SEC, SEC}, {&Cpu6502::OP_CLC, CLC}, {&Cpu6502::OP_SEI, SEI}, {&Cpu6502::OP_CLI, CLI},
+        {&Cpu6502::OP_SED, SED}, {&Cpu6502::OP_CLD, CLD}, {&Cpu6502::OP_CLV, CLV},
+        {&Cpu6502::OP_CMP, CMP}, {&Cpu6502::OP_CPX, CPX}, {&Cpu6502::OP_CPY, CPY},
+        {&Cpu6502::OP_PHA, PHA}, {&Cpu6502::OP_PHP, PHP}, {&Cpu6502::OP_PLA, PLA}, {&Cpu6502::OP_PLP, PLP},
+        {&Cpu6502::OP_NOP, NOP}, {&Cpu6502::OP_BRK, BRK}
+    };
+    const std::pair<Cpu6502::AddressingPtr, Mode> modes[] = {
+        {&Cpu6502::ADR_IMPLICIT, IMPLICIT}, {&Cpu6502::ADR_ACCUM, ACCUM}, {&Cpu6502::ADR_IMMEDIATE, IMMEDIATE},
+        {&Cpu6502::ADR_ZEROPAGE, ZEROPAGE}, {&Cpu6502::ADR_ZEROPAGEX, ZEROPAGEX}, {&Cpu6502::ADR_ZEROPAGEY, ZEROPAGEY},
+        {&Cpu6502::ADR_RELATIVE, RELATIVE}, {&Cpu6502::ADR_ABS, ABS}, {&Cpu6502::ADR_ABSX, ABSX},
+        {&Cpu6502::ADR_ABSY, ABSY}, {&Cpu6502::ADR_INDIRECT, INDIRECT},
+        {&Cpu6502::ADR_INDEXINDIRECT, INDEXINDIRECT}, {&Cpu6502::ADR_INDRECTINDEX, INDRECTINDEX}
+    };
+    const Cpu6502::OpTable& opcodeTable = Cpu6502::opcodeTable;
+    std::array<Decoded, 0x100> table;
+    for (size_t opcode = 0; opcode != table.size(); ++opcode) {
+        table[opcode] = {ILLEGAL, IMPLICIT};
+        for (const auto& op : ops) {
+            if (opcodeTable[opcode].instr == op.first)
+                table[opcode].op = op.second;
+        }
+        for (const auto& mode : modes) {
+            if (opcodeTable[opcode].addr == mode.first)
+                table[opcode].mode = mode.second;
+        }
+    }
+    return table;
+}
+
+LockstepCpu::LockstepCpu(const uint8_t* prg, const size_t& prgSize, const size_t& lanes)
+    : count(lanes), width((lanes + BLOCK - 1) / BLOCK * BLOCK) {
+    if (lanes == 0)
+        throw std::invalid_argument("LockstepCpu needs atleast one lane");
+    if (prgSize != memsize::KB16 && prgSize != memsize::KB32)
+        throw std::invalid_argument("LockstepCpu only runs 16kb or 32kb of prg rom, got " + std::to_string(prgSize) + " bytes");
+    this->prg.resize(memsize::KB32);
+    for (size_t offset = 0; offset != this->prg.size(); offset += prgSize)
+        std::copy(prg, prg + prgSize, this->prg.begin() + static_cast<std::ptrdiff_t>(offset));
+
+    for (std::vector<uint8_t>* bytes : {&a, &x, &y, &sp, &c, &z, &i, &d, &b, &v, &n, &active, &group, &operand, &result, &delta})
+        bytes->resize(width);
+    pc.resize(width);
+    address.resize(width);
+    cycleCount.resize(width);
+    target.resize(width);
+    budget.resize(width);
+    roundBudget.resize(width);
+    ram.resize(Memory::RAM_SIZE * width);
+    groupBlocks.reserve(width / BLOCK);
+}
+
+LockstepCpu::LockstepCpu(const RomImage& rom, const size_t& lanes)
+    : LockstepCpu(rom.header.mapper == 0 ? rom.prg() : throw std::invalid_argument("LockstepCpu only runs nrom (mapper 0) cartridges, got mapper " + std::to_string(rom.header.mapper)),
+                  rom.prgSize, lanes) {
+}
+
+size_t LockstepCpu::lanes() const noexcept {
+    return count;
+}
+
+LockstepCpu::Registers LockstepCpu::registers(const size_t& lane) const {
+    Registers regs;
+    regs.a = a.at(lane);
+    regs.x = x[lane];
+    regs.y = y[lane];
+    regs.sp = sp[lane];
+    regs.pc = pc[lane];
+    regs.status = statusByte(lane);
+    regs.cycles = cycleCount[lane];
+    return regs;
+}
+
+void LockstepCpu::setRegisters(const size_t& lane, const Registers& regs) {
+    a.at(lane) = regs.a;
+    x[lane] = regs.x;
+    y[lane] = regs.y;
+    sp[lane] = regs.sp;
+    pc[lane] = regs.pc;
+    setStatus(lane, regs.status);
+    b[lane] = (regs.status >> 4) & 1;
+    cycleCount[lane] = regs.cycles;
+}
+
+uint8_t LockstepCpu::read(const size_t& lane, const uint16_t& adr) const {
+    if (lane >= count)
+        throw std::out_of_range("No lane " + std::to_string(lane));
+    return readLane(lane, adr);
+}
+
+void LockstepCpu::write(const size_t& lane, const uint16_t& adr, const uint8_t& val) {
+    if (lane >= count)
+        throw std::out_of_range("No lane " + std::to_string(lane));
+    writeLane(lane, adr, val);
+}
+
+void LockstepCpu::reset() {
+    const uint16_t start = static_cast<uint16_t>((readLane(0, 0xFFFD) << 8) | readLane(0, 0xFFFC));
+    for (size_t lane = 0; lane != count; ++lane) {
+        pc[lane] = start;
+        setStatus(lane, Inner::Status());
+        b[lane] = 0;
+        sp[lane] = 0xFD;
+        a[lane] = x[lane] = y[lane] = 0;
+        cycleCount[lane] += 7;
+    }
+}
+
+// Cycles are counted down from a 16 bit budget by the simd code, a long run is split into several budgets
+// A lane runs on until it reaches its target, so it stops at the same instruction whatever the split was
+void LockstepCpu::runCycles(const uint64_t& num) {
+    for (size_t lane = 0; lane != count; ++lane)
+        target[lane] = cycleCount[lane] + num;
+    bool running = true;
+    while (running) {
+        running = false;
+        for (size_t lane = 0; lane != count; ++lane) {
+            const uint64_t left = cycleCount[lane] < target[lane] ? target[lane] - cycleCount[lane] : 0;
+            budget[lane] = roundBudget[lane] = static_cast<int16_t>(std::min<uint64_t>(left, MAX_BUDGET));
+            active[lane] = left ? 0xFF : 0;
+            running |= left != 0;
+        }
+        while (step());
+        for (size_t lane = 0; lane != count; ++lane)
+            cycleCount[lane] += static_cast<uint64_t>(roundBudget[lane] - budget[lane]);
+    }
+}
+
+uint64_t LockstepCpu::instructions() const noexcept {
+    return instrCount;
+}
+
+uint64_t LockstepCpu::groups() const noexcept {
+    return groupCount;
+}
+
+bool LockstepCpu::avx2() {
+#if defined(LOCKSTEP_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+uint8_t LockstepCpu::readLane(const size_t& lane, const uint16_t& adr) const {
+    if (adr < 0x2000)
+        return ram[(adr & (Memory::RAM_SIZE - 1)) * width + lane];
+    if (adr >= 0x8000)
+        return prg[adr & 0x7FFF];
+    return 0;
+}
+
+void LockstepCpu::writeLane(const size_t& lane, const uint16_t& adr, const uint8_t& val) {
+    if (adr < 0x2000)
+        ram[(adr & (Memory::RAM_SIZE - 1)) * width + lane] = val;
+}
+
+void LockstepCpu::push(const size_t& lane, const uint8_t& val) {
+    ram[(0x100 + sp[lane]) * width + lane] = val;
+    --sp[lane];
+}
+
+uint8_t LockstepCpu::pop(const size_t& lane) {
+    ++sp[lane];
+    return ram[(0x100 + sp[lane]) * width + lane];
+}
+
+uint8_t LockstepCpu::statusByte(const size_t& lane) const {
+    Inner::Status status;
+    status.c = c[lane];
+    status.z = z[lane];
+    status.i = i[lane];
+    status.d = d[lane];
+    status.b = b[lane];
+    status.o = v[lane];
+    status.n = n[lane];
+    return status;
+}
+
+// Like Inner::Status::fromByte the b flag is left alone
+void LockstepCpu::setStatus(const size_t& lane, const uint8_t& byte) {
+    const Inner::Status status(byte);
+    c[lane] = status.c;
+    z[lane] = status.z;
+    i[lane] = status.i;
+    d[lane] = status.d;
+    v[lane] = status.o;
+    n[lane] = status.n;
+}
+
+FLATTEN AVX2_CLONES
+bool LockstepCpu::step() {
+    // The group is every active lane at the lowest pc, the pc of inactive lanes is read as 0xFFFF
+    Words lowestPcs = ~Words{};
+    for (size_t block = 0; block != width; block += BLOCK) {
+        const Bytes lanes = load<Bytes>(&active[block]);
+        for (size_t half = 0; half != 2; ++half)
+            lowestPcs = lower(lowestPcs, load<Words>(&pc[block + half * HALF]) | ~wordMask(lanes, half));
+    }
+    const uint16_t at = lowest(lowestPcs);
+    groupBlocks.clear();
+    for (size_t block = 0; block != width; block += BLOCK) {
+        const SignedWords low = load<Words>(&pc[block]) == at, high = load<Words>(&pc[block + HALF]) == at;
+        const Bytes lanes = load<Bytes>(&active[block]) & narrowMask(low, high);
+        store(&group[block], lanes);
+        if (any(lanes))
+            groupBlocks.push_back(block);
+    }
+    if (groupBlocks.empty())
+        return false;
+
+    auto eachBlock = [this](auto kernel) {
+        for (const size_t& block : groupBlocks)
+            kernel(block, load<Bytes>(&group[block]));
+    };
+    auto eachLane = [this](auto kernel) {
+        for (const size_t& block : groupBlocks) {
+            for (size_t lane = block; lane != block + BLOCK; ++lane) {
+                if (group[lane])
+                    kernel(lane);
+            }
+        }
+    };
+
+    // The rom is the same for every lane, but code in ram can differ, those lanes wait for another group
+    const size_t first = groupBlocks.front() + firstSet(load<Bytes>(&group[groupBlocks.front()]));
+    const uint8_t opcode = readLane(first, at);
+    const uint8_t lo = readLane(first, static_cast<uint16_t>(at + 1));
+    const uint8_t hi = readLane(first, static_cast<uint16_t>(at + 2));
+    if (at < 0x8000) {
+        eachLane([&](const size_t& lane) {
+            if (readLane(lane, at) != opcode || readLane(lane, static_cast<uint16_t>(at + 1)) != lo || readLane(lane, static_cast<uint16_t>(at + 2)) != hi)
+                group[lane] = 0;
+        });
+    }
+
+    const Decoded decoded = decodeTable[opcode];
+    if (decoded.op == ILLEGAL)
+        throw std::runtime_error("Cpu illegal opcode failure, opcode : " + toHex(opcode) + ", pc : " + toHex(at) + ", lane : " + std::to_string(first));
+
+    /// -- Addressing, either one address for the whole group or one per lane in address --
+    static constexpr uint8_t sizes[] = {1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2};
+    const uint16_t next = static_cast<uint16_t>(at + sizes[decoded.mode]);
+    const uint16_t absolute = static_cast<uint16_t>((hi << 8) | lo);
+    const uint8_t pageCross = Cpu6502::pageCrossTable[opcode];
+    bool uniform = true;
+    uint16_t uniformAdr = decoded.mode == ZEROPAGE ? lo : absolute;
+
+    eachBlock([&](const size_t& block, const Bytes& lanes) {
+        blend(&pc[block], next, lanes);
+        store(&delta[block], Bytes{} + Cpu6502::cycleTable[opcode]);
+    });
+    auto indexed = [&](const uint8_t* index, const uint16_t& base, const bool& zeroPage) {
+        uniform = false;
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes offset = load<Bytes>(index + block);
+            if (zeroPage) {
+                const Bytes wrapped = offset + static_cast<uint8_t>(base);
+                for (size_t half = 0; half != 2; ++half)
+                    store(&address[block + half * HALF], widen(wrapped, half));
+            }
+            else {
+                for (size_t half = 0; half != 2; ++half)
+                    store(&address[block + half * HALF], widen(offset, half) + base);
+                const Bytes crossed = mask(offset + static_cast<uint8_t>(base) < offset);
+                store(&delta[block], load<Bytes>(&delta[block]) + (crossed & lanes & pageCross));
+            }
+        });
+    };
+    switch (decoded.mode) {
+    case ZEROPAGEX: indexed(x.data(), lo, true); break;
+    case ZEROPAGEY: indexed(y.data(), lo, true); break;
+    case ABSX: indexed(x.data(), absolute, false); break;
+    case ABSY: indexed(y.data(), absolute, false); break;
+    case INDRECTINDEX: {
+        // Both bytes of the pointer are in the zero page, rows for every lane
+        uniform = false;
+        const uint8_t* lows = &ram[lo * width];
+        const uint8_t* highs = &ram[static_cast<uint8_t>(lo + 1) * width];
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes low = load<Bytes>(lows + block), high = load<Bytes>(highs + block), offset = load<Bytes>(&y[block]);
+            for (size_t half = 0; half != 2; ++half)
+                store(&address[block + half * HALF], ((widen(high, half) << 8) | widen(low, half)) + widen(offset, half));
+            const Bytes crossed = mask(static_cast<Bytes>(low + offset) < low);
+            store(&delta[block], load<Bytes>(&delta[block]) + (crossed & lanes & pageCross));
+        });
+        break;
+    }
+    case INDEXINDIRECT:
+        uniform = false;
+        eachLane([&](const size_t& lane) {
+            const uint8_t pointer = static_cast<uint8_t>(lo + x[lane]);
+            address[lane] = static_cast<uint16_t>((readLane(lane, static_cast<uint8_t>(pointer + 1)) << 8) | readLane(lane, pointer));
+        });
+        break;
+    case INDIRECT: {
+        // The pointer wraps within its page
+        uniform = false;
+        const uint16_t highAdr = static_cast<uint16_t>((absolute & 0xFF00) | static_cast<uint8_t>(lo + 1));
+        eachLane([&](const size_t& lane) {
+            address[lane] = static_cast<uint16_t>((readLane(lane, highAdr) << 8) | readLane(lane, absolute));
+        });
+        break;
+    }
+    default:
+        break;
+    }
+
+    // The operand of every lane, indexed by lane
+    auto readOperand = [&]() -> const uint8_t* {
+        if (decoded.mode == IMMEDIATE || (uniform && uniformAdr >= 0x2000)) {
+            const uint8_t val = decoded.mode == IMMEDIATE ? lo : readLane(0, uniformAdr);
+            eachBlock([&](const size_t& block, const Bytes&) {
+                store(&operand[block], Bytes{} + val);
+            });
+        }
+        else if (uniform) {
+            return &ram[(uniformAdr & (Memory::RAM_SIZE - 1)) * width];
+        }
+        else {
+            eachLane([&](const size_t& lane) {
+                operand[lane] = readLane(lane, address[lane]);
+            });
+        }
+        return operand.data();
+    };
+    auto writeOperand = [&](const uint8_t* vals) {
+        if (uniform && uniformAdr < 0x2000) {
+            uint8_t* row = &ram[(uniformAdr & (Memory::RAM_SIZE - 1)) * width];
+            eachBlock([&](const size_t& block, const Bytes& lanes) {
+                blend(row + block, load<Bytes>(vals + block), lanes);
+            });
+        }
+        else if (!uniform) {
+            eachLane([&](const size_t& lane) {
+                writeLane(lane, address[lane], vals[lane]);
+            });
+        }
+    };
+
+    /// -- Operations --
+    auto setZN = [&](const size_t& block, const Bytes& lanes, const Bytes& val) {
+        blend(&z[block], flag(val == 0), lanes);
+        blend(&n[block], val >> 7, lanes);
+    };
+    auto setFlag = [&](std::vector<uint8_t>& flags, const uint8_t& val) {
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            blend(&flags[block], Bytes{} + val, lanes);
+        });
+    };
+    auto transfer = [&](const std::vector<uint8_t>& src, std::vector<uint8_t>& dst, const bool& flags) {
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes val = load<Bytes>(&src[block]);
+            blend(&dst[block], val, lanes);
+            if (flags)
+                setZN(block, lanes, val);
+        });
+    };
+    // Loads, logic and compares, the result goes to reg unless it's a compare
+    auto readOp = [&](std::vector<uint8_t>& reg, auto op, const bool& compare) {
+        const uint8_t* src = readOperand();
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes lhs = load<Bytes>(&reg[block]), rhs = load<Bytes>(src + block);
+            const Bytes val = op(lhs, rhs);
+            setZN(block, lanes, val);
+            if (compare)
+                blend(&c[block], flag(rhs <= lhs), lanes);
+            else
+                blend(&reg[block], val, lanes);
+        });
+    };
+    // Carry out of lhs + rhs + carry is a wrapped sum below lhs, or equal to it with a carry in
+    auto add = [&](const bool& subtract) {
+        const uint8_t* src = readOperand();
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes lhs = load<Bytes>(&a[block]), byte = load<Bytes>(src + block), carry = load<Bytes>(&c[block]);
+            const Bytes rhs = subtract ? ~byte : byte;
+            const Bytes sum = lhs + rhs + carry;
+            const Bytes carryOut = flag((sum < lhs) | ((sum == lhs) & (carry != 0)));
+            if (subtract) {
+                // Cpu6502 sets zero from the 16 bit difference, which is never 0 when it borrowed
+                blend(&z[block], flag(sum == 0) & carryOut, lanes);
+                blend(&v[block], ((lhs ^ sum) & (lhs ^ byte)) >> 7, lanes);
+            }
+            else {
+                blend(&z[block], flag(sum == 0), lanes);
+                blend(&v[block], ((lhs ^ sum) & (byte ^ sum)) >> 7, lanes);
+            }
+            blend(&n[block], sum >> 7, lanes);
+            blend(&c[block], carryOut, lanes);
+            blend(&a[block], sum, lanes);
+        });
+    };
+    // Increments, decrements and shifts of a register or of memory
+    auto modify = [&](std::vector<uint8_t>* reg, auto op, const bool& setsCarry) {
+        const uint8_t* src = reg ? reg->data() : readOperand();
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes carry = load<Bytes>(&c[block]);
+            Bytes carryOut = carry;
+            const Bytes val = op(load<Bytes>(src + block), carry, carryOut);
+            setZN(block, lanes, val);
+            if (setsCarry)
+                blend(&c[block], carryOut, lanes);
+            store(&result[block], val);
+            if (reg)
+                blend(&(*reg)[block], val, lanes);
+        });
+        if (!reg)
+            writeOperand(result.data());
+    };
+    auto branch = [&](const std::vector<uint8_t>& flags, const uint8_t& taken) {
+        // A taken branch is one cycle longer, and another if it lands on a different page
+        const uint16_t dest = static_cast<uint16_t>(next + static_cast<int8_t>(lo));
+        const uint8_t extra = 1 + ((next & 0xFF00) != (dest & 0xFF00));
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes takes = lanes & mask(load<Bytes>(&flags[block]) == taken);
+            blend(&pc[block], dest, takes);
+            store(&delta[block], load<Bytes>(&delta[block]) + (takes & extra));
+        });
+    };
+    auto jump = [&]() {
+        if (uniform) {
+            eachBlock([&](const size_t& block, const Bytes& lanes) {
+                blend(&pc[block], uniformAdr, lanes);
+            });
+        }
+        else {
+            eachLane([&](const size_t& lane) {
+                pc[lane] = address[lane];
+            });
+        }
+    };
+
+    switch (decoded.op) {
+    case LDA: readOp(a, [](const Bytes&, const Bytes& rhs) { return rhs; }, false); break;
+    case LDX: readOp(x, [](const Bytes&, const Bytes& rhs) { return rhs; }, false); break;
+    case LDY: readOp(y, [](const Bytes&, const Bytes& rhs) { return rhs; }, false); break;
+    case STA: writeOperand(a.data()); break;
+    case STX: writeOperand(x.data()); break;
+    case STY: writeOperand(y.data()); break;
+    case TAX: transfer(a, x, true); break;
+    case TAY: transfer(a, y, true); break;
+    case TSX: transfer(sp, x, true); break;
+    case TXA: transfer(x, a, true); break;
+    case TXS: transfer(x, sp, false); break;
+    case TYA: transfer(y, a, true); break;
+
+    case ADC: add(false); break;
+    case SBC: add(true); break;
+    case INC: modify(nullptr, [](const Bytes& val, const Bytes&, Bytes&) { return val + 1; }, false); break;
+    case INX: modify(&x, [](const Bytes& val, const Bytes&, Bytes&) { return val + 1; }, false); break;
+    case INY: modify(&y, [](const Bytes& val, const Bytes&, Bytes&) { return val + 1; }, false); break;
+    case DEC: modify(nullptr, [](const Bytes& val, const Bytes&, Bytes&) { return val - 1; }, false); break;
+    case DEX: modify(&x, [](const Bytes& val, const Bytes&, Bytes&) { return val - 1; }, false); break;
+    case DEY: modify(&y, [](const Bytes& val, const Bytes&, Bytes&) { return val - 1; }, false); break;
+
+    case AND: readOp(a, [](const Bytes& lhs, const Bytes& rhs) { return lhs & rhs; }, false); break;
+    case ORA: readOp(a, [](const Bytes& lhs, const Bytes& rhs) { return lhs | rhs; }, false); break;
+    case EOR: readOp(a, [](const Bytes& lhs, const Bytes& rhs) { return lhs ^ rhs; }, false); break;
+    case BIT: {
+        const uint8_t* src = readOperand();
+        eachBlock([&](const size_t& block, const Bytes& lanes) {
+            const Bytes byte = load<Bytes>(src + block);
+            blend(&z[block], flag((load<Bytes>(&a[block]) & byte) == 0), lanes);
+            blend(&n[block], byte >> 7, lanes);
+            blend(&v[block], (byte >> 6) & 1, lanes);
+        });
+        break;
+    }
+    case ASL: modify(decoded.mode == ACCUM ? &a : nullptr, [](const Bytes& val, const Bytes&, Bytes& carry) {
+            carry = val >> 7;
+            return static_cast<Bytes>(val << 1);
+        }, true); break;
+    case LSR: modify(decoded.mode == ACCUM ? &a : nullptr, [](const Bytes& val, const Bytes&, Bytes& carry) {
+            carry = val & 1;
+            return static_cast<Bytes>(val >> 1);
+        }, true); break;
+    case ROL: modify(decoded.mode == ACCUM ? &a : nullptr, [](const Bytes& val, const Bytes& carryIn, Bytes& carry) {
+            carry = val >> 7;
+            return static_cast<Bytes>((val << 1) | carryIn);
+        }, true); break;
+    case ROR: modify(decoded.mode == ACCUM ? &a : nullptr, [](const Bytes& val, const Bytes& carryIn, Bytes& carry) {
+            carry = val & 1;
+            return static_cast<Bytes>((val >> 1) | (carryIn << 7));
+        }, true); break;
+
+    case BMI: branch(n, 1); break;
+    case BPL: branch(n, 0); break;
+    case BCC: branch(c, 0); break;
+    case BCS: branch(c, 1); break;
+    case BEQ: branch(z, 1); break;
+    case BNE: branch(z, 0); break;
+    case BVS: branch(v, 1); break;
+    case BVC: branch(v, 0); break;
+
+    case JMP: jump(); break;
+    case JSR:
+        // Pushes the address of the last byte of the jsr
+        eachLane([&](const size_t& lane) {
+            push(lane, static_cast<uint8_t>((next - 1) >> 8));
+            push(lane, static_cast<uint8_t>(next - 1));
+        });
+        jump();
+        break;
+    case RTS:
+        eachLane([&](const size_t& lane) {
+            const uint8_t low = pop(lane), high = pop(lane);
+            pc[lane] = static_cast<uint16_t>(((high << 8) | low) + 1);
+        });
+        break;
+    case RTI:
+        eachLane([&](const size_t& lane) {
+            setStatus(lane, pop(lane));
+            const uint8_t low = pop(lane), high = pop(lane);
+            pc[lane] = static_cast<uint16_t>((high << 8) | low);
+        });
+        break;
+
+    case SEC: setFlag(c, 1); break;
+    case CLC: setFlag(c, 0); break;
+    case SEI: setFlag(i, 1); break;
+    case CLI: setFlag(i, 0); break;
+    case SED: setFlag(d, 1); break;
+    case CLD: setFlag(d, 0); break;
+    case CLV: setFlag(v, 0); break;
+    case CMP: readOp(a, [](const Bytes& lhs, const Bytes& rhs) { return static_cast<Bytes>(lhs - rhs); }, true); break;
+    case CPX: readOp(x, [](const Bytes& lhs, const Bytes& rhs) { return static_cast<Bytes>(lhs - rhs); }, true); break;
+    case CPY: readOp(y, [](const Bytes& lhs, const Bytes& rhs) { return static_cast<Bytes>(lhs - rhs); }, true); break;
+
+    case PHA:
+        eachLane([&](const size_t& lane) { push(lane, a[lane]); });
+        break;
+    case PHP:
+        eachLane([&](const size_t& lane) {
+            b[lane] = 1;
+            push(lane, statusByte(lane));
+            b[lane] = 0;
+        });
+        break;
+    case PLA:
+        eachLane([&](const size_t& lane) {
+            a[lane] = pop(lane);
+            z[lane] = a[lane] == 0;
+            n[lane] = a[lane] >> 7;
+        });
+        break;
+    case PLP:
+        eachLane([&](const size_t& lane) { setStatus(lane, pop(lane)); });
+        break;
+
+    case BRK: {
+        // Same as an irq, see Cpu6502::generateInterrupt
+        const uint16_t vector = static_cast<uint16_t>((readLane(0, 0xFFFF) << 8) | readLane(0, 0xFFFE));
+        eachLane([&](const size_t& lane) {
+            b[lane] = 1;
+            push(lane, static_cast<uint8_t>(next >> 8));
+            push(lane, static_cast<uint8_t>(next));
+            push(lane, statusByte(lane));
+            i[lane] = 1;
+            pc[lane] = vector;
+        });
+        break;
+    }
+    case NOP:
+    case ILLEGAL:
+        break;
+    }
+
+    // Lanes stay active until they used up their budget
+    eachBlock([&](const size_t& block, const Bytes& lanes) {
+        const Bytes cycles = load<Bytes>(&delta[block]) & lanes;
+        SignedWords left[2];
+        for (size_t half = 0; half != 2; ++half) {
+            const SignedWords budgets = load<SignedWords>(&budget[block + half * HALF]) - reinterpret_cast<const SignedWords&>(static_cast<const Words&>(widen(cycles, half)));
+            store(&budget[block + half * HALF], budgets);
+            left[half] = budgets > 0;
+        }
+        store(&active[block], narrowMask(left[0], left[1]));
+        instrCount += countSet(lanes);
+    });
+    ++groupCount;
+    return true;
+}
@@ -0,0 +1,377 @@
+#include "Mapper.h"
+#include "SaveState.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+Mapper::Mapper(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : mirror(mirror), rom(std::move(rom)) {
+    if (this->rom->chrSize == 0)
+        chrRam.resize(memsize::KB8);
+    setPrg32k(0);
+    setChr8k(0);
+}
+
+Mapper::Mapper(const Mapper& other) : irq(other.irq), prgBanks(other.prgBanks), chrBanks(other.chrBanks), chrWriteBanks(other.chrWriteBanks),
+    mirror(other.mirror), rom(other.rom), chrRam(other.chrRam) {
+    for (uint8_t i = 0; i != 8; ++i) {
+        if (chrWriteBanks[i]) {
+            chrWriteBanks[i] = chrRam.data() + (other.chrWriteBanks[i] - other.chrRam.data());
+            chrBanks[i] = chrWriteBanks[i];
+        }
+    }
+}
+
+std::unique_ptr<Mapper> Mapper::create(const uint8_t& number, std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) {
+    if (!rom || rom->prgSize == 0)
+        throw std::runtime_error("Rom has no PRG ROM");
+    switch (number) {
+        case 0: return std::make_unique<NROM>(std::move(rom), mirror);
+        case 1: return std::make_unique<MMC1>(std::move(rom), mirror);
+        case 2: return std::make_unique<UxROM>(std::move(rom), mirror);
+        case 3: return std::make_unique<CNROM>(std::move(rom), mirror);
+        case 4: return std::make_unique<MMC3>(std::move(rom), mirror);
+        case 7: return std::make_unique<AxROM>(std::move(rom), mirror);
+        default:
+            throw std::runtime_error("Unsupported Mapper type (" + std::to_string(number) + ")");
+    }
+}
+
+bool Mapper::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    UNUSED(adr);
+    UNUSED(val);
+    return false;
+}
+
+size_t Mapper::ownedBytes() const noexcept {
+    return sizeof(Mapper) + chrRam.capacity();
+}
+
+void Mapper::setPrg8k(const uint8_t& window, const unsigned& bank) noexcept {
+    const size_t banks = std::max<size_t>(rom->prgSize / memsize::KB8, 1);
+    prgBanks[window] = rom->prg() + (bank % banks) * memsize::KB8;
+}
+
+void Mapper::setPrg16k(const uint8_t& window, const unsigned& bank) noexcept {
+    const size_t banks = std::max<size_t>(rom->prgSize / memsize::KB16, 1);
+    const uint8_t* start = rom->prg() + (bank % banks) * memsize::KB16;
+    prgBanks[window * 2] = start;
+    prgBanks[window * 2 + 1] = start + memsize::KB8;
+}
+
+void Mapper::setPrg32k(const unsigned& bank) noexcept {
+    // A 16KB rom is seen twice
+    if (rom->prgSize < memsize::KB32) {
+        setPrg16k(0, 0);
+        setPrg16k(1, 0);
+        return;
+    }
+    setPrg16k(0, bank * 2);
+    setPrg16k(1, bank * 2 + 1);
+}
+
+void Mapper::setChr1k(const uint8_t& window, const unsigned& bank) noexcept {
+    static constexpr size_t size = 0x400;
+    if (rom->chrSize == 0) {
+        chrWriteBanks[window] = &chrRam[(bank % (chrRam.size() / size)) * size];
+        chrBanks[window] = chrWriteBanks[window];
+    }
+    else {
+        chrBanks[window] = rom->chr() + (bank % (rom->chrSize / size)) * size;
+        chrWriteBanks[window] = nullptr;
+    }
+}
+
+void Mapper::setChr4k(const uint8_t& window, const unsigned& bank) noexcept {
+    for (uint8_t i = 0; i != 4; ++i)
+        setChr1k(window * 4 + i, bank * 4 + i);
+}
+
+void Mapper::setChr8k(const unsigned& bank) noexcept {
+    for (uint8_t i = 0; i != 8; ++i)
+        setChr1k(i, bank * 8 + i);
+}
+
+// Chr windows into chr ram have this bit set in their saved offset
+static constexpr uint32_t CHR_RAM_OFFSET = 0x80000000u;
+
+void Mapper::saveState(StateWriter& state) const {
+    for (const uint8_t* bank : prgBanks)
+        state.write(static_cast<uint32_t>(bank - rom->prg()));
+    for (uint8_t i = 0; i != 8; ++i) {
+        if (chrWriteBanks[i])
+            state.write(static_cast<uint32_t>(chrWriteBanks[i] - chrRam.data()) | CHR_RAM_OFFSET);
+        else
+            state.write(static_cast<uint32_t>(chrBanks[i] - rom->chr()));
+    }
+    state.write(static_cast<uint8_t>(mirror));
+    state.write(irq);
+    if (rom->chrSize == 0)
+        state.write(chrRam.data(), chrRam.size());
+}
+
+// Offsets are checked so a damaged state throws instead of pointing a window outside the rom
+void Mapper::loadState(StateReader& state) {
+    auto checked = [](const uint32_t& offset, const size_t& window, const size_t& size) {
+        if (offset + window > size)
+            throw std::runtime_error("Save state has a bank outside of the rom");
+        return offset;
+    };
+    for (const uint8_t*& bank : prgBanks)
+        bank = rom->prg() + checked(state.read<uint32_t>(), memsize::KB8, rom->prgSize);
+    for (uint8_t i = 0; i != 8; ++i) {
+        const uint32_t offset = state.read<uint32_t>();
+        if (offset & CHR_RAM_OFFSET) {
+            chrWriteBanks[i] = &chrRam[checked(offset & ~CHR_RAM_OFFSET, 0x400, chrRam.size())];
+            chrBanks[i] = chrWriteBanks[i];
+        }
+        else {
+            chrBanks[i] = rom->chr() + checked(offset, 0x400, rom->chrSize);
+            chrWriteBanks[i] = nullptr;
+        }
+    }
+    const uint8_t savedMirror = state.read<uint8_t>();
+    if (savedMirror > GamePak::FOUR_SCREEN)
+        throw std::runtime_error("Save state has an invalid mirroring");
+    mirror = static_cast<GamePak::MIRRORT>(savedMirror);
+    state.read(irq);
+    if (rom->chrSize == 0)
+        state.read(chrRam.data(), chrRam.size());
+}
+
+// ----------- NROM -----------
+
+NROM::NROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {}
+
+std::unique_ptr<Mapper> NROM::clone() const {
+    return std::unique_ptr<Mapper>(new NROM(*this));
+}
+
+// ----------- MMC1 -----------
+
+MMC1::MMC1(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {
+    updateBanks();
+}
+
+std::unique_ptr<Mapper> MMC1::clone() const {
+    return std::unique_ptr<Mapper>(new MMC1(*this));
+}
+
+bool MMC1::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    // Bit 7 resets the shift register and sets the prg mode to fixing the last bank
+    if (val & 0x80) {
+        shift = 0x10;
+        control |= 0x0C;
+        updateBanks();
+        return true;
+    }
+    // The shift register is full when the starting bit has been shifted out
+    const bool full = shift & 1;
+    shift = static_cast<uint8_t>((shift >> 1) | ((val & 1) << 4));
+    if (!full)
+        return false;
+    switch ((adr >> 13) & 3) { // which register is based on bits 13, 14 of the address
+        case 0: control = shift; break;
+        case 1: chrBank0 = shift; break;
+        case 2: chrBank1 = shift; break;
+        case 3: prgBank = shift & 0x0F; break;
+    }
+    shift = 0x10;
+    updateBanks();
+    return true;
+}
+
+void MMC1::updateBanks() noexcept {
+    static constexpr GamePak::MIRRORT mirrors[] = {GamePak::SINGLE_LOWER, GamePak::SINGLE_UPPER,
+                                                   GamePak::VERTICAL, GamePak::HORIZONTAL};
+    mirror = mirrors[control & 3];
+    switch ((control >> 2) & 3) {
+        case 0: case 1: // 32KB, low bit ignored
+            setPrg32k(prgBank >> 1);
+            break;
+        case 2: // first bank fixed at 0x8000
+            setPrg16k(0, 0);
+            setPrg16k(1, prgBank);
+            break;
+        case 3: // last bank fixed at 0xC000
+            setPrg16k(0, prgBank);
+            setPrg16k(1, static_cast<unsigned>(rom->prgSize / memsize::KB16) - 1);
+            break;
+    }
+    if (control & 0x10) { // two separate 4KB banks
+        setChr4k(0, chrBank0);
+        setChr4k(1, chrBank1);
+    }
+    else {
+        setChr8k(chrBank0 >> 1);
+    }
+}
+
+void MMC1::saveState(StateWriter& state) const {
+    Mapper::saveState(state);
+    state.write(shift);
+    state.write(control);
+    state.write(chrBank0);
+    state.write(chrBank1);
+    state.write(prgBank);
+}
+
+void MMC1::loadState(StateReader& state) {
+    Mapper::loadState(state);
+    state.read(shift);
+    state.read(control);
+    state.read(chrBank0);
+    state.read(chrBank1);
+    state.read(prgBank);
+}
+
+// ----------- UxROM -----------
+
+UxROM::UxROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {
+    setPrg16k(0, 0);
+    setPrg16k(1, static_cast<unsigned>(this->rom->prgSize / memsize::KB16) - 1);
+}
+
+std::unique_ptr<Mapper> UxROM::clone() const {
+    return std::unique_ptr<Mapper>(new UxROM(*this));
+}
+
+bool UxROM::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    UNUSED(adr);
+    setPrg16k(0, val & 0x0F);
+    return true;
+}
+
+// ----------- CNROM -----------
+
+CNROM::CNROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {}
+
+bool CNROM::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    UNUSED(adr);
+    setChr8k(val & 0x03);
+    return true;
+}
+
+std::unique_ptr<Mapper> CNROM::clone() const {
+    return std::unique_ptr<Mapper>(new CNROM(*this));
+}
+
+// ----------- AxROM -----------
+
+AxROM::AxROM(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {
+    this->mirror = GamePak::SINGLE_LOWER;
+}
+
+std::unique_ptr<Mapper> AxROM::clone() const {
+    return std::unique_ptr<Mapper>(new AxROM(*this));
+}
+
+bool AxROM::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    UNUSED(adr);
+    setPrg32k(val & 0x07);
+    mirror = (val & 0x10) ? GamePak::SINGLE_UPPER : GamePak::SINGLE_LOWER;
+    return true;
+}
+
+// ----------- MMC3 -----------
+
+MMC3::MMC3(std::shared_ptr<const RomImage> rom, const GamePak::MIRRORT& mirror) : Mapper(std::move(rom), mirror) {
+    updateBanks();
+}
+
+std::unique_ptr<Mapper> MMC3::clone() const {
+    return std::unique_ptr<Mapper>(new MMC3(*this));
+}
+
+bool MMC3::writeRegister(const uint16_t& adr, const uint8_t& val) {
+    // Registers are selected by the range and if the address is even or odd
+    const bool odd = adr & 1;
+    switch (adr & 0xE000) {
+        case 0x8000:
+            if (odd)
+                registers[bankSelect & 7] = val;
+            else
+                bankSelect = val;
+            updateBanks();
+            return true;
+        case 0xA000:
+            if (odd || mirror == GamePak::FOUR_SCREEN) // prg ram protect, prg ram is always plain memory here
+                return false;
+            mirror = (val & 1) ? GamePak::HORIZONTAL : GamePak::VERTICAL;
+            return true;
+        case 0xC000:
+            if (odd) {
+                irqCounter = 0;
+                irqReload = true;
+            }
+            else
+                irqLatch = val;
+            return false;
+        default: // 0xE000
+            irqEnable = odd;
+            if (!odd) // disabling also acknowledges a pending irq
+                irq = false;
+            return false;
+    }
+}
+
+void MMC3::updateBanks() noexcept {
+    const unsigned lastBank = static_cast<unsigned>(rom->prgSize / memsize::KB8) - 1;
+    // Prg mode swaps which of 0x8000 and 0xC000 is fixed to the second last bank
+    const uint8_t swapWindow = (bankSelect & 0x40) ? 2 : 0;
+    setPrg8k(swapWindow, registers[6]);
+    setPrg8k(1, registers[7]);
+    setPrg8k(2 - swapWindow, lastBank - 1);
+    setPrg8k(3, lastBank);
+    // Chr inversion swaps the 2KB and 1KB halves of the pattern tables
+    const uint8_t inversion = (bankSelect & 0x80) ? 4 : 0;
+    setChr1k(inversion + 0, registers[0] & 0xFE);
+    setChr1k(inversion + 1, registers[0] | 1);
+    setChr1k(inversion + 2, registers[1] & 0xFE);
+    setChr1k(inversion + 3, registers[1] | 1);
+    for (uint8_t i = 0; i != 4; ++i)
+        setChr1k((4 - inversion) + i, registers[2 + i]);
+}
+
+// The counter is reloaded when it's zero or a reload was requested, otherwise it counts down
+bool MMC3::clockScanline() noexcept {
+    if (irqCounter == 0 || irqReload) {
+        irqCounter = irqLatch;
+        irqReload = false;
+    }
+    else
+        --irqCounter;
+    if (irqCounter == 0 && irqEnable) {
+        irq = true;
+        return true;
+    }
+    return false;
+}
+
+uint32_t MMC3::clocksUntilIrq() const noexcept {
+    if (!irqEnable)
+        return 0;
+    if (irqCounter == 0 || irqReload) // reloads first, a latch of 0 raises it on every clock
+        return irqLatch == 0 ? 1u : irqLatch + 1u;
+    return irqCounter;
+}
+
+void MMC3::saveState(StateWriter& state) const {
+    Mapper::saveState(state);
+    state.write(bankSelect);
+    state.write(registers);
+    state.write(irqLatch);
+    state.write(irqCounter);
+    state.write(irqReload);
+    state.write(irqEnable);
+}
+
+void MMC3::loadState(StateReader& state) {
+    Mapper::loadState(state);
+    state.read(bankSelect);
+    state.read(registers);
+    state.read(irqLatch);
+    state.read(irqCounter);
+    state.read(irqReload);
+    state.read(irqEnable);
+}
@@ -1,72 +1,166 @@
 #include "Memory.h"
 #include "NES.h"
+#include "Mapper.h"
 #include "functions.hpp"
+#include "SaveState.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 
+constexpr uint16_t Memory::RAM_SIZE;
+
 Memory::Memory() {
     static constexpr bool warn = false;
     if (warn)
         std::cerr << "Warning, Memory class does not have a NES handle\n";
+    mapPages();
 }
 
 Memory::Memory(std::shared_ptr<NES> nes) {
     setNESHandle(nes);
+    mapPages();
+}
+
+// Both sides write to their own copy of a page from now on
+Memory::Memory(const Memory& other) : memory(other.memory), nes(other.nes), mapper(other.mapper) {
+    other.writePages.fill(nullptr);
+    mapPages();
+}
+
+Memory& Memory::operator=(const Memory& other) {
+    memory = other.memory;
+    nes = other.nes;
+    mapper = other.mapper;
+    other.writePages.fill(nullptr);
+    mapPages();
+    return *this;
 }
 
 void Memory::setNESHandle(std::shared_ptr<NES> nes) {
-    this->nes = nes;
+    this->nes = nes.get();
+}
+
+// See https://wiki.nesdev.com/w/index.php/CPU_memory_map
+void Memory::mapPages() {
+    for (uint16_t page = 0; page != PAGES; ++page)
+        mapPage(page);
+    mapPrgPages();
+}
+
+void Memory::mapPage(const uint16_t& page) {
+    if (page >= 0x20 && page <= 0x40) { // nes ppu register mirrors, dma and controller registers
+        readPages[page] = nullptr;
+        writePages[page] = nullptr;
+        return;
+    }
+    if (page >= 0x80 && mapper) // prg windows, see mapPrgPages
+        return;
+    const uint16_t backing = page < 0x20 ? page % 0x08 : page; // ram mirror, repeats every 0x0800
+    readPages[page] = memory.read(backing);
+    writePages[page] = memory.writable(backing);
+}
+
+uint8_t* Memory::ownPage(const uint16_t& page) {
+    uint8_t* data = memory.write(page);
+    if (readPages[page] == data && writePages[page] == data) // already mapped
+        return data;
+    if (page < 0x08) {
+        for (uint16_t mirror = page; mirror < 0x20; mirror += 0x08)
+            mapPage(mirror);
+    }
+    else {
+        mapPage(page);
+    }
+    return data;
 }
 
-uint8_t Memory::read(const uint16_t& adr) const {
-    if (inRange(0x0000, 0x1FFF, adr)) // ram mirror, repeats every 0x0800
-        return memory[adr % 0x0800];
-    else if (inRange(0x2000, 0x3FFF, adr)) // nes ppu register mirrors, repeats every 0x8
+// Bank switching only swaps pointers, nothing is copied
+void Memory::mapPrgPages() {
+    if (!mapper)
+        return;
+    for (uint16_t page = 0x80; page != PAGES; ++page) {
+        readPages[page] = mapper->prgBanks[(page - 0x80) >> 5] + ((page & 0x1F) << 8);
+        writePages[page] = nullptr; // mapper registers
+    }
+}
+
+void Memory::setMapper(const Mapper* mapper) {
+    this->mapper = mapper;
+    mapPages();
+}
+
+uint8_t Memory::readIO(const uint16_t& adr) const {
+    if (inRange(0x2000, 0x3FFF, adr)) { // nes ppu register mirrors, repeats every 0x8
+        nes->catchUpPpu();
         return nes->ppu.readRegister(0x2000 + adr % 8);
-    else if (adr == 0x4014)
+    }
+    else if (adr == 0x4014) {
+        nes->catchUpPpu();
         return nes->ppu.readRegister(adr);
-    else if (inRange(0x8000, 0xFFFF, adr)) {
-        // NROM differs in if its a NROM-128 or NROM-256
-        // if NROM-128 its a mirror of 0x8000-0xBFFF
-        if (nes->gamepak.PRG_ROM_sz == 1){ // NROM-128
-            return memory[0x8000 + adr % 0x4000];
-        }
-        else
-            return memory[adr];
     }
+    else if (adr == 0x4016 || adr == 0x4017) // controllers, the upper bits are open bus which is 0x40 from the address
+        return 0x40 | nes->controllers[adr & 0x1].read();
     else
-        return memory[adr];
+        return memory.read(adr >> 8)[adr & 0xFF];
 }
 
-void Memory::write(const uint16_t& adr, const uint8_t& val) {
-    if (inRange(0x0000, 0x1FFF, adr)) // ram mirror, repeats every 0x0800
-        memory[adr % 0x0800] = val;
-    else if (inRange(0x2000, 0x3FFF, adr)) // nes ppu register mirrors, repeats every 0x8
+void Memory::writeIO(const uint16_t& adr, const uint8_t& val) {
+    if (inRange(0x2000, 0x3FFF, adr)) { // nes ppu register mirrors, repeats every 0x8
+        nes->catchUpPpu();
         nes->ppu.writeRegister(0x2000 + adr % 8, val);
-    else if (adr == 0x4014)
-        return nes->ppu.writeRegister(adr, val);
-    else if (inRange(0x8000, 0xFFFF, adr)) {
-        if (nes->gamepak.PRG_ROM_sz == 1){ // NROM-128
-            memory[0x8000 + adr % 0x4000] = val;
-        }
-        else
-            memory[adr] = val;
+        nes->updatePpuDeadline();
     }
-    else
-        memory[adr] = val;
+    else if (adr == 0x4014) {
+        nes->catchUpPpu();
+        nes->ppu.writeRegister(adr, val);
+    }
+    else if (adr == 0x4016) { // strobes both controllers
+        nes->controllers[0].write(val);
+        nes->controllers[1].write(val);
+    }
+    else if (adr >= 0x8000 && mapper)
+        nes->gamepak.writeRegister(adr, val);
+    else // io registers without side effects, or a page shared with a copy
+        ownPage(adr < 0x2000 ? (adr >> 8) % 0x08 : adr >> 8)[adr & 0xFF] = val;
+}
+
+void Memory::saveState(StateWriter& state) const {
+    for (uint16_t page = 0x00; page != 0x08; ++page)
+        state.write(memory.read(page), 0x100);
+    state.write(memory.read(0x40), 0x0020);
+    for (uint16_t page = 0x60; page != 0x80; ++page)
+        state.write(memory.read(page), 0x100);
+}
+
+void Memory::loadState(StateReader& state) {
+    for (uint16_t page = 0x00; page != 0x08; ++page)
+        state.read(ownPage(page), 0x100);
+    state.read(ownPage(0x40), 0x0020);
+    for (uint16_t page = 0x60; page != 0x80; ++page)
+        state.read(ownPage(page), 0x100);
 }
 
 void Memory::clear() {
-    memory.fill(0);
+    memory.clear();
+    mapPages();
 }
 
 
+void Memory::copyRam(uint8_t* out) const {
+    for (uint16_t page = 0; page != RAM_SIZE >> 8; ++page)
+        std::copy_n(memory.read(page), 0x100, out + (page << 8));
+}
+
+size_t Memory::ownedBytes() const noexcept {
+    return memory.ownedBytes();
+}
+
 uint8_t& Memory::operator[](const size_t& index) {
-    return memory[index];
+    return ownPage(static_cast<uint16_t>(index >> 8))[index & 0xFF];
 }
 
 const uint8_t& Memory::operator[](const size_t& index) const {
-    return memory[index];
+    return memory.read(index >> 8)[index & 0xFF];
 }
@@ -0,0 +1,153 @@
+#include "Movie.h"
+#include "NES.h"
+#include "SaveState.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+constexpr uint32_t Movie::VERSION;
+static constexpr uint32_t MOVIE_MAGIC = 0x564D4E59; // "YNMV"
+
+Movie::Movie(const unsigned& keyframeInterval) : keyframeInterval(keyframeInterval ? keyframeInterval : 1) {}
+
+void Movie::startRecording(const NES& nes) {
+    input.clear();
+    keyframeList.clear();
+    keyframeList.push_back(Keyframe{0, nes.saveState()});
+    pos = 0;
+}
+
+void Movie::recordFrame(NES& nes, const uint8_t& player1, const uint8_t& player2) {
+    if (keyframeList.empty())
+        throw std::runtime_error("Movie recording was not started");
+    // Branching off an earlier frame, the old future is gone
+    if (pos != frames()) {
+        input.resize(pos * 2);
+        keyframeList.erase(std::upper_bound(keyframeList.begin(), keyframeList.end(), pos,
+                                            [](const uint64_t& frame, const Keyframe& keyframe) { return frame < keyframe.frame; }),
+                           keyframeList.end());
+    }
+    if (pos % keyframeInterval == 0 && keyframeList.back().frame != pos)
+        keyframeList.push_back(Keyframe{pos, nes.saveState()});
+    input.push_back(player1);
+    input.push_back(player2);
+    nes.controllers[0].setButtons(player1);
+    nes.controllers[1].setButtons(player2);
+    nes.runFrame();
+    ++pos;
+}
+
+bool Movie::playFrame(NES& nes) {
+    if (pos >= frames())
+        return false;
+    nes.controllers[0].setButtons(input[pos * 2]);
+    nes.controllers[1].setButtons(input[pos * 2 + 1]);
+    nes.runFrame();
+    ++pos;
+    return true;
+}
+
+void Movie::seek(NES& nes, const uint64_t& frame) {
+    if (keyframeList.empty())
+        throw std::runtime_error("Movie is empty");
+    if (frame > frames())
+        throw std::out_of_range("Movie has " + std::to_string(frames()) + " frames, cannot seek to " + std::to_string(frame));
+    // The last keyframe at or before the frame, the first one is at 0 so there's always one
+    auto keyframe = std::upper_bound(keyframeList.begin(), keyframeList.end(), frame,
+                                     [](const uint64_t& frame, const Keyframe& keyframe) { return frame < keyframe.frame; });
+    --keyframe;
+    nes.loadState(keyframe->state);
+    pos = keyframe->frame;
+    while (pos != frame)
+        playFrame(nes);
+}
+
+uint64_t Movie::frames() const {
+    return input.size() / 2;
+}
+
+uint64_t Movie::position() const {
+    return pos;
+}
+
+bool Movie::empty() const {
+    return keyframeList.empty();
+}
+
+size_t Movie::keyframes() const {
+    return keyframeList.size();
+}
+
+void Movie::save(std::vector<uint8_t>& data) const {
+    if (keyframeList.empty())
+        throw std::runtime_error("Cannot save an empty movie");
+    data.clear();
+    StateWriter writer(data);
+    writer.write(MOVIE_MAGIC);
+    writer.write(VERSION);
+    writer.write(static_cast<uint32_t>(keyframeInterval));
+    writer.write(frames());
+    writer.write(input.data(), input.size());
+    writer.write(static_cast<uint64_t>(keyframeList.size()));
+    for (const Keyframe& keyframe : keyframeList) {
+        writer.write(keyframe.frame);
+        writer.write(static_cast<uint64_t>(keyframe.state.size()));
+        writer.write(keyframe.state.data(), keyframe.state.size());
+    }
+}
+
+void Movie::save(const std::string& fname) const {
+    std::vector<uint8_t> data;
+    save(data);
+    std::ofstream ofs(fname, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    ofs.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!ofs)
+        throw std::runtime_error("Could not write movie file: " + fname);
+}
+
+// Sizes come from the file, they are checked against what's left before allocating anything
+void Movie::load(const uint8_t* data, const size_t& size) {
+    StateReader reader(data, size);
+    if (size < sizeof(MOVIE_MAGIC) || reader.read<uint32_t>() != MOVIE_MAGIC)
+        throw std::runtime_error("Not a movie");
+    const uint32_t version = reader.read<uint32_t>();
+    if (version != VERSION)
+        throw std::runtime_error("Movie is version " + std::to_string(version) + ", expected " + std::to_string(VERSION));
+    const uint32_t interval = reader.read<uint32_t>();
+    const uint64_t frameCount = reader.read<uint64_t>();
+    if (interval == 0 || frameCount > size / 2)
+        throw std::runtime_error("Movie header is damaged");
+    std::vector<uint8_t> newInput(frameCount * 2);
+    reader.read(newInput.data(), newInput.size());
+
+    const uint64_t keyframeCount = reader.read<uint64_t>();
+    if (keyframeCount == 0 || keyframeCount > size)
+        throw std::runtime_error("Movie has no keyframes");
+    std::vector<Keyframe> newKeyframes;
+    for (uint64_t i = 0; i != keyframeCount; ++i) {
+        const uint64_t frame = reader.read<uint64_t>(), stateSize = reader.read<uint64_t>();
+        // Keyframes must start at power on and go forward without passing the end
+        if ((i == 0 && frame != 0) || (i != 0 && frame <= newKeyframes.back().frame) || frame > frameCount || stateSize > size)
+            throw std::runtime_error("Movie keyframes are damaged");
+        std::vector<uint8_t> state(stateSize);
+        reader.read(state.data(), state.size());
+        newKeyframes.push_back(Keyframe{frame, std::move(state)});
+    }
+    if (!reader.atEnd())
+        throw std::runtime_error("Movie has trailing data");
+
+    keyframeInterval = interval;
+    input.swap(newInput);
+    keyframeList.swap(newKeyframes);
+    pos = 0;
+}
+
+void Movie::load(const std::string& fname) {
+    std::ifstream ifs(fname, std::ios_base::binary | std::ios_base::in);
+    if (!ifs)
+        throw std::runtime_error("Movie file not found, given path:" + fname);
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    load(data.data(), data.size());
+}
@@ -1,8 +1,14 @@
 #include <iostream>
 #include <tuple>
 #include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
 #include "NES.h"
 #include "functions.hpp" // toHex()
+#include "SaveState.hpp"
+#include "RomImage.h"
+#include "Mapper.h"
 
 // Must be called right after the constructor, cannot be in the constructor
 // because at that point this is not a shared pointer and will throw
@@ -34,6 +40,25 @@ void NES::load(const std::string& fname) {
 void NES::clear() {
     ppu.clear();
     cpu.clear();
+    for (Controller& controller : controllers)
+        controller.clear();
+    ppuCycleCount = ppuDeadline = 0;
+}
+
+NES::NES(const NES& other) : std::enable_shared_from_this<NES>(), cpu(other.cpu), ppu(other.ppu), gamepak(other.gamepak),
+    controllers(other.controllers), lazyPpu(other.lazyPpu), scanlineRenderer(other.scanlineRenderer),
+    videoOutput(other.videoOutput), profilePpu(other.profilePpu), screen(other.screen),
+    baseName(other.baseName), ppuCycleCount(other.ppuCycleCount), ppuDeadline(other.ppuDeadline) {}
+
+size_t NES::footprint() const {
+    return sizeof(NES) + cpu.memory.ownedBytes() + ppu.ownedBytes() + (gamepak.mapper ? gamepak.mapper->ownedBytes() : 0);
+}
+
+std::shared_ptr<NES> NES::clone() const {
+    std::shared_ptr<NES> copy(new NES(*this));
+    // Rebinds the handles, which also maps the copy's mapper into its cpu and ppu
+    copy->init();
+    return copy;
 }
 
 std::string NES::getBaseName() const {
@@ -42,16 +67,128 @@ std::string NES::getBaseName() const {
 
 void NES::step() {
     cpu.runCycle();
-    // Ppu runs 3x as fast as cpu
-    for (int var = 0; var < 3; ++var) {
-        ppu.runCycle();
+    catchUpPpu();
+}
+
+void NES::runCycles(const uint64_t& cycles) {
+    const uint64_t end = cpu.cycleCount + cycles;
+    while (cpu.cycleCount < end) {
+        if (lazyPpu)
+            runCpuUntil(end);
+        else
+            step();
+    }
+}
+
+void NES::runFrame() {
+    const uint64_t frame = ppu.frameCount;
+    while (ppu.frameCount == frame) {
+        if (lazyPpu)
+            runCpuUntil(std::numeric_limits<uint64_t>::max());
+        else
+            step();
+    }
+}
+
+// Ppu runs 3x as fast as cpu, run it for every cpu cycle it is behind
+// This includes cycles of interrupts and DMAs that happened while the ppu was running
+void NES::catchUpPpu() {
+    if (profilePpu) {
+        const auto start = std::chrono::steady_clock::now();
+        runPpuUntil(cpu.cycleCount * 3);
+        ppuNanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                    std::chrono::steady_clock::now() - start).count());
+    }
+    else {
+        runPpuUntil(cpu.cycleCount * 3);
+    }
+    updatePpuDeadline();
+}
+
+void NES::runPpuUntil(const uint64_t& target) {
+    while (ppuCycleCount < target) {
+        if (scanlineRenderer && target - ppuCycleCount >= Ppu::SCANLINE_CYCLES && ppu.atScanlineStart()) {
+            ppuCycleCount += ppu.runScanline();
+        }
+        else {
+            ppu.runCycle();
+            ++ppuCycleCount;
+        }
+    }
+}
+
+void NES::updatePpuDeadline() {
+    ppuDeadline = ppuCycleCount + ppu.cyclesUntilEvent();
+}
+
+// The cpu only sees the ppu through its registers, which catch it up on their own, and through events
+// like the vblank NMI. The cpu can therefore run until an event is due without running the ppu,
+// every instruction ending before the deadline would have seen nothing happen if the ppu was interleaved.
+void NES::runCpuUntil(const uint64_t& cycle) {
+    while (cpu.cycleCount < cycle && cpu.cycleCount * 3 <= ppuDeadline) {
+        cpu.runCycle();
     }
+    catchUpPpu();
 }
 
 void NES::powerUp() {
     cpu.signalRESET();
 }
 
-void NES::addVideoData(const uint8_t& x, const uint8_t& y, const uint8_t& chroma) {
-    screen[y][x] = chroma;
+constexpr uint32_t NES::STATE_VERSION;
+static constexpr uint32_t STATE_MAGIC = 0x53454E59; // "YNES"
+
+void NES::saveState(std::vector<uint8_t>& state) const {
+    if (!gamepak.mapper)
+        throw std::runtime_error("Cannot save a state without a cartridge loaded");
+    state.clear();
+    StateWriter writer(state);
+    writer.write(STATE_MAGIC);
+    writer.write(STATE_VERSION);
+    writer.write(gamepak.rom->hash);
+    cpu.saveState(writer);
+    ppu.saveState(writer);
+    gamepak.saveState(writer);
+    for (const Controller& controller : controllers)
+        controller.saveState(writer);
+    writer.write(ppuCycleCount);
+}
+
+std::vector<uint8_t> NES::saveState() const {
+    std::vector<uint8_t> state;
+    saveState(state);
+    return state;
+}
+
+void NES::loadState(const uint8_t* state, const size_t& size) {
+    if (!gamepak.mapper)
+        throw std::runtime_error("Cannot load a state without a cartridge loaded");
+    StateReader reader(state, size);
+    if (reader.read<uint32_t>() != STATE_MAGIC)
+        throw std::runtime_error("Not a save state");
+    const uint32_t version = reader.read<uint32_t>();
+    if (version != STATE_VERSION)
+        throw std::runtime_error("Save state is version " + std::to_string(version) + ", expected " + std::to_string(STATE_VERSION));
+    if (reader.read<uint64_t>() != gamepak.rom->hash)
+        throw std::runtime_error("Save state is of a different rom");
+    cpu.loadState(reader);
+    ppu.loadState(reader);
+    gamepak.loadState(reader);
+    for (Controller& controller : controllers)
+        controller.loadState(reader);
+    reader.read(ppuCycleCount);
+    if (!reader.atEnd())
+        throw std::runtime_error("Save state has trailing data");
+    updatePpuDeadline();
+}
+
+void NES::loadState(const std::vector<uint8_t>& state) {
+    loadState(state.data(), state.size());
+}
+
+void NES::setFrameBuffer(uint32_t* buffer, const size_t& pitch) {
+    if (buffer && (pitch % sizeof(uint32_t) != 0 || pitch < 256 * sizeof(uint32_t)))
+        throw std::invalid_argument("Frame buffer pitch must be a multiple of 4 of atleast 1024 bytes, given " + std::to_string(pitch));
+    frameBuffer = buffer;
+    frameBufferPitch = pitch / sizeof(uint32_t);
 }
@@ -1,9 +1,11 @@
 ﻿#include "Ppu.h"
 #include "NES.h"
+#include "Mapper.h"
+#include "SaveState.hpp"
 #include <bitset>
 #include <iostream>
 #include <memory>
-#include <cmath>
+#include <algorithm>
 #include "functions.hpp" // apply_from_tuple inRange
 
 #define mT(...) std::make_tuple<uint8_t, uint8_t, uint8_t>(__VA_ARGS__) // Quick make tuple without the large syntax of uint8_t's...
@@ -27,17 +29,63 @@ const std::array<const Ppu::PaletteT, 0x40 > Ppu::RGBPaletteTable = {
 
 #undef mT
 
+static std::array<uint32_t, 0x40> createARGBPalette() {
+    std::array<uint32_t, 0x40> table{};
+    for (uint8_t i = 0; i != 0x40; ++i) {
+        uint8_t r, g, b;
+        std::tie(r, g, b) = Ppu::getRGBPalette(i);
+        table[i] = 0xFF000000u | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+    }
+    return table;
+}
+
+// Built from RGBPaletteTable, which is defined above it so it's initialized first
+const std::array<uint32_t, 0x40> Ppu::ARGBPaletteTable = createARGBPalette();
+
 Ppu::Ppu() {
+    mapChrToMemory();
+    setMirroring(GamePak::HORIZONTAL);
     clear();
 }
 
 Ppu::Ppu(std::shared_ptr<NES> nes) {
     setNESHandle(nes);
+    mapChrToMemory();
+    setMirroring(GamePak::HORIZONTAL);
     clear();
 }
 
+// Without a cartridge the pattern tables are the ppu's own memory
+void Ppu::mapChrToMemory() noexcept {
+    chrInMemory = true;
+    mapMemory();
+    invalidateTiles(0, TILES);
+}
+
+void Ppu::mapMemory() noexcept {
+    if (chrInMemory) {
+        for (uint8_t i = 0; i != 8; ++i) {
+            chrPages[i] = memory.read(i);
+            chrWritePages[i] = nullptr; // written through writableMemory
+        }
+    }
+    for (uint8_t i = 0; i != 4; ++i)
+        nameTables[i] = memory.read(nameTablePages[i]);
+    palette = memory.read(0xF) + 0x300;
+}
+
+// The page only moves when it was shared, the bytes stay the same so no tile needs decoding again
+uint8_t* Ppu::writableMemory(const uint8_t& page) {
+    uint8_t* data = memory.writable(page);
+    if (!data) {
+        data = memory.write(page);
+        mapMemory();
+    }
+    return data;
+}
+
 void Ppu::setNESHandle(std::shared_ptr<NES> nes) & {
-    this->nes = nes;
+    this->nes = nes.get();
 }
 
 
@@ -49,10 +97,9 @@ void Ppu::setNESHandle(std::shared_ptr<NES> nes) & {
 uint16_t Ppu::createLine(const uint8_t &left, const uint8_t &right) {
     uint16_t line = 0;
     for (short bitPos = 0, topBitLoc = 0; bitPos != 8; bitPos++, topBitLoc+=2) {
-        const uint16_t pow2 = static_cast<uint16_t>(std::pow(2, bitPos)); // select which bit to choose
         // Take the bit and move to 1's position, then move it to the line's bits bottom down
-        line |= ( (static_cast<uint16_t>(right) & pow2) >> bitPos) << (15 - topBitLoc);
-        line |= ( (static_cast<uint16_t>(left) & pow2) >> bitPos) << (15 - topBitLoc - 1);
+        line |= ((right >> bitPos) & 1) << (15 - topBitLoc);
+        line |= ((left >> bitPos) & 1) << (15 - topBitLoc - 1);
     }
     return line;
 }
@@ -61,15 +108,42 @@ uint16_t Ppu::createLine(const uint8_t &left, const uint8_t &right) {
 // This structure is traversable via example of stdDrawPatternTile
 Ppu::PatternTableT Ppu::getPatternTile(const uint16_t& tileAddress) const {
     if (tileAddress >= 0x2000 - 0xF) throw std::runtime_error("Given tile address it not a pattern table address");
+    // Tiles in the cache start at multiples of 16, others are rarely used
+    if ((tileAddress & 0xF) == 0)
+        return getCachedTile(tileAddress >> 4);
 
+    return readPatternTile([this](const uint16_t& adr) { return vRamRead(adr); }, tileAddress);
+}
+
+template<typename Read>
+Ppu::PatternTableT Ppu::readPatternTile(const Read& read, const uint16_t& tileAddress) {
+    if (tileAddress >= 0x2000 - 0xF) throw std::runtime_error("Given tile address it not a pattern table address");
     PatternTableT tile{};
     // each bit plane is +8 bytes from the first left bitplane
     for (unsigned i = 0; i != 8; i++) {
-        tile[i % 8] = createLine(nes->ppu.memory[tileAddress + i], nes->ppu.memory[tileAddress + i + 8]);
+        tile[i % 8] = createLine(read(static_cast<uint16_t>(tileAddress + i)), read(static_cast<uint16_t>(tileAddress + i + 8)));
     }
     return tile;
 }
 
+constexpr uint16_t Ppu::TILES;
+
+const Ppu::PatternTableT& Ppu::getCachedTile(const uint16_t& tile) const {
+    if (tileDirty[tile]) {
+        const uint16_t tileAddress = static_cast<uint16_t>(tile << 4);
+        // Both bit planes of a tile are within the same 1KB chr page
+        const uint8_t* bytes = chrPages[tileAddress >> 10] + (tileAddress & 0x3FF);
+        for (unsigned i = 0; i != 8; i++)
+            tileCache[tile][i] = createLine(bytes[i], bytes[i + 8]);
+        tileDirty[tile] = false;
+    }
+    return tileCache[tile];
+}
+
+void Ppu::invalidateTiles(const uint16_t& first, const uint16_t& count) noexcept {
+    std::fill(tileDirty.begin() + first, tileDirty.begin() + first + count, true);
+}
+
 Ppu::PatternTableT Ppu::getPatternTile(const uint8_t& tileID, bool isLeft) const {
     // move to the address of the pattern tile
     if (isLeft)
@@ -106,7 +180,7 @@ Ppu::PaletteT Ppu::getRGBPalette(const uint8_t &paletteNum) {
 // Ex if nametable Address = 0x2005, then relative address is 0x5, Similarly 0x3325 -> 0x125
 // atrTableStart must be the origin location attribute table to the particular nametable
 // Ex if nameTable Adr = 0x2000, then atrTableStart = 0x23C0
-uint16_t Ppu::getAtrAddress(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const {
+uint16_t Ppu::getAtrAddress(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) {
     // TODO : Make it such that relative addresses and the attribute table starts are unneeded for the function
     // Do when donkey kong works
     uint8_t hTableLevel = static_cast<uint8_t>( (nameTableRelativeAdr % 32) / 4); // Get horizontal table location, there is 32 bytes in a partial vertical line, and 4 numbers routes to one (0,1,2,3->0)
@@ -116,7 +190,7 @@ uint16_t Ppu::getAtrAddress(const uint16_t& nameTableRelativeAdr, const uint16_t
 }
 
 // Function gets the shift from a attribute table needed for the correct palette selection
-uint8_t Ppu::getShift(const uint16_t& nameTableRelativeAdr) const {
+uint8_t Ppu::getShift(const uint16_t& nameTableRelativeAdr) {
     // Compress all vertical tiles into one vertical tile (%64), if the address is divisable by 32 then it's in the upper half of tile, otherwise in lower half
     if (static_cast<int>( (nameTableRelativeAdr % 64) / 32) == 0) {
         switch(nameTableRelativeAdr % 4){ // Top Half
@@ -141,7 +215,12 @@ uint8_t Ppu::getShift(const uint16_t& nameTableRelativeAdr) const {
 // https://wiki.nesdev.com/w/index.php/PPU_attribute_tables
 // Gets Palette selection from a nametable address
 uint8_t Ppu::getPaletteFromNameTable(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const {
-    uint8_t byte = vRamRead( getAtrAddress(nameTableRelativeAdr, atrTableStart) );
+    return readPaletteFromNameTable([this](const uint16_t& adr) { return vRamRead(adr); }, nameTableRelativeAdr, atrTableStart);
+}
+
+template<typename Read>
+uint8_t Ppu::readPaletteFromNameTable(const Read& read, const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) {
+    uint8_t byte = read( getAtrAddress(nameTableRelativeAdr, atrTableStart) );
 
     switch(getShift(nameTableRelativeAdr)) {
         case 0:
@@ -159,107 +238,138 @@ uint8_t Ppu::getPaletteFromNameTable(const uint16_t& nameTableRelativeAdr, const
 
 
 Ppu::ColorSetT Ppu::getColorSetFromAdr(const uint16_t& paletteAdr) const {
+    return readColorSet([this](const uint16_t& adr) { return vRamRead(adr); }, paletteAdr);
+}
+
+template<typename Read>
+Ppu::ColorSetT Ppu::readColorSet(const Read& read, const uint16_t& paletteAdr) {
     // Assuming always background palette for now
     if (!inRange(0x3F00, 0x3F1F, paletteAdr)) {
         std::cerr << "Palette Address is not a background or sprite palette address\n";
         throw std::runtime_error("Palette Address is invalid");
     }
     else if (paletteAdr == 0x3F00) { // universal only
-        //return std::make_tuple(vRamRead(0x3F00), vRamRead(0x3F01), vRamRead(0x3F02), vRamRead(0x3F03));
+        //return std::make_tuple(read(0x3F00), read(0x3F01), read(0x3F02), read(0x3F03));
 
-        uint8_t u = vRamRead(0x3F00);
+        uint8_t u = read(0x3F00);
         return std::make_tuple(u, u, u, u);
 
     }
 
     ColorSetT set;
-    std::get<0>(set) = vRamRead(0x3F00); // Universal
+    std::get<0>(set) = read(0x3F00); // Universal
     // Next three palette colours
-    std::get<1>(set) = vRamRead(paletteAdr);
-    std::get<2>(set) = vRamRead(paletteAdr + 1);
-    std::get<3>(set) = vRamRead(paletteAdr + 2);
+    std::get<1>(set) = read(paletteAdr);
+    std::get<2>(set) = read(paletteAdr + 1);
+    std::get<3>(set) = read(paletteAdr + 2);
     return set;
 }
 
+void Ppu::copyVideoMemory(VideoMemory& out) const {
+    for (uint16_t page = 0; page != 8; ++page)
+        std::copy(chrPages[page], chrPages[page] + 0x400, out.vram.begin() + page * 0x400);
+    // 0x3000-0x3EFF mirrors the nametables, its last page stops short where the palettes start
+    for (uint16_t adr = 0x2000; adr < 0x3F00; adr += 0x400) {
+        const uint8_t* table = nameTables[(adr >> 10) & 3];
+        std::copy(table, table + std::min(0x400, 0x3F00 - adr), out.vram.begin() + adr);
+    }
+    for (uint16_t adr = 0x3F00; adr != 0x4000; ++adr)
+        out.vram[adr] = vRamRead(adr);
+    // Only the tiles changed since the last copy are decoded again
+    for (uint16_t tile = 0; tile != TILES; ++tile)
+        out.tiles[tile] = getCachedTile(tile);
+}
+
+Ppu::PatternTableT Ppu::VideoMemory::getPatternTile(const uint16_t& tileAddress) const {
+    if (tileAddress < 0x2000 && (tileAddress & 0xF) == 0)
+        return tiles[tileAddress >> 4];
+    return readPatternTile([this](const uint16_t& adr) { return read(adr); }, tileAddress);
+}
+
+Ppu::PatternTableT Ppu::VideoMemory::getPatternTile(const uint8_t& tileID, bool isLeft) const {
+    if (isLeft)
+        return getPatternTile(static_cast<uint16_t>(tileID * 16));
+    return getPatternTile(static_cast<uint16_t>(0x1000 + tileID * 16));
+}
+
+uint8_t Ppu::VideoMemory::getPaletteFromNameTable(const uint16_t& nameTableRelativeAdr, const uint16_t& atrTableStart) const {
+    return readPaletteFromNameTable([this](const uint16_t& adr) { return read(adr); }, nameTableRelativeAdr, atrTableStart);
+}
+
+Ppu::ColorSetT Ppu::VideoMemory::getColorSetFromAdr(const uint16_t& paletteAdr) const {
+    return readColorSet([this](const uint16_t& adr) { return read(adr); }, paletteAdr);
+}
+
 // Gets a chroma colour from a palette given the id and the pixel
 // id and pixel must be in the range (0-3) 2 bits.
 uint8_t Ppu::getChromaFromPaletteRam(const uint8_t& paletteID, const uint8_t& pixel) const {
-    uint16_t paletteStart = 0x3F00 + paletteID * 4; // each palette is 4 bytes long
-    paletteStart += pixel; // index into the palette to get the chroma
-    return vRamRead(paletteStart);
-}
-
-// A write to the ppu's ram bus
-void Ppu::vRamWrite(const uint16_t& adr, const uint8_t& val) {
-    if (inRange(0x2000, 0x3EFF, adr)) {
-        // In this range there is only really two nametables out of the memory addresses of four
-        // Depending on the bit of the header, it will either mirror horizontally or vertically
-
-        // Note that 0x3000 - 0x3EFF are mirror of 0x2000-0x2EFF, so ignore the most sig 8 bits
-        uint16_t cutAdr = adr & 0xFFF;
-        // Vertical mirroring : nametables 1, 3 route to instead 0 and 2
-        if (nes->gamepak.mirror == GamePak::VERTICAL) {
-            if (inRange(0x400, 0x7FF, cutAdr)) { // nametable 1 to 0
-                memory[0x2000 + cutAdr % 0x400] = val;
-            }
-            else if (inRange(0xC00, 0xFFF, cutAdr)) {// nametable 3 to 2
-                memory[0x2800 + cutAdr % 0x400] = val;
-            }
-            else
-                memory[0x2000 + cutAdr] = val;
-        }
-        // Horizontal mirroring : nametables 2, 3 route to 0, 1
-        else {
-            if (inRange(0x800, 0xBFF, cutAdr)) { // nametable 2 to 0
-                memory[0x2000 + cutAdr % 0x400] = val;
-            }
-            else if (inRange(0xC00, 0xFFF, cutAdr)) {// nametable 3 to 1
-                memory[0x2400 + cutAdr % 0x400] = val;
-            }
-            else
-                memory[0x2000 + cutAdr] = val;
-        }
+    // each palette is 4 bytes long, index into the palette to get the chroma
+    return palette[paletteIndex[paletteID * 4 + pixel]];
+}
+
+// Palette ram is 32 bytes at 0x3F00 mirrored up to 0x3FFF, the backdrop entries of the
+// sprite palettes (0x3F10, 0x3F14, 0x3F18, 0x3F1C) are also mirrors of the background's
+const std::array<const uint8_t, 0x20> Ppu::paletteIndex = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    0x00, 0x11, 0x12, 0x13, 0x04, 0x15, 0x16, 0x17, 0x08, 0x19, 0x1A, 0x1B, 0x0C, 0x1D, 0x1E, 0x1F
+};
+
+// In 0x2000-0x3EFF there is only really two nametables out of the four logical ones (four screen carts have all four)
+// Depending on the mirroring of the cartridge (or its mapper), nametables route to one another
+// Each logical nametable points to the 1KB of memory it's routed to
+// Note that 0x3000 - 0x3EFF are mirror of 0x2000-0x2EFF
+void Ppu::setMirroring(const GamePak::MIRRORT& mirror) noexcept {
+    static constexpr uint8_t routes[][4] = {
+        {0, 0, 1, 1}, // HORIZONTAL: nametables 1, 3 route to 0, 2
+        {0, 1, 0, 1}, // VERTICAL: nametables 2, 3 route to 0, 1
+        {0, 0, 0, 0}, // SINGLE_LOWER: every nametable is 0
+        {1, 1, 1, 1}, // SINGLE_UPPER: every nametable is 1
+        {0, 1, 2, 3}  // FOUR_SCREEN: the cartridge has ram for the other two
+    };
+    for (uint8_t i = 0; i != 4; ++i) {
+        nameTablePages[i] = static_cast<uint8_t>(0x8 + routes[mirror][i]);
+        nameTables[i] = memory.read(nameTablePages[i]);
+    }
+}
 
+// A write to the ppu's ram bus, the bus is 14 bits wide
+void Ppu::vRamWrite(const uint16_t& address, const uint8_t& val) {
+    const uint16_t adr = address & 0x3FFF;
+    // Pattern tables are banks of the cartridge, only chr ram can be written to
+    if (adr < 0x2000) {
+        uint8_t* page = chrInMemory ? writableMemory(static_cast<uint8_t>(adr >> 10)) : chrWritePages[adr >> 10];
+        if (page) {
+            page[adr & 0x3FF] = val;
+            tileDirty[adr >> 4] = true;
+        }
     }
-    // Ppu palettes mirror every 0x20
-    else if (inRange(0x3F20, 0x3FFF, adr))
-        memory[0x3F00 + adr % 0x20] = val;
+    else if (adr < 0x3F00)
+        writableMemory(nameTablePages[(adr >> 10) & 3])[adr & 0x3FF] = val;
     else
-        memory[adr] = val;
+        writableMemory(0xF)[0x300 + paletteIndex[adr & 0x1F]] = val;
 }
 
 // A read from ppu's ram bus
 // Use comments from vRamWrite instead of here
-uint8_t Ppu::vRamRead(const uint16_t& adr) const {
-    if (inRange(0x3F20, 0x3FFF, adr))
-        return memory[0x3F00 + adr % 0x20];
-    else if (inRange(0x2000, 0x3EFF, adr)) {
-        uint16_t cutAdr = adr & 0xFFF;
-        // Vertical mirroring : nametables 1, 3 route to instead 0 and 2
-        if (nes->gamepak.mirror == GamePak::VERTICAL) {
-            if (inRange(0x400, 0x7FF, cutAdr)) { // nametable 1 to 0
-                return memory[0x2000 + cutAdr % 0x400];
-            }
-            else if (inRange(0xC00, 0xFFF, cutAdr)) {// nametable 3 to 2
-                return memory[0x2800 + cutAdr % 0x400];
-            }
-            else
-                return memory[0x2000 + cutAdr];
-        }
-        // Horizontal mirroring : nametables 2, 3 route to 0, 1
-        else {
-            if (inRange(0x800, 0xBFF, cutAdr)) { // nametable 2 to 0
-                return memory[0x2000 + cutAdr % 0x400];
-            }
-            else if (inRange(0xC00, 0xFFF, cutAdr)) {// nametable 3 to 1
-                return memory[0x2400 + cutAdr % 0x400];
-            }
-            else
-                return memory[0x2000 + cutAdr];
-        }
-    }
+uint8_t Ppu::vRamRead(const uint16_t& address) const {
+    const uint16_t adr = address & 0x3FFF;
+    if (adr < 0x2000)
+        return chrPages[adr >> 10][adr & 0x3FF];
+    else if (adr < 0x3F00)
+        return nameTables[(adr >> 10) & 3][adr & 0x3FF];
     else
-        return memory[adr];
+        return palette[paletteIndex[adr & 0x1F]];
+}
+
+void Ppu::setChrBanks(const std::array<const uint8_t*, 8>& banks, const std::array<uint8_t*, 8>& writeBanks) noexcept {
+    // A 1KB page is 64 tiles
+    for (uint8_t i = 0; i != 8; ++i) {
+        if (chrPages[i] != banks[i])
+            invalidateTiles(i * 64, 64);
+    }
+    chrPages = banks;
+    chrWritePages = writeBanks;
+    chrInMemory = false;
 }
 
 // https://wiki.nesdev.com/w/index.php/PPU_registers
@@ -285,7 +395,6 @@ uint8_t Ppu::readRegister(const uint16_t& adr) {
             return byte;
         }
         default:
-            std::cerr << "Error Read to address " << std::hex << "0x" << adr << " was detected\n";
             throw std::runtime_error("Attempted read to non PPU register or to a writeonly register of (dec) " + std::to_string(adr));
     }
 }
@@ -299,10 +408,12 @@ void Ppu::writeRegister(const uint16_t& adr, const uint8_t& val) {
             uint8_t bits2 = val & 0b11;
             vTempAdr &= ~0xC00; // clear the spot where these bits will go
             vTempAdr |= static_cast<uint16_t>(bits2) << 10; // move the bits into bit 10, 11
+            updateScanlineIrq();
             break;
         }
         case 0x2001: // Mask > Write
             PpuMask.fromByte(val);
+            updateScanlineIrq();
             break;
         case 0x2003: // OAM address > Write
             OamAddr = val;
@@ -343,15 +454,14 @@ void Ppu::writeRegister(const uint16_t& adr, const uint8_t& val) {
             break;
         case 0x4014: {// OAM DMA > Write
                 // Read/Write from cpu's XX00-XXFF, XX=val, to OAM
-                uint16_t start = static_cast<uint16_t>(static_cast<uint16_t>(val) << 8),
-                        end = start | 0xFF;
-                while (start != end) {
-                    OAM[OamAddr++] = nes->cpu.memory.read(start++);
+                const uint16_t start = static_cast<uint16_t>(static_cast<uint16_t>(val) << 8);
+                for (uint16_t offset = 0; offset != 0x100; ++offset) {
+                    OAM[OamAddr++] = nes->cpu.memory.read(static_cast<uint16_t>(start + offset));
                 }
+                nes->cpu.signalDMA();
                 break;
             }
         default:
-            std::cerr << "Error Write to address " << std::hex << "0x" << adr << " was detected\n";
             throw std::runtime_error("Attempted write to non PPU register or to a readonly register of (dec) " + std::to_string(adr));
     }
 }
@@ -435,7 +545,7 @@ void Ppu::fetchNameTableByte() {
     // The upper two bits contains which nametable, each a multiple of 1024; the size of a nametable
     // Combined this is just the (y * width) + x of a nametable -> (coarse Y scroll) + coarse X scroll
     // Since coarse Y is already in the upper bits of 32, there is no reason to split it
-    nameTableLatch = vRamRead(0x2000 | (vAdr & 0x0FFF));
+    nameTableLatch = nameTables[(vAdr >> 10) & 3][vAdr & 0x3FF];
 }
 
 // Fetch the attribute table byte
@@ -448,12 +558,11 @@ void Ppu::fetchAttrTableByte() {
 
     finalCoarse = coarseX >> 2; // coarse x
     finalCoarse |= (coarseY >> 2) << 3; // coarse y
-    finalCoarse |= vAdr & 0x300; // nametable select
-    finalCoarse |= 0x23C0; // where the attribute tables are located
+    finalCoarse |= 0x3C0; // where the attribute table is located in the nametable
 
     // At this point there is a further spliting into the byte
     // each 2 bits represent a tile
-    uint8_t tileAttr = vRamRead(finalCoarse);
+    uint8_t tileAttr = nameTables[(vAdr >> 10) & 3][finalCoarse];
     if (coarseY & 0x02) tileAttr >>= 4; // In the top half
     if (coarseX & 0x02) tileAttr >>= 2; // In the left half
     // only the bottom 2 bits are considered
@@ -464,9 +573,9 @@ void Ppu::fetchAttrTableByte() {
 
 
 
-// Fetch the lower background tile byte
+// Fetch both background tile bytes, already decoded
 // It's location is known from fetching the nametable byte of which the id is given
-void Ppu::fetchPatternLowByte() {
+void Ppu::fetchPatternRow() {
     // The control register determines which pattern table will be used
     uint16_t patternSelect = static_cast<uint16_t>(PpuCtrl.bkgrdTile << 12);
     // The fetch from the nametable tells the ID of tile that will be used in range 0-0xFF
@@ -475,14 +584,7 @@ void Ppu::fetchPatternLowByte() {
     // The fine y portion of vAdr tells which line of the tile it needs (0-7)
     uint8_t y = getFineY();
 
-    patternTableLowLatch = vRamRead(patternSelect + patternLoc + y);
-
-}
-
-// Fetch the higher background tile byte
-void Ppu::fetchPatternHighByte() {
-    // Same code and idea for lower byte, but +8 for the higher bit plane line
-    patternTableHighLatch = vRamRead( static_cast<uint16_t>( (PpuCtrl.bkgrdTile << 12) + nameTableLatch * 16 + getFineY() + 8) );
+    patternRowLatch = getTileRow(static_cast<uint16_t>(patternSelect + patternLoc + y));
 }
 
 // Shift all the shift registers by 1 to the left
@@ -492,15 +594,13 @@ void Ppu::shiftRegisters() noexcept {
 
     attrShiftLow <<= 1;
     attrShiftHigh <<= 1;
-    bkShiftLow <<= 1;
-    bkShiftHigh <<= 1;
+    bkShift >>= 2;
 }
 
 // Every 8 cycles take the 8 bit latches and store them into the shift registers
 // Since every 8 cycles they are shifted 8 times, the last 8 bits will be 0
 void Ppu::updateShifters() noexcept {
-    bkShiftLow = (bkShiftLow & 0xFF00) | patternTableLowLatch;
-    bkShiftHigh = (bkShiftHigh & 0xFF00) | patternTableHighLatch;
+    bkShift = (bkShift & 0xFFFF) | (static_cast<uint32_t>(patternRowLatch) << 16);
 
     // For attribute tables, one major restriction on NES is that a tile/line can only refer to one palette
     // The attrLatch contains 3 bits of which id of palette to use.
@@ -513,7 +613,8 @@ void Ppu::updateShifters() noexcept {
 // https://forums.nesdev.com/viewtopic.php?t=10348
 void Ppu::renderPixel() {
     // Definately rewrite how to do this later, it is very ugly.
-    if (!PpuMask.bkgrdEnable) return;
+    // The pre render scanline fetches like a visible scanline but has no pixels on screen
+    if (!PpuMask.bkgrdEnable || scanline < 0 || !nes->videoOutput) return;
     // now to display the pixel!
     uint8_t pixel = 0; // pixel contains which color of the palette (0-3)
     uint8_t paletteID = 0; // contains the id of palette
@@ -523,13 +624,11 @@ void Ppu::renderPixel() {
         uint16_t mask = 0x8000 >> fineXScroll;
 
         // Get each individual bit from the shift registers
-        uint8_t p0=0, p1=0, b0=0, b1=0;
-        p0 = (mask & bkShiftLow) > 0;
-        p1 = (mask & bkShiftHigh) > 0;
+        uint8_t b0=0, b1=0;
         b0 = (mask & attrShiftLow) > 0;
         b1 = (mask & attrShiftHigh) > 0;
-        // now combine them
-        pixel = static_cast<uint8_t>( (p1 << 1) | p0);
+        // now combine them, the pattern pixel is already both bits
+        pixel = (bkShift >> (fineXScroll * 2)) & 0b11;
         paletteID = static_cast<uint8_t>( (b1 << 1) | b0);
     }
 
@@ -540,14 +639,98 @@ void Ppu::renderPixel() {
     nes->addVideoData(x, y, chroma);
 }
 
+// The same pixels renderPixel would draw on the 8 cycles starting at firstCycle, followed by the 8 shifts
+void Ppu::renderTile(const uint16_t& firstCycle) {
+    if (!PpuMask.bkgrdEnable) return;
+    const uint8_t y = static_cast<uint8_t>(scanline);
+    // Without video output only the shifts matter
+    for (uint8_t i = 0; i != 8 && nes->videoOutput; ++i) {
+        const uint8_t bit = static_cast<uint8_t>(15 - fineXScroll - i);
+        const uint8_t pixel = (bkShift >> ((fineXScroll + i) * 2)) & 0b11;
+        const uint8_t paletteID = static_cast<uint8_t>((((attrShiftHigh >> bit) & 1) << 1) | ((attrShiftLow >> bit) & 1));
+        nes->addVideoData(static_cast<uint8_t>(firstCycle + i - 1), y, getChromaFromPaletteRam(paletteID, pixel));
+    }
+    attrShiftLow <<= 8;
+    attrShiftHigh <<= 8;
+    bkShift >>= 16;
+}
+
+void Ppu::saveState(StateWriter& state) const {
+    state.write(scanline);
+    state.write(cycle);
+    state.write(vAdr);
+    state.write(vTempAdr);
+    state.write(fineXScroll);
+    state.write(writeToggle);
+    state.write(static_cast<uint8_t>(PpuCtrl));
+    state.write(static_cast<uint8_t>(PpuMask));
+    state.write(static_cast<uint8_t>(PpuStatus));
+    state.write(OamAddr);
+    for (uint8_t page = 0x8; page != 0xC; ++page) // all four nametables, 0x3000-0x3EFF mirrors them
+        state.write(memory.read(page), 0x400);
+    state.write(palette, 0x20);
+    state.write(OAM);
+    state.write(secondOAM);
+    state.write(nameTableLatch);
+    state.write(attrTableLatch);
+    state.write(patternRowLatch);
+    state.write(attrShiftLow);
+    state.write(attrShiftHigh);
+    state.write(bkShift);
+    state.write(completeFrame);
+    state.write(frameCount);
+    state.write(a12High);
+    state.write(a12LowSince);
+}
+
+void Ppu::loadState(StateReader& state) {
+    state.read(scanline);
+    state.read(cycle);
+    state.read(vAdr);
+    state.read(vTempAdr);
+    state.read(fineXScroll);
+    state.read(writeToggle);
+    PpuCtrl.fromByte(state.read<uint8_t>());
+    PpuMask.fromByte(state.read<uint8_t>());
+    PpuStatus.fromByte(state.read<uint8_t>());
+    state.read(OamAddr);
+    for (uint8_t page = 0x8; page != 0xC; ++page)
+        state.read(writableMemory(page), 0x400);
+    state.read(writableMemory(0xF) + 0x300, 0x20);
+    state.read(OAM);
+    state.read(secondOAM);
+    state.read(nameTableLatch);
+    state.read(attrTableLatch);
+    state.read(patternRowLatch);
+    state.read(attrShiftLow);
+    state.read(attrShiftHigh);
+    state.read(bkShift);
+    state.read(completeFrame);
+    state.read(frameCount);
+    state.read(a12High);
+    state.read(a12LowSince);
+    // Chr ram may hold different tiles now
+    invalidateTiles(0, TILES);
+    updateScanlineIrq();
+}
+
+size_t Ppu::ownedBytes() const noexcept {
+    return memory.ownedBytes();
+}
+
 void Ppu::clear() {
     PpuCtrl.clear();
     PpuMask.clear();
     PpuStatus.clear();
-    std::fill(memory.begin(), memory.end(), 0);
+    memory.clear();
+    mapMemory();
+    invalidateTiles(0, TILES);
     std::fill(OAM.begin(), OAM.end(), 0);
     OamAddr = 0;
     scanline = vAdr = vTempAdr = fineXScroll = writeToggle = 0;
+    scanlineIrqDot = NO_IRQ_DOT;
+    a12Tracking = a12High = false;
+    a12LowSince = 0;
 }
 
 // Sets VBlank
@@ -562,6 +745,127 @@ void Ppu::clearVBlank() {
     PpuStatus.clear();
 }
 
+// Position of a cycle from the start of the pre render scanline
+static constexpr int32_t framePosition(const int32_t& scanline, const int32_t& cycle) noexcept {
+    return (scanline + 1) * 341 + cycle;
+}
+
+uint32_t Ppu::cyclesUntilEvent() const noexcept {
+    const int32_t now = framePosition(scanline, cycle);
+    // vblank is set at cycle 1 of scanline 241, the frame completes at the last cycle of scanline 260
+    int32_t untilVBlank = framePosition(241, 1) - now;
+    if (untilVBlank < 0)
+        untilVBlank += framePosition(261, 0);
+    int32_t untilEvent = std::min(untilVBlank, framePosition(260, 340) - now);
+    // The skipped first cycle of scanline 0 is not counted, which can only make this one cycle too late
+    // Be one cycle early instead, catching up early is always safe
+    untilEvent = untilEvent > 0 ? untilEvent - 1 : 0;
+
+    const uint32_t clocks = scanlineIrqDot != NO_IRQ_DOT || a12Tracking ? nes->gamepak.mapper->clocksUntilIrq() : 0;
+    if (clocks == 0)
+        return static_cast<uint32_t>(untilEvent);
+    // A12 edges can happen anywhere when tracking, so the ppu is caught up with the cpu
+    if (a12Tracking)
+        return 0;
+    // The counter is clocked on the pre render line and the visible lines, 241 per frame
+    // Find the line of the clock that raises the irq, counting lines from the pre render line of this frame
+    int32_t line = scanline + 1;
+    if (scanline >= 240)
+        line = 241;
+    else if (cycle > scanlineIrqDot)
+        ++line;
+    line += static_cast<int32_t>(clocks) - 1;
+    const int32_t frames = line / 241;
+    const int32_t untilIrq = frames * framePosition(261, 0) + framePosition(line % 241 - 1, scanlineIrqDot) - now;
+    // Every frame crossed can skip a cycle, be early by that much
+    return static_cast<uint32_t>(std::max(0, std::min(untilEvent, untilIrq - frames - 1)));
+}
+
+// The MMC3 counts rising edges of A12 of the address the ppu reads from, which is set by which pattern table is read
+// Background tiles are fetched on cycles 1-256 and 321-336, sprites tiles on 257-320
+// With the background on the left table and the sprites on the right, A12 rises once per line at cycle 260
+// and the other way around at cycle 324. The counter is clocked then without watching the address.
+// Any other setup (8x16 sprites pick the table per sprite) watches A12 on every cycle instead.
+void Ppu::updateScanlineIrq() noexcept {
+    scanlineIrqDot = NO_IRQ_DOT;
+    a12Tracking = false;
+    const bool rendering = PpuMask.bkgrdEnable || PpuMask.spriteEnable;
+    if (!nes || !nes->gamepak.mapper || !nes->gamepak.mapper->hasScanlineCounter() || !rendering)
+        return;
+    if (PpuCtrl.spriteSz || PpuCtrl.bkgrdTile == PpuCtrl.spriteTile)
+        a12Tracking = true;
+    else
+        scanlineIrqDot = PpuCtrl.bkgrdTile ? 324 : 260;
+}
+
+void Ppu::clockScanlineIrq() {
+    if (nes->gamepak.mapper->clockScanline())
+        nes->cpu.signalIRQ();
+}
+
+// A12 is set by the pattern table of the last fetch, each fetch takes 2 cycles in groups of 8
+// (nametable, attribute, pattern low, pattern high), only pattern fetches can set it
+// Sprites aren't evaluated, empty sprite slots fetch tile 0xFF which is on the right table for 8x16 sprites
+void Ppu::trackA12() {
+    bool high = false;
+    if (inRange(1, 256, cycle) || inRange(321, 336, cycle))
+        high = ((cycle - 1) % 8 >= 4) && PpuCtrl.bkgrdTile;
+    else if (inRange(257, 320, cycle))
+        high = ((cycle - 257) % 8 >= 4) && (PpuCtrl.spriteSz || PpuCtrl.spriteTile);
+
+    const uint64_t now = frameCount * framePosition(261, 0) + static_cast<uint64_t>(framePosition(scanline, cycle));
+    if (high && !a12High) {
+        // The mapper filters out edges after A12 was low for only a few cycles
+        if (now - a12LowSince >= 10)
+            clockScanlineIrq();
+        a12High = true;
+    }
+    else if (!high && a12High) {
+        a12High = false;
+        a12LowSince = now;
+    }
+}
+
+// runCycle does the same work for every group of 8 cycles of a visible scanline
+// (render and shift every cycle, then attribute, pattern low, pattern high, coarse X, reload the shifters and nametable)
+// Nothing outside of the ppu can see it inbetween when no register was touched during the line,
+// so the line is done tile by tile instead. A register access catches the ppu up mid line and the rest
+// of that line is then ran by runCycle.
+uint16_t Ppu::runScanline() {
+    // The first cycle of scanline 0 is skipped
+    const uint16_t cycles = scanline == 0 ? SCANLINE_CYCLES - 1 : SCANLINE_CYCLES;
+    // Cycles 2-257, pixels of this line
+    for (uint16_t tile = 2; tile != 258; tile += 8) {
+        renderTile(tile);
+        fetchAttrTableByte();
+        fetchPatternRow();
+        coraseXIncr();
+        if (tile == 250) // cycle 256
+            coraseYIncr();
+        updateShifters();
+        fetchNameTableByte();
+    }
+    transferX();
+    // Cycles 321-337, the first two tiles of the next line
+    shiftRegisters();
+    updateShifters();
+    fetchNameTableByte();
+    for (uint8_t tile = 0; tile != 2; ++tile) {
+        fetchAttrTableByte();
+        fetchPatternRow();
+        coraseXIncr();
+        for (uint8_t i = 0; i != 8; ++i)
+            shiftRegisters();
+        updateShifters();
+        fetchNameTableByte();
+    }
+    if (scanlineIrqDot != NO_IRQ_DOT)
+        clockScanlineIrq();
+    cycle = 0;
+    ++scanline;
+    return cycles;
+}
+
 void Ppu::runCycle() {
     // The visible scanline
     if (scanline >= -1 && scanline < 240) {
@@ -594,11 +898,8 @@ void Ppu::runCycle() {
                 case 2:
                     fetchAttrTableByte();
                     break;
-                case 4:
-                    fetchPatternLowByte();
-                    break;
-                case 6:
-                    fetchPatternHighByte();
+                case 6: // pattern low and high bytes are fetched on cycles 5 and 7
+                    fetchPatternRow();
                     break;
                 case 7:
                     coraseXIncr(); // done with current tile, incremenet the tiling address to go to the next tile
@@ -621,6 +922,12 @@ void Ppu::runCycle() {
         if (scanline == -1 && inRange(280, 304, cycle)) {
             transferY();
         }
+
+        // Mapper scanline counter
+        if (cycle == scanlineIrqDot)
+            clockScanlineIrq();
+        else if (a12Tracking)
+            trackA12();
     }
 
     // end of the visible frame, set vBlank to true such that cpu can now do work
@@ -631,13 +938,15 @@ void Ppu::runCycle() {
     ++cycle;
 
     // end of hblank, go down one
-    if (cycle > 341) {
+    // a scanline is 341 cycles (0-340)
+    if (cycle > 340) {
         cycle = 0;
         ++scanline;
         // vblank triggered
         if (scanline >= 261) {
             scanline = -1; // -1 for a pre render scanline to render the next 8 pixels
             completeFrame = true;
+            ++frameCount;
         }
     }
 }
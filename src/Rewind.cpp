@@ -0,0 +1,127 @@
+#include "Rewind.h"
+#include "NES.h"
+#include "FramePacer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+Rewind::Rewind(const size_t& budget, const unsigned& interval) : budget(budget), interval(interval ? interval : 1) {}
+
+void Rewind::frameDone(const NES& nes) {
+    if (++frames < interval)
+        return;
+    frames = 0;
+    nes.saveState(scratch);
+    // A different rom was loaded, the old snapshots can't be restored anymore
+    if (!newest.empty() && newest.size() != scratch.size())
+        clear();
+    if (!newest.empty()) {
+        std::vector<uint8_t> delta;
+        encodeDelta(scratch, newest, delta);
+        delta.shrink_to_fit();
+        deltaBytes += delta.size();
+        deltas.push_back(std::move(delta));
+    }
+    newest.swap(scratch);
+    while (!deltas.empty() && deltaBytes + newest.size() > budget) {
+        deltaBytes -= deltas.front().size();
+        deltas.pop_front();
+    }
+}
+
+bool Rewind::rewind(NES& nes) {
+    if (newest.empty())
+        return false;
+    nes.loadState(newest);
+    if (deltas.empty()) {
+        newest.clear();
+    }
+    else {
+        applyDelta(deltas.back(), newest);
+        deltaBytes -= deltas.back().size();
+        deltas.pop_back();
+    }
+    frames = 0;
+    return true;
+}
+
+void Rewind::clear() {
+    newest.clear();
+    deltas.clear();
+    deltaBytes = 0;
+    frames = 0;
+}
+
+Rewind::Stats Rewind::stats() const {
+    Stats stats;
+    stats.snapshots = newest.empty() ? 0 : deltas.size() + 1;
+    stats.bytes = deltaBytes + newest.size();
+    stats.rawBytes = stats.snapshots * newest.size();
+    stats.ratio = stats.bytes ? static_cast<double>(stats.rawBytes) / stats.bytes : 0.0;
+    stats.seconds = stats.snapshots * interval / FramePacer::NTSC_RATE;
+    return stats;
+}
+
+static void writeVarint(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t readVarint(const uint8_t*& in, const uint8_t* end) {
+    size_t value = 0;
+    for (unsigned shift = 0; in != end; shift += 7) {
+        const uint8_t byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw std::runtime_error("Rewind delta is truncated");
+}
+
+// Equal bytes are skipped 8 at a time, they're most of the state
+void Rewind::encodeDelta(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to, std::vector<uint8_t>& out) {
+    if (from.size() != to.size())
+        throw std::invalid_argument("Rewind deltas need states of the same size");
+    out.clear();
+    const size_t size = from.size();
+    size_t pos = 0;
+    while (pos != size) {
+        const size_t zeroStart = pos;
+        while (pos + 8 <= size && std::memcmp(&from[pos], &to[pos], 8) == 0)
+            pos += 8;
+        while (pos != size && from[pos] == to[pos])
+            ++pos;
+        const size_t literalStart = pos;
+        // A literal run ends at the first 4 equal bytes in a row, shorter zero runs cost more than they save
+        size_t equal = 0;
+        while (pos != size && equal != 4) {
+            equal = from[pos] == to[pos] ? equal + 1 : 0;
+            ++pos;
+        }
+        if (equal == 4)
+            pos -= 4;
+        writeVarint(out, literalStart - zeroStart);
+        writeVarint(out, pos - literalStart);
+        for (size_t i = literalStart; i != pos; ++i)
+            out.push_back(from[i] ^ to[i]);
+    }
+}
+
+void Rewind::applyDelta(const std::vector<uint8_t>& delta, std::vector<uint8_t>& buffer) {
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+    size_t pos = 0;
+    while (in != end) {
+        pos += readVarint(in, end);
+        const size_t literals = readVarint(in, end);
+        if (pos + literals > buffer.size() || literals > static_cast<size_t>(end - in))
+            throw std::runtime_error("Rewind delta does not fit the state");
+        for (size_t i = 0; i != literals; ++i)
+            buffer[pos + i] ^= in[i];
+        in += literals;
+        pos += literals;
+    }
+}
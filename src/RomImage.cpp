@@ -0,0 +1,144 @@
+#include "RomImage.h"
+#include "functions.hpp"
+#include "SaveState.hpp" // fnv1a
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROMIMAGE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t headerSize = 16;
+static constexpr size_t trainerSize = 512;
+// Alignment of the read buffer, a cache line
+static constexpr size_t bufferAlignment = 64;
+
+// Where the file can be stat'd it's known by its inode, size and modification time, so other paths to it
+// find the same image and a rom that was rebuilt since is opened anew. Otherwise only the path is known.
+static std::string fileKey(const std::string& fname) {
+#ifdef ROMIMAGE_MMAP
+    struct stat st;
+    if (stat(fname.c_str(), &st) == 0)
+        return std::to_string(st.st_dev) + ':' + std::to_string(st.st_ino) + ':' + std::to_string(st.st_size) + ':' + std::to_string(st.st_mtime);
+#endif
+    return fname;
+}
+
+std::shared_ptr<const RomImage> RomImage::open(const std::string& fname) {
+    // Only images still used by someone are found, the last owner letting go unmaps the file as usual
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const RomImage>> images;
+    const std::string key = fileKey(fname);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::shared_ptr<const RomImage> image = images[key].lock())
+        return image;
+    std::shared_ptr<const RomImage> image = load(fname);
+    for (auto it = images.begin(); it != images.end();)
+        it = it->second.expired() && it->first != key ? images.erase(it) : std::next(it);
+    images[key] = image;
+    return image;
+}
+
+std::shared_ptr<const RomImage> RomImage::load(const std::string& fname) {
+    std::shared_ptr<RomImage> image(new RomImage());
+    if (!image->mapFile(fname))
+        image->readFile(fname);
+
+    image->header = parseHeader(image->file, image->fileSize);
+    const Header& header = image->header;
+    image->prgSize = header.prgBanks * size_t(memsize::KB16);
+    image->chrSize = header.chrBanks * size_t(memsize::KB8);
+    image->prgRom = image->file + headerSize + (header.trainer ? trainerSize : 0);
+    image->chrRom = image->prgRom + image->prgSize;
+    image->hash = fnv1a(image->chrRom, image->chrSize, fnv1a(image->prgRom, image->prgSize));
+    return image;
+}
+
+RomImage::Header RomImage::parseHeader(const uint8_t* bytes, const size_t& fileSize) {
+    // Check if the iNES header contains the NES bytes to check if its a correct file
+    bool isNESFile = fileSize >= headerSize && bytes[0] == 'N' && bytes[1] == 'E' && bytes[2] == 'S' && bytes[3] == 0x1A;
+    if (!isNESFile) {
+        throw std::runtime_error("Unsupported file type");
+    }
+    Header header;
+    header.prgBanks = bytes[4];
+    header.chrBanks = bytes[5];
+    header.flags6 = bytes[6];
+    header.flags7 = bytes[7];
+    header.flags8 = bytes[8];
+    header.flags9 = bytes[9];
+    header.flags10 = bytes[10];
+    header.mirror = static_cast<GamePak::MIRRORT>(header.flags6 & 1);
+    header.trainer = header.flags6 & 0x04;
+    header.fourScreen = header.flags6 & 0x08;
+    if (header.fourScreen)
+        header.mirror = GamePak::FOUR_SCREEN;
+    // Old dumps put junk in the padding of the header, the upper nibble of flags 7 is then junk as well
+    const bool dirtyHeader = bytes[12] || bytes[13] || bytes[14] || bytes[15];
+    header.mapper = static_cast<uint8_t>((header.flags6 >> 4) | (dirtyHeader ? 0 : header.flags7 & 0xF0));
+
+    if (header.prgBanks == 0)
+        throw std::runtime_error("Rom has no PRG ROM");
+    const size_t expected = headerSize + (header.trainer ? trainerSize : 0)
+                            + header.prgBanks * size_t(memsize::KB16) + header.chrBanks * size_t(memsize::KB8);
+    if (fileSize < expected)
+        throw std::runtime_error("Rom is smaller than its header says (" + std::to_string(fileSize) + " < " + std::to_string(expected) + ")");
+    return header;
+}
+
+RomImage::~RomImage() {
+#ifdef ROMIMAGE_MMAP
+    if (mapped)
+        munmap(const_cast<uint8_t*>(file), fileSize);
+#endif
+}
+
+// Maps the file read only, the pages are shared with the page cache so nothing is copied
+bool RomImage::mapFile(const std::string& fname) {
+#ifdef ROMIMAGE_MMAP
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("File not found, given path:" + fname);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+    file = static_cast<const uint8_t*>(addr);
+    fileSize = static_cast<size_t>(st.st_size);
+    mapped = true;
+    return true;
+#else
+    UNUSED(fname);
+    return false;
+#endif
+}
+
+// Reads the whole file with a single read into an aligned buffer
+void RomImage::readFile(const std::string& fname) {
+    std::ifstream ifs(fname, std::ios_base::binary | std::ios_base::in | std::ios_base::ate);
+    if (!ifs.good()) {
+        throw std::runtime_error("File not found, given path:" + fname);
+    }
+    fileSize = static_cast<size_t>(ifs.tellg());
+    ifs.seekg(0);
+    buffer.reset(new uint8_t[fileSize + bufferAlignment]);
+    uint8_t* aligned = buffer.get() + (bufferAlignment - reinterpret_cast<uintptr_t>(buffer.get()) % bufferAlignment) % bufferAlignment;
+    ifs.read(reinterpret_cast<char*>(aligned), static_cast<std::streamsize>(fileSize));
+    if (static_cast<size_t>(ifs.gcount()) != fileSize)
+        throw std::runtime_error("Could not read file, given path:" + fname);
+    file = aligned;
+}
@@ -0,0 +1,38 @@
+#include "RunAhead.h"
+#include "NES.h"
+
+#include <algorithm>
+
+constexpr unsigned RunAhead::MAX_FRAMES;
+
+RunAhead::RunAhead(const unsigned& frames) : ahead(std::min(frames, MAX_FRAMES)) {}
+
+void RunAhead::setFrames(const unsigned& frames) {
+    ahead = std::min(frames, MAX_FRAMES);
+}
+
+unsigned RunAhead::frames() const {
+    return ahead;
+}
+
+void RunAhead::runFrame(NES& nes) {
+    startFrame(nes);
+    nes.runFrame();
+    finishFrame(nes);
+}
+
+void RunAhead::startFrame(NES& nes) const {
+    nes.videoOutput = ahead == 0;
+}
+
+// The frames ahead latch whatever the controllers hold now, which is the guess that the input stays the same
+void RunAhead::finishFrame(NES& nes) {
+    if (ahead == 0)
+        return;
+    nes.saveState(state);
+    for (unsigned frame = 1; frame != ahead; ++frame)
+        nes.runFrame();
+    nes.videoOutput = true;
+    nes.runFrame();
+    nes.loadState(state);
+}
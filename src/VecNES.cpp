@@ -0,0 +1,155 @@
+#include "VecNES.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+constexpr size_t VecNES::SCREEN_SIZE;
+
+VecNES::VecNES(const std::string& rom, const size_t& count, const uint8_t& observations, const unsigned& threads)
+    : observations(observations) {
+    if (count == 0)
+        throw std::invalid_argument("VecNES needs atleast one nes");
+    std::shared_ptr<NES> first = std::make_shared<NES>();
+    first->init();
+    first->load(rom);
+    first->powerUp();
+    // Nothing looks at the pixels unless the screen is observed
+    first->videoOutput = observations & SCREEN;
+    first->saveState(powerOnState);
+    nes.reserve(count);
+    nes.push_back(first);
+    while (nes.size() != count)
+        nes.push_back(first->clone());
+    if (observations & SCREEN)
+        screenBuffer.resize(count * SCREEN_SIZE);
+    if (observations & RAM)
+        ramBuffer.resize(count * Memory::RAM_SIZE);
+    for (size_t index = 0; index != count; ++index)
+        observe(index);
+
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threadCount = std::min(count, threads ? threads : cores);
+    for (size_t thread = 1; thread < threadCount; ++thread)
+        pool.emplace_back(&VecNES::poolThread, this);
+}
+
+VecNES::~VecNES() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : pool)
+        thread.join();
+}
+
+size_t VecNES::size() const {
+    return nes.size();
+}
+
+unsigned VecNES::threads() const {
+    return static_cast<unsigned>(pool.size() + 1);
+}
+
+void VecNES::step(const uint8_t* actions) {
+    this->actions = actions;
+    next = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        working = pool.size();
+    }
+    wake.notify_all();
+    work();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return working == 0; });
+    }
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void VecNES::step(const std::vector<uint8_t>& actions) {
+    if (actions.size() != nes.size())
+        throw std::invalid_argument("Given " + std::to_string(actions.size()) + " actions for " + std::to_string(nes.size()) + " nes");
+    step(actions.data());
+}
+
+void VecNES::reset(const size_t& index) {
+    NES& reset = *nes.at(index);
+    reset.loadState(powerOnState);
+    // The screen and the buttons held aren't part of the state
+    reset.screen = {};
+    for (Controller& controller : reset.controllers)
+        controller.setButtons(0);
+    observe(index);
+}
+
+void VecNES::resetAll() {
+    for (size_t index = 0; index != nes.size(); ++index)
+        reset(index);
+}
+
+const uint8_t* VecNES::screens() const {
+    return screenBuffer.empty() ? nullptr : screenBuffer.data();
+}
+
+const uint8_t* VecNES::ram() const {
+    return ramBuffer.empty() ? nullptr : ramBuffer.data();
+}
+
+NES& VecNES::operator[](const size_t& index) {
+    return *nes[index];
+}
+
+const NES& VecNES::operator[](const size_t& index) const {
+    return *nes[index];
+}
+
+void VecNES::observe(const size_t& index) {
+    if (observations & SCREEN)
+        std::memcpy(&screenBuffer[index * SCREEN_SIZE], nes[index]->screen[0].data(), SCREEN_SIZE);
+    if (observations & RAM)
+        nes[index]->cpu.memory.copyRam(&ramBuffer[index * Memory::RAM_SIZE]);
+}
+
+void VecNES::runFrame(const size_t& index) {
+    try {
+        nes[index]->controllers[0].setButtons(actions[index]);
+        nes[index]->runFrame();
+        observe(index);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error)
+            error = std::current_exception();
+    }
+}
+
+// Each nes is taken by whichever thread gets to it first, a thread stuck on a slow frame leaves
+// the rest of the step to the others
+void VecNES::work() {
+    for (size_t index = next++; index < nes.size(); index = next++)
+        runFrame(index);
+}
+
+void VecNES::poolThread() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, &seen]() { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+        work();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--working == 0)
+            finished.notify_one();
+    }
+}
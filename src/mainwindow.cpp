@@ -5,11 +5,17 @@
 #include <QMessageBox>
 #include <QTimer>
 #include <QString>
+#include <QSettings>
+#include <QKeySequence>
+#include <QKeyEvent>
+#include <QActionGroup>
 #include <iostream>
+#include <array>
 #include <memory>
+#include <algorithm>
+#include <chrono>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include "functions.hpp" // apply_from_tuple
 
 std::ostream& operator<<(std::ostream&, const QString&); // helper for << operator for qstrings
 
@@ -17,20 +23,46 @@ std::ostream& operator<<(std::ostream&, const QString&); // helper for << operat
 MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
     ui->setupUi(this);
     nes = std::make_shared<NES>();
-    // Other tables must be intantiated after nes has been created
-    nameTableViewer = new NameTableView(nes, false);
-    patternTableViewer = new PatternTableView(nes, false);
+    emulator = std::make_unique<EmulationThread>(nes);
+    setupScreen();
+    loadKeyMap();
+    // The viewers only get the vram copies that come with the frames, see timeTick
+    nameTableViewer = new NameTableView();
+    patternTableViewer = new PatternTableView();
 
     nameTableViewer->hide();
     patternTableViewer->hide();
 
-    // connect everything but don't run it
+    // Timer for picking up frames and errors from the emulation thread
     this->timer = new QTimer(this);
-
-    // Timer for stepping the nes
     connect(this->timer, &QTimer::timeout, this, &MainWindow::timeTick);
+    timer->start(POLL_MS);
     // File menubar
     connect(ui->actionOpen_iNES_file, &QAction::triggered, this, &MainWindow::loadFile);
+    connect(ui->actionRecord_Movie, &QAction::triggered, this, &MainWindow::recordMovie);
+    connect(ui->actionPlay_Movie, &QAction::triggered, this, &MainWindow::playMovie);
+    connect(ui->actionStop_Movie, &QAction::triggered, this, [&](){
+        sendCommand(EmulationThread::Command::STOP_MOVIE);
+    });
+    // Emulation menubar
+    connect(ui->actionReset, &QAction::triggered, this, [&](){
+        sendCommand(EmulationThread::Command::RESET);
+    });
+    connect(ui->actionPause, &QAction::toggled, this, [&](bool paused){
+        sendCommand(paused ? EmulationThread::Command::PAUSE : EmulationThread::Command::RESUME);
+    });
+    QActionGroup* runAheadGroup = new QActionGroup(this);
+    const std::array<QAction*, 3> runAheadActions{ui->actionRun_Ahead_Off, ui->actionRun_Ahead_1, ui->actionRun_Ahead_2};
+    for (unsigned frames = 0; frames != runAheadActions.size(); ++frames) {
+        runAheadGroup->addAction(runAheadActions[frames]);
+        connect(runAheadActions[frames], &QAction::triggered, this, [this, frames](){
+            EmulationThread::Command command;
+            command.type = EmulationThread::Command::RUN_AHEAD;
+            command.frames = frames;
+            if (!emulator->send(std::move(command)))
+                sendMessage("The emulator is busy, try again");
+        });
+    }
     // Debug menubar
     connect(ui->actionNametable_Viewer, &QAction::triggered, this, [&](){
         nameTableViewer->show();
@@ -38,6 +70,16 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(ui->actionPatternTable_Viewer, &QAction::triggered, this, [&](){
         patternTableViewer->show();
     });
+    connect(ui->actionMeasure_Input_Latency, &QAction::toggled, this, [&](bool measure){
+        measureLatency = measure;
+    });
+    connect(ui->actionShow_Frame_Stats, &QAction::toggled, this, [&](bool show){
+        showFrameStats = show;
+        presentNs = 0;
+        presentCount = 0;
+        if (!show)
+            setWindowTitle("YaNES");
+    });
 
 }
 
@@ -49,9 +91,12 @@ MainWindow::MainWindow(std::shared_ptr<NES> nes, QWidget *parent) :
 
     ui->setupUi(this);
     this->nes = nes;
+    emulator = std::make_unique<EmulationThread>(nes, true);
+    setupScreen();
+    loadKeyMap();
     this->timer = new QTimer(this);
     connect(this->timer, &QTimer::timeout, this, &MainWindow::timeTick);
-    timer->start(0);
+    timer->start(POLL_MS);
 }
 
 MainWindow::~MainWindow() {
@@ -63,41 +108,137 @@ void MainWindow::paintEvent(QPaintEvent*) {
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *key) {
-    UNUSED(key);
+    setKey(key, true);
 }
 
 void MainWindow::keyReleaseEvent(QKeyEvent *key) {
-    UNUSED(key);
+    setKey(key, false);
+}
+
+// Keys are stored as QKeySequence strings ("X", "Return", "Left") under keymap/player1/A etc. and the
+// key held to rewind under keymap/rewind
+// Missing ones are written with the defaults so there's a file to edit, an empty string unbinds a button
+void MainWindow::loadKeyMap() {
+    static const std::array<std::pair<const char*, uint8_t>, 8> buttons{{
+        {"A", Controller::A}, {"B", Controller::B}, {"Select", Controller::SELECT}, {"Start", Controller::START},
+        {"Up", Controller::UP}, {"Down", Controller::DOWN}, {"Left", Controller::LEFT}, {"Right", Controller::RIGHT}
+    }};
+    static const std::array<const char*, 8> player1Defaults{{"X", "Z", "Backspace", "Return", "Up", "Down", "Left", "Right"}};
+
+    QSettings settings("YaNES", "YaNES");
+    settings.beginGroup("keymap");
+    keyMap.clear();
+    for (uint8_t player = 0; player != 2; ++player) {
+        for (size_t i = 0; i != buttons.size(); ++i) {
+            const QString name = QString("player%1/%2").arg(player + 1).arg(buttons[i].first);
+            if (!settings.contains(name))
+                settings.setValue(name, player == 0 ? player1Defaults[i] : "");
+            const QKeySequence sequence(settings.value(name).toString());
+            if (!sequence.isEmpty())
+                keyMap[sequence[0]] = KeyBinding{player, buttons[i].second};
+        }
+    }
+    if (!settings.contains("rewind"))
+        settings.setValue("rewind", "R");
+    const QKeySequence rewind(settings.value("rewind").toString());
+    rewindKey = rewind.isEmpty() ? 0 : rewind[0];
+    settings.endGroup();
+}
+
+void MainWindow::setKey(QKeyEvent* key, const bool& pressed) {
+    if (rewindKey && key->key() == rewindKey && !key->isAutoRepeat()) {
+        sendCommand(pressed ? EmulationThread::Command::REWIND_START : EmulationThread::Command::REWIND_STOP);
+        return;
+    }
+    auto binding = keyMap.find(key->key());
+    if (key->isAutoRepeat() || binding == keyMap.end()) {
+        key->ignore();
+        return;
+    }
+    uint8_t& buttons = held[binding->second.player];
+    buttons = static_cast<uint8_t>(pressed ? (buttons | binding->second.button) : (buttons & ~binding->second.button));
+    int64_t eventTime = 0;
+    if (measureLatency)
+        eventTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    emulator->setButtons(binding->second.player, buttons, eventTime);
 }
 
-void MainWindow::setPaintColour(QPainter& painter, const QColor& c) {
-    painter.setPen(c);
-    painter.setBrush(c);
+// Printed once per frame that had a measured key event latched, present is when it was painted
+void MainWindow::reportLatency(const EmulationThread::Frame& frame) {
+    if (!measureLatency || !frame.inputEvent || frame.number == lastLatencyFrame)
+        return;
+    lastLatencyFrame = frame.number;
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::cout << "Input latency, frame " << frame.number << ": key to latch " << (frame.inputLatch - frame.inputEvent) / 1e6
+              << " ms, key to present " << (now - frame.inputEvent) / 1e6 << " ms\n";
+}
+
+void MainWindow::setupScreen() {
+    resize(256 * 3, 240 * 3 + ui->menuBar->height());
+}
+
+// Largest integer scale of the screen that fits under the menu bar, centered
+QRect MainWindow::screenRect() const {
+    const int top = ui->menuBar->height();
+    const int width = this->width(), height = this->height() - top;
+    const int scale = std::max(1, std::min(width / 256, height / 240));
+    return QRect((width - 256 * scale) / 2, top + (height - 240 * scale) / 2, 256 * scale, 240 * scale);
 }
 
 void MainWindow::paint() {
+    presentTimer.start();
     QPainter painter(this);
+    // no smooth transform, so the scale is nearest neighbour
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    // Wraps the frame the emulation thread handed over without copying it, it's ours until the next newFrame
+    const EmulationThread::Frame& frame = emulator->frame();
+    const QImage image(reinterpret_cast<const uchar*>(frame.pixels.data()), 256, 240, 256 * sizeof(uint32_t), QImage::Format_RGB32);
+    painter.drawImage(screenRect(), image);
+    painter.end();
+    reportLatency(frame);
+    if (!showFrameStats)
+        return;
 
-    for (uint8_t y = 0; y != 240; y++) {
-        for (uint8_t x = 0; x != 255; x++) {
-            auto rgb = Ppu::getRGBPalette(nes->screen[y][x] & 0x3F);
-            QColor colour = apply_from_tuple(qRgb, rgb);
-            setPaintColour(painter, colour);
-            painter.drawRect(x, y, 1, 1);
-        }
+    presentNs += presentTimer.nsecsElapsed();
+    if (++presentCount == PRESENT_REPORT) {
+        const FramePacer::Stats& pacing = emulator->frame().pacing;
+        const Rewind::Stats& rewind = emulator->frame().rewind;
+        setWindowTitle(QString("YaNES - present %1 ms, frame %2 ms p99 %3 ms jitter %4 ms, rewind %5 s in %6 KB (%7x)")
+                       .arg(presentNs / 1e6 / PRESENT_REPORT, 0, 'f', 3).arg(pacing.mean, 0, 'f', 3)
+                       .arg(pacing.p99, 0, 'f', 3).arg(pacing.maxJitter, 0, 'f', 3)
+                       .arg(rewind.seconds, 0, 'f', 1).arg(rewind.bytes / 1024).arg(rewind.ratio, 0, 'f', 1));
+        presentNs = 0;
+        presentCount = 0;
     }
-
 }
 
+// Never waits on the emulation thread, only repaints when it finished a new frame
 void MainWindow::timeTick() {
-    for (int i = 0; i != 15; ++i) nes->step();
-
-    if (nes->ppu.completeFrame) {
-        nes->ppu.completeFrame = false;
-        repaint();
+    std::string error;
+    while (emulator->popError(error)) {
+        std::cerr << error << "\n";
+        sendMessage(QString("A fatal error has occured!\n") + QString::fromStdString(error));
+    }
+    // Vram is only copied into the frames while a viewer is open
+    const bool viewing = nameTableViewer && (nameTableViewer->isVisible() || patternTableViewer->isVisible());
+    emulator->setVideoMemoryCopies(viewing);
+    if (emulator->newFrame()) {
+        const EmulationThread::Frame& frame = emulator->frame();
+        if (viewing && frame.hasVideoMemory) {
+            nameTableViewer->setVideoMemory(frame.videoMemory);
+            patternTableViewer->setVideoMemory(frame.videoMemory);
+        }
+        update();
     }
 }
 
+void MainWindow::sendCommand(const EmulationThread::Command::Type& type) {
+    EmulationThread::Command command;
+    command.type = type;
+    if (!emulator->send(std::move(command)))
+        std::cerr << "Emulation thread command queue is full, command dropped\n";
+}
+
 void MainWindow::loadFile() {
     // Set a file dialog to select which file
     QFileDialog dialog(this);
@@ -127,35 +268,42 @@ void MainWindow::loadFile() {
         std::cerr << "This is most likely an error with QT\n";
         return;
     }
-    // At this point we have a valid file, now load it into the NES
-    // Important!
-    // Make sure the timer is not trying to run or display anything while we
-    // are trying to load the nes contents
-    bool active = timer->isActive();
-
-    try {
-        if (active) {
-            timer->stop();
-        }
-        // Load the componenets
-        nes->init();
-        nes->load(filename.toStdString());
-        // Set components to power up state
-        nes->powerUp();
-        // Start displaying
-        timer->start(0);
-    } catch(const std::exception& e) {
-        // Error has occured, tell the user
-        std::cerr << e.what() << "\n";
-        QString message = "A fatal error has occured!\n";
-        message += e.what();
-        sendMessage(message);
-        // If the last rom was a working rom, start it again
-        if (active) {
-            timer->start(0);
-        }
+    // At this point we have a valid file, the emulation thread loads it and reports back any error
+    EmulationThread::Command command;
+    command.type = EmulationThread::Command::LOAD;
+    command.fname = filename.toStdString();
+    if (!emulator->send(std::move(command)))
+        sendMessage("The emulator is busy, try again");
+    // Loading unpauses
+    ui->actionPause->setChecked(false);
+}
 
-    }
+// Records from power on of the loaded rom into the chosen file, it's written when the recording stops
+void MainWindow::recordMovie() {
+    const QString filename = QFileDialog::getSaveFileName(this, "Record Movie", QString(), "YaNES movies (*.ynm)",
+                                                          nullptr, QFileDialog::DontUseNativeDialog);
+    if (filename.isEmpty())
+        return;
+    EmulationThread::Command command;
+    command.type = EmulationThread::Command::RECORD_MOVIE;
+    command.fname = filename.toStdString();
+    if (!emulator->send(std::move(command)))
+        sendMessage("The emulator is busy, try again");
+    ui->actionPause->setChecked(false);
+}
+
+// Plays a movie of the loaded rom from power on, the keys take over again once it ends
+void MainWindow::playMovie() {
+    const QString filename = QFileDialog::getOpenFileName(this, "Play Movie", QString(), "YaNES movies (*.ynm)",
+                                                          nullptr, QFileDialog::DontUseNativeDialog);
+    if (filename.isEmpty())
+        return;
+    EmulationThread::Command command;
+    command.type = EmulationThread::Command::PLAY_MOVIE;
+    command.fname = filename.toStdString();
+    if (!emulator->send(std::move(command)))
+        sendMessage("The emulator is busy, try again");
+    ui->actionPause->setChecked(false);
 }
 
 // Function sends a message to the user in a UI box
@@ -0,0 +1,81 @@
+#include "tests.hpp"
+#include "NES.h"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+void Tests::cloneTest() {
+    std::cout << "\n--- Running Clone Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes", nestest = "../rsc/tests/nestest.nes";
+    for (const std::string& fname : {donkeyKong, nestest}) {
+        // A clone taken mid frame runs exactly like the nes it came from, and a nes with a clone runs like one without
+        std::shared_ptr<NES> nes = createNES(fname), reference = createNES(fname);
+        runFrames(*nes, 100);
+        nes->runCycles(12345);
+        runFrames(*reference, 100);
+        reference->runCycles(12345);
+        std::shared_ptr<NES> clone = nes->clone();
+        ckPassFail(clone->saveState() == nes->saveState() && clone->screen == nes->screen, "Clone differs from " + fname);
+        runFrames(*reference, 100);
+        runFrames(*clone, 100);
+        runFrames(*nes, 100);
+        const std::vector<uint8_t> expected = reference->saveState();
+        ckPassFail(clone->saveState() == expected && clone->screen == reference->screen, "Clone runs differently in " + fname);
+        ckPassFail(nes->saveState() == expected && nes->screen == reference->screen, "Cloning changed how " + fname + " runs");
+    }
+
+    // Clones must never write into each other, whichever side writes first
+    std::shared_ptr<NES> nes = createNES(donkeyKong);
+    runFrames(*nes, 60);
+    const std::vector<uint8_t> before = nes->saveState();
+    const auto screen = nes->screen;
+    std::shared_ptr<NES> clone = nes->clone();
+    clone->cpu.memory.write(0x0010, 0xAA);
+    clone->ppu.vRamWrite(0x2000, 0xBB);
+    clone->ppu.vRamWrite(0x3F01, 0x0C);
+    runFrames(*clone, 120, Controller::START);
+    ckPassFail(clone->cpu.memory.read(0x0810) == clone->cpu.memory.read(0x0010), "Ram mirror of a clone was not remapped");
+    ckPassFail(nes->saveState() == before && nes->screen == screen, "Running a clone changed the nes it was cloned from");
+    const std::vector<uint8_t> cloneState = clone->saveState();
+    nes->cpu.memory.write(0x0020, static_cast<uint8_t>(~clone->cpu.memory.read(0x0020)));
+    nes->ppu.vRamWrite(0x2400, static_cast<uint8_t>(~clone->ppu.vRamRead(0x2400)));
+    nes->ppu.vRamWrite(0x3F02, static_cast<uint8_t>(~clone->ppu.vRamRead(0x3F02) & 0x3F));
+    ckPassFail(clone->saveState() == cloneState, "Nes wrote into its clone");
+
+    // The clone draws into its own screen, never into the frame buffer of the nes
+    std::array<uint32_t, 256 * 240> frameBuffer{};
+    nes->setFrameBuffer(frameBuffer.data(), 256 * sizeof(uint32_t));
+    runFrames(*nes, 1);
+    const std::array<uint32_t, 256 * 240> drawn = frameBuffer;
+    clone = nes->clone();
+    clone->ppu.vRamWrite(0x3F00, 0x30);
+    runFrames(*clone, 2);
+    ckPassFail(frameBuffer == drawn, "Clone drew into the frame buffer of the nes");
+    nes->setFrameBuffer(nullptr, 0);
+
+    // Parts only point at their own nes, so nothing keeps a dropped clone alive
+    std::weak_ptr<NES> dropped = clone;
+    clone.reset();
+    ckPassFail(dropped.expired(), "Clone was not freed");
+
+    // Planners branch thousands of times a second, a clone and its first frame are timed separately
+    const int runs = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i != runs; ++i)
+        clone = nes->clone();
+    const double cloneTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    const int frames = 200;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i != frames; ++i)
+        nes->clone()->runFrame();
+    const double branchTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i != frames; ++i)
+        nes->runFrame();
+    const double frameTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+    std::cout << "Clone: " << cloneTime << " us, clone and run a frame: " << branchTime << " us, frame alone: " << frameTime << " us\n";
+    ckPassErr(cloneTime * 20 < frameTime, "Cloning takes over 5% of a frame");
+    ckBench(cloneTime < 20, "Cloning takes over 20 us");
+}
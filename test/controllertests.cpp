@@ -0,0 +1,74 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Controller.h"
+
+#include <chrono>
+#include <memory>
+
+// Reads all 8 buttons the way games do, strobing then reading $4016/$4017 8 times
+static uint8_t readButtons(std::shared_ptr<NES> nes, const uint16_t& port) {
+    nes->cpu.memory.write(0x4016, 1);
+    nes->cpu.memory.write(0x4016, 0);
+    uint8_t buttons = 0;
+    for (int i = 0; i != 8; ++i)
+        buttons |= (nes->cpu.memory.read(port) & 0x1) << i;
+    return buttons;
+}
+
+static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tests::controllerTest() {
+    std::cout << "\n--- Running Controller Tests ---\n";
+    std::shared_ptr<NES> nes = std::make_shared<NES>();
+    nes->init();
+
+    nes->controllers[0].setButtons(Controller::A | Controller::START | Controller::RIGHT);
+    nes->controllers[1].setButtons(Controller::B | Controller::UP);
+    ckPassFail(readButtons(nes, 0x4016) == (Controller::A | Controller::START | Controller::RIGHT), "Player 1 buttons read wrong");
+    ckPassFail(readButtons(nes, 0x4017) == (Controller::B | Controller::UP), "Player 2 buttons read wrong");
+    ckPassFail(nes->cpu.memory.read(0x4016) == 0x41, "Reads after the 8 buttons must be 1 with open bus 0x40");
+
+    // What's held at the strobe is what's read, changes after are only seen on the next strobe
+    nes->controllers[0].setButtons(Controller::SELECT);
+    nes->cpu.memory.write(0x4016, 1);
+    nes->cpu.memory.write(0x4016, 0);
+    nes->controllers[0].setButtons(Controller::DOWN);
+    ckPassFail((nes->cpu.memory.read(0x4016) & 0x1) == 0, "A was read as held");
+    ckPassFail((nes->cpu.memory.read(0x4016) & 0x1) == 0, "B was read as held");
+    ckPassFail((nes->cpu.memory.read(0x4016) & 0x1) == 1, "Select latched at the strobe was lost");
+    ckPassFail(readButtons(nes, 0x4016) == Controller::DOWN, "Buttons set after the strobe were not latched on the next one");
+
+    // While the strobe is held high every read returns the current state of A
+    nes->cpu.memory.write(0x4016, 1);
+    nes->controllers[0].setButtons(Controller::A);
+    ckPassFail((nes->cpu.memory.read(0x4016) & 0x1) == 1 && (nes->cpu.memory.read(0x4016) & 0x1) == 1, "Strobe high did not return A");
+    nes->cpu.memory.write(0x4016, 0);
+
+    // A measured event is reported once, by the strobe that first latched it
+    int64_t event, latch;
+    nes->controllers[0].takeLatchedEvent(event, latch);
+    ckPassFail(event == 0 && latch == 0, "Latched an event that was never measured");
+    const int64_t pressed = now();
+    nes->controllers[0].setButtons(Controller::B, pressed);
+    readButtons(nes, 0x4016);
+    readButtons(nes, 0x4016);
+    nes->controllers[0].takeLatchedEvent(event, latch);
+    ckPassFail(event == pressed && latch >= pressed, "Measured event was not latched");
+    nes->controllers[0].takeLatchedEvent(event, latch);
+    ckPassFail(event == 0, "Measured event was reported twice");
+
+    // Donkey Kong keeps the buttons it read this frame at $14, shifted in with A ending up as bit 7
+    std::shared_ptr<NES> game = createNES("../rsc/roms/Donkey Kong (World) (Rev A).nes");
+    runFrames(*game, 60);
+    ckPassFail(game->cpu.memory[0x14] == 0, "Donkey Kong read a button that wasn't held");
+    game->controllers[0].setButtons(Controller::START);
+    game->runFrame();
+    game->runFrame();
+    ckPassFail(game->cpu.memory[0x14] == 0x10, "Donkey Kong did not read start");
+    game->controllers[0].setButtons(Controller::A | Controller::RIGHT);
+    game->runFrame();
+    game->runFrame();
+    ckPassFail(game->cpu.memory[0x14] == 0x81, "Donkey Kong did not read A and right");
+}
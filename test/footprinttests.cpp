@@ -0,0 +1,51 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Mapper.h"
+#include "RomImage.h"
+
+#include <memory>
+#include <vector>
+
+void Tests::footprintTest() {
+    std::cout << "\n--- Running Footprint Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    // Every nes of a rom shares one image of it, however the file was named, until the last one lets go
+    std::weak_ptr<const RomImage> image;
+    {
+        std::shared_ptr<NES> nes = createNES(donkeyKong), other = createNES("../rsc/roms/../roms/Donkey Kong (World) (Rev A).nes");
+        std::shared_ptr<NES> nestest = createNES("../rsc/tests/nestest.nes");
+        ckPassFail(nes->gamepak.rom == other->gamepak.rom, "Two nes of one rom have their own rom image");
+        ckPassFail(nes->gamepak.mapper->prgBanks == other->gamepak.mapper->prgBanks, "Two nes of one rom map different prg");
+        ckPassFail(nes->gamepak.rom != nestest->gamepak.rom, "Two roms share a rom image");
+        image = nes->gamepak.rom;
+    }
+    ckPassFail(image.expired(), "Rom image outlived every nes of it");
+
+    // Only the pages a nes wrote to are its own, and none are right after cloning
+    std::shared_ptr<NES> nes = createNES(donkeyKong);
+    const size_t fresh = nes->footprint();
+    runFrames(*nes, 120);
+    const size_t running = nes->footprint();
+    ckPassFail(running > fresh && running - fresh == nes->cpu.memory.ownedBytes() + nes->ppu.ownedBytes(), "Written pages aren't counted");
+    std::shared_ptr<NES> clone = nes->clone();
+    const size_t cloned = clone->footprint();
+    ckPassFail(cloned == sizeof(NES) + clone->gamepak.mapper->ownedBytes() && nes->footprint() == cloned,
+               "A clone holds pages of its own before writing to any");
+    clone->runFrame();
+    ckPassFail(clone->footprint() > cloned, "Pages a clone wrote to aren't counted");
+
+    // Packing many nes of one rom, each holds its own state and all of them one rom
+    std::vector<std::shared_ptr<NES>> batch;
+    size_t total = 0;
+    for (size_t index = 0; index != 64; ++index) {
+        batch.push_back(createNES(donkeyKong));
+        runFrames(*batch.back(), 5);
+        total += batch.back()->footprint();
+    }
+    ckPassFail(batch.front()->gamepak.rom.use_count() > static_cast<long>(batch.size()), "Packed nes don't share their rom");
+    const RomImage& rom = *batch.front()->gamepak.rom;
+    std::cout << "NES is " << sizeof(NES) << " bytes, " << sizeof(NES::screen) << " of them the screen, " << sizeof(Cpu6502)
+              << " the cpu and " << sizeof(Ppu) << " the ppu\n"
+              << "Donkey Kong holds " << running << " bytes after 120 frames, " << total / batch.size() << " on average over "
+              << batch.size() << " after 5, and they share " << rom.prgSize + rom.chrSize << " bytes of rom\n";
+}
@@ -0,0 +1,289 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "LockstepCpu.h"
+#include "RomImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+template<typename F>
+static bool throws(F f) {
+    try {
+        f();
+    }
+    catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+// A game-like loop for the lanes to diverge on: the input byte at $F0 and a seed at $F1 pick which
+// bits get summed, which state of a jump table runs, how long its loops are and when it BRKs
+// Every lane copies a routine to $0300 with its seed in it, so the lanes also run code in ram that differs
+static const std::vector<uint8_t> workload = {
+    0xA2, 0xFF,          // 8000 LDX #$FF
+    0x9A,                // 8002 TXS
+    0xA9, 0x00,          // 8003 LDA #$00
+    0x85, 0x00,          // 8005 STA $00
+    0xA9, 0x02,          // 8007 LDA #$02
+    0x85, 0x01,          // 8009 STA $01
+    0xA9, 0x50,          // 800B LDA #$50
+    0x85, 0x0C,          // 800D STA $0C
+    0xA9, 0x02,          // 800F LDA #$02
+    0x85, 0x0D,          // 8011 STA $0D
+    0xA2, 0x04,          // 8013 LDX #$04
+    0xBD, 0xD8, 0x80,    // 8015 LDA routine,X (copy)
+    0x9D, 0x00, 0x03,    // 8018 STA $0300,X
+    0xCA,                // 801B DEX
+    0x10, 0xF7,          // 801C BPL copy
+    0xA5, 0xF1,          // 801E LDA $F1
+    0x8D, 0x01, 0x03,    // 8020 STA $0301
+    0x20, 0x00, 0x03,    // 8023 JSR $0300 (main)
+    0x85, 0x10,          // 8026 STA $10
+    0xA0, 0x07,          // 8028 LDY #$07
+    0x46, 0x10,          // 802A LSR $10 (bits)
+    0x90, 0x0C,          // 802C BCC skip
+    0x18,                // 802E CLC
+    0xB1, 0x00,          // 802F LDA ($00),Y
+    0x79, 0xDD, 0x80,    // 8031 ADC table,Y
+    0x91, 0x00,          // 8034 STA ($00),Y
+    0x90, 0x02,          // 8036 BCC skip
+    0xE6, 0x21,          // 8038 INC $21
+    0x88,                // 803A DEY (skip)
+    0x10, 0xED,          // 803B BPL bits
+    0xA5, 0x20,          // 803D LDA $20
+    0x38,                // 803F SEC
+    0xE5, 0xF0,          // 8040 SBC $F0
+    0x85, 0x20,          // 8042 STA $20
+    0xA5, 0x21,          // 8044 LDA $21
+    0xE9, 0x00,          // 8046 SBC #$00
+    0x85, 0x21,          // 8048 STA $21
+    0xA5, 0x40,          // 804A LDA $40
+    0x29, 0x03,          // 804C AND #$03
+    0x0A,                // 804E ASL A
+    0xAA,                // 804F TAX
+    0xBD, 0xE5, 0x80,    // 8050 LDA jumps,X
+    0x85, 0x02,          // 8053 STA $02
+    0xBD, 0xE6, 0x80,    // 8055 LDA jumps+1,X
+    0x85, 0x03,          // 8058 STA $03
+    0x6C, 0x02, 0x00,    // 805A JMP ($0002)
+    0xA2, 0x1F,          // 805D LDX #$1F (state0)
+    0xBD, 0x00, 0x02,    // 805F LDA $0200,X (loop0)
+    0x2A,                // 8062 ROL A
+    0x45, 0xF0,          // 8063 EOR $F0
+    0x9D, 0x00, 0x02,    // 8065 STA $0200,X
+    0xCA,                // 8068 DEX
+    0xD0, 0xF4,          // 8069 BNE loop0
+    0x4C, 0xBA, 0x80,    // 806B JMP done
+    0xA5, 0xF0,          // 806E LDA $F0 (state1)
+    0x24, 0x20,          // 8070 BIT $20
+    0x70, 0x09,          // 8072 BVS over1
+    0x30, 0x0F,          // 8074 BMI minus1
+    0x05, 0x21,          // 8076 ORA $21
+    0x48,                // 8078 PHA
+    0x68,                // 8079 PLA
+    0x4C, 0xBA, 0x80,    // 807A JMP done
+    0x08,                // 807D PHP (over1)
+    0x28,                // 807E PLP
+    0x6E, 0x10, 0x02,    // 807F ROR $0210
+    0x4C, 0xBA, 0x80,    // 8082 JMP done
+    0xA4, 0xF0,          // 8085 LDY $F0 (minus1)
+    0xB9, 0x80, 0x02,    // 8087 LDA $0280,Y
+    0xA8,                // 808A TAY
+    0xC8,                // 808B INY
+    0x8C, 0x11, 0x02,    // 808C STY $0211
+    0x4C, 0xBA, 0x80,    // 808F JMP done
+    0xA5, 0xF0,          // 8092 LDA $F0 (state2)
+    0x29, 0x0F,          // 8094 AND #$0F
+    0xAA,                // 8096 TAX
+    0xF6, 0x80,          // 8097 INC $80,X
+    0xB5, 0x80,          // 8099 LDA $80,X
+    0xC9, 0x80,          // 809B CMP #$80
+    0xB0, 0x05,          // 809D BCS big2
+    0xC6, 0x50,          // 809F DEC $50
+    0x4C, 0xBA, 0x80,    // 80A1 JMP done
+    0xA0, 0x10,          // 80A4 LDY #$10 (big2)
+    0xC4, 0x50,          // 80A6 CPY $50
+    0xF0, 0x10,          // 80A8 BEQ done
+    0x84, 0x50,          // 80AA STY $50
+    0x4C, 0xBA, 0x80,    // 80AC JMP done
+    0x00,                // 80AF BRK (state3)
+    0xA5, 0x41,          // 80B0 LDA $41
+    0xFD, 0x40, 0x02,    // 80B2 SBC $0240,X
+    0x81, 0x06,          // 80B5 STA ($06,X)
+    0x4C, 0xBA, 0x80,    // 80B7 JMP done
+    0xE6, 0x30,          // 80BA INC $30 (done)
+    0xA5, 0x30,          // 80BC LDA $30
+    0x45, 0xF0,          // 80BE EOR $F0
+    0x29, 0x07,          // 80C0 AND #$07
+    0xD0, 0x02,          // 80C2 BNE main2
+    0xE6, 0x40,          // 80C4 INC $40
+    0x4C, 0x23, 0x80,    // 80C6 JMP main (main2)
+    0x48,                // 80C9 PHA (irq)
+    0x8A,                // 80CA TXA
+    0x48,                // 80CB PHA
+    0xBA,                // 80CC TSX
+    0xA5, 0xF0,          // 80CD LDA $F0
+    0x9D, 0x20, 0x02,    // 80CF STA $0220,X
+    0xE6, 0x41,          // 80D2 INC $41
+    0x68,                // 80D4 PLA
+    0xAA,                // 80D5 TAX
+    0x68,                // 80D6 PLA
+    0x40,                // 80D7 RTI
+    0xA9, 0x00, 0x45, 0xF0, 0x60, // 80D8 routine: LDA #seed, EOR $F0, RTS
+    0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F, 0xFF, // 80DD table
+    0x5D, 0x80, 0x6E, 0x80, 0x92, 0x80, 0xAF, 0x80  // 80E5 jumps: state0-3
+};
+
+// 32kb of prg with the workload at $8000, its reset vector and BRK into irq
+static std::vector<uint8_t> workloadPrg() {
+    std::vector<uint8_t> prg(memsize::KB32, 0xEA);
+    std::copy(workload.cbegin(), workload.cend(), prg.begin());
+    const uint8_t vectors[] = {0xC9, 0x80, 0x00, 0x80, 0xC9, 0x80};
+    std::copy(std::begin(vectors), std::end(vectors), prg.end() - 6);
+    return prg;
+}
+
+// The movie, lanes press their own buttons unless they all share the first lane's
+static uint8_t inputAt(const size_t& lane, const int& frame, const bool& shared) {
+    const size_t player = shared ? 0 : lane;
+    return static_cast<uint8_t>(((frame / 8 + player) % 4 == 0 ? Controller::LEFT : 0) | (static_cast<size_t>(frame) % 7 == player % 7 ? Controller::A : 0) |
+                                (frame % 30 < 3 ? Controller::START : 0));
+}
+
+static uint8_t seedOf(const size_t& lane, const bool& shared) {
+    return static_cast<uint8_t>((shared ? 0 : lane) * 37 + 11);
+}
+
+static std::vector<std::unique_ptr<Cpu6502>> scalarCpus(const std::vector<uint8_t>& prg, const size_t& lanes, const bool& shared) {
+    std::vector<std::unique_ptr<Cpu6502>> cpus;
+    for (size_t lane = 0; lane != lanes; ++lane) {
+        cpus.emplace_back(new Cpu6502());
+        for (size_t adr = 0; adr != prg.size(); ++adr)
+            cpus.back()->memory.write(static_cast<uint16_t>(0x8000 + adr), prg[adr]);
+        cpus.back()->signalRESET();
+        cpus.back()->memory.write(0xF1, seedOf(lane, shared));
+    }
+    return cpus;
+}
+
+static std::unique_ptr<LockstepCpu> lockstepCpu(const std::vector<uint8_t>& prg, const size_t& lanes, const bool& shared) {
+    std::unique_ptr<LockstepCpu> cpu(new LockstepCpu(prg.data(), prg.size(), lanes));
+    cpu->reset();
+    for (size_t lane = 0; lane != lanes; ++lane)
+        cpu->write(lane, 0xF1, seedOf(lane, shared));
+    return cpu;
+}
+
+static const uint64_t frameCycles = 29780;
+
+static void runScalar(std::vector<std::unique_ptr<Cpu6502>>& cpus, const int& frame, const bool& shared) {
+    for (size_t lane = 0; lane != cpus.size(); ++lane) {
+        Cpu6502& cpu = *cpus[lane];
+        cpu.memory.write(0xF0, inputAt(lane, frame, shared));
+        const uint64_t target = cpu.cycles() + frameCycles;
+        while (cpu.cycles() < target)
+            cpu.runCycle();
+    }
+}
+
+static void runLockstep(LockstepCpu& cpu, const int& frame, const bool& shared) {
+    for (size_t lane = 0; lane != cpu.lanes(); ++lane)
+        cpu.write(lane, 0xF0, inputAt(lane, frame, shared));
+    cpu.runCycles(frameCycles);
+}
+
+void Tests::lockstepCpuTest() {
+    std::cout << "\n--- Running Lockstep Cpu Tests ---\n";
+    std::cout << "Lockstep cpu uses " << (LockstepCpu::avx2() ? "avx2" : "the baseline simd") << '\n';
+    // Registers, cycles and the whole work ram of a lane against a cpu of its own
+    auto sameAs = [](const LockstepCpu& lockstep, const size_t& lane, const Cpu6502& cpu) {
+        const LockstepCpu::Registers regs = lockstep.registers(lane);
+        if (regs.a != cpu.a || regs.x != cpu.x || regs.y != cpu.y || regs.sp != cpu.sp || regs.pc != cpu.pc ||
+            regs.status != static_cast<uint8_t>(cpu.status) || regs.cycles != cpu.cycles())
+            return false;
+        for (uint16_t adr = 0; adr != Memory::RAM_SIZE; ++adr) {
+            if (lockstep.read(lane, adr) != cpu.memory.read(adr))
+                return false;
+        }
+        return true;
+    };
+
+    // Nestest with every lane at once, against a cpu alone, up to where the illegal opcodes start
+    // The lanes aren't a whole block, so the last block has lanes that never run
+    std::shared_ptr<NES> nes = std::make_shared<NES>();
+    nes->init();
+    nes->load("../rsc/tests/nestest.nes");
+    Cpu6502& cpu = nes->cpu;
+    cpu.pc = 0xC000;
+    cpu.sp = 0xFD;
+    cpu.a = cpu.x = cpu.y = 0;
+    cpu.status.reset();
+    cpu.cycleCount = 7;
+    cpu.runCycle(5000);
+    const size_t nesTestLanes = 40;
+    LockstepCpu nesTest(*RomImage::open("../rsc/tests/nestest.nes"), nesTestLanes);
+    LockstepCpu::Registers start;
+    start.pc = 0xC000;
+    start.sp = 0xFD;
+    start.status = Inner::Status();
+    start.cycles = 7;
+    for (size_t lane = 0; lane != nesTestLanes; ++lane)
+        nesTest.setRegisters(lane, start);
+    nesTest.runCycles(cpu.cycles() - 7);
+    for (size_t lane = 0; lane != nesTestLanes; ++lane)
+        ckPassFail(sameAs(nesTest, lane, cpu), "Lane " + std::to_string(lane) + " differs from nestest run on its own");
+    ckPassFail(nesTest.instructions() == 5000 * nesTestLanes && nesTest.groups() == 5000, "Lanes of nestest did not run as one group");
+
+    // Lanes with their own seed and input split apart and meet again, each must still run like its own cpu
+    const std::vector<uint8_t> prg = workloadPrg();
+    const size_t lanes = 64;
+    std::vector<std::unique_ptr<Cpu6502>> cpus = scalarCpus(prg, lanes, false);
+    std::unique_ptr<LockstepCpu> lockstep = lockstepCpu(prg, lanes, false);
+    bool same = true;
+    for (int frame = 0; frame != 30; ++frame) {
+        runScalar(cpus, frame, false);
+        runLockstep(*lockstep, frame, false);
+        for (size_t lane = 0; lane != lanes; ++lane)
+            same &= sameAs(*lockstep, lane, *cpus[lane]);
+    }
+    ckPassFail(same, "Lockstep lanes differ from running each cpu on its own");
+    ckPassFail(lockstep->read(0, 0x0200) != lockstep->read(1, 0x0200) || lockstep->read(0, 0x20) != lockstep->read(1, 0x20), "Lanes given different input ran the same");
+    ckPassFail(lockstep->groups() < lockstep->instructions() / 2, "Lanes hardly ever ran together");
+
+    // Bad roms and opcodes throw like Cpu6502 does
+    ckPassFail(throws([&]() { LockstepCpu(prg.data(), 1000, 1); }), "Made a lockstep cpu from a rom of 1000 bytes");
+    ckPassFail(throws([&]() { LockstepCpu(prg.data(), prg.size(), 0); }), "Made a lockstep cpu without lanes");
+    LockstepCpu illegal(prg.data(), prg.size(), 2);
+    LockstepCpu::Registers atIllegal;
+    atIllegal.pc = 0x80DE; // 0x03 of the table
+    illegal.setRegisters(1, atIllegal);
+    ckPassFail(throws([&]() { illegal.runCycles(10); }), "Ran an illegal opcode");
+
+    // Aggregate instructions per second of scalar cpus against the lockstep lanes, the same movie and rom
+    const int frames = 60;
+    for (const bool shared : {true, false}) {
+        cpus = scalarCpus(prg, lanes, shared);
+        auto begin = std::chrono::steady_clock::now();
+        for (int frame = 0; frame != frames; ++frame)
+            runScalar(cpus, frame, shared);
+        const double scalarTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        uint64_t scalarInstructions = 0;
+        for (const std::unique_ptr<Cpu6502>& scalar : cpus)
+            scalarInstructions += scalar->instructions();
+
+        lockstep = lockstepCpu(prg, lanes, shared);
+        begin = std::chrono::steady_clock::now();
+        for (int frame = 0; frame != frames; ++frame)
+            runLockstep(*lockstep, frame, shared);
+        const double lockstepTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        ckPassErr(lockstep->instructions() == scalarInstructions, "Lockstep ran a different amount of instructions");
+
+        std::cout << lanes << " cpus, " << (shared ? "one movie" : "a movie each") << ": scalar "
+                  << scalarInstructions / scalarTime / 1e6 << " M instr/s, lockstep " << lockstep->instructions() / lockstepTime / 1e6
+                  << " M instr/s (" << scalarTime / lockstepTime << "x), " << static_cast<double>(lockstep->instructions()) / lockstep->groups()
+                  << " lanes per group\n";
+    }
+}
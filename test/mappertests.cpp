@@ -0,0 +1,254 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Mapper.h"
+#include "RomImage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+// Writes an iNES file where every 8KB of prg rom and 1KB of chr rom is filled with its bank number
+// Code is put at 0xE000 of the last bank, which the reset vector points to and the irq vector to 0xE01A
+static std::shared_ptr<NES> createMapperNES(const uint8_t& mapperNum, const uint8_t& prgSz, const uint8_t& chrSz, const bool& trainer,
+                                            const std::vector<uint8_t>& code = {}) {
+    const std::string fname = "mappertest.nes";
+    std::vector<uint8_t> file = {'N', 'E', 'S', 0x1A, prgSz, chrSz,
+                                 static_cast<uint8_t>((mapperNum << 4) | (trainer ? 0x04 : 0)),
+                                 static_cast<uint8_t>(mapperNum & 0xF0), 0, 0, 0, 0, 0, 0, 0, 0};
+    if (trainer)
+        file.insert(file.end(), 512, 0xEE);
+    for (unsigned i = 0; i != prgSz * 2u; ++i)
+        file.insert(file.end(), memsize::KB8, static_cast<uint8_t>(i));
+    if (!code.empty()) {
+        const size_t lastBank = file.size() - memsize::KB8;
+        std::copy(code.begin(), code.end(), file.begin() + static_cast<long>(lastBank));
+        const std::vector<uint8_t> vectors = {0x1A, 0xE0, 0x00, 0xE0, 0x1A, 0xE0};
+        std::copy(vectors.begin(), vectors.end(), file.end() - 6);
+    }
+    for (unsigned i = 0; i != chrSz * 8u; ++i)
+        file.insert(file.end(), 0x400, static_cast<uint8_t>(i));
+    std::ofstream(fname, std::ios_base::binary).write(reinterpret_cast<const char*>(file.data()), static_cast<long>(file.size()));
+
+    std::shared_ptr<NES> nes = std::make_shared<NES>();
+    nes->init();
+    try {
+        nes->load(fname);
+    }
+    catch (...) {
+        std::remove(fname.c_str());
+        throw;
+    }
+    std::remove(fname.c_str());
+    return nes;
+}
+
+// Writes a value into a mmc1 register a bit at a time
+static void mmc1Write(Memory& memory, const uint16_t& adr, const uint8_t& val) {
+    for (int i = 0; i != 5; ++i)
+        memory.write(adr, static_cast<uint8_t>(val >> i));
+}
+
+// Mmc3 irq every 21 scanlines, the handler counts irqs at 0x10
+static std::vector<uint8_t> mmc3IrqProgram(const uint8_t& ctrl) {
+    return {0x78, 0xA9, ctrl, 0x8D, 0x00, 0x20, // sei, ppuctrl = ctrl
+            0xA9, 0x08, 0x8D, 0x01, 0x20,       // show the background
+            0xA9, 0x14, 0x8D, 0x00, 0xC0,       // irq every 21 scanlines
+            0x8D, 0x01, 0xC0, 0x8D, 0x01, 0xE0, // reload and enable
+            0x58, 0x4C, 0x17, 0xE0,             // cli, spin
+            0x8D, 0x00, 0xE0, 0x8D, 0x01, 0xE0, // 0xE01A: acknowledge
+            0xE6, 0x10, 0x40};                  // count, rti
+}
+
+void Tests::mapperTest() {
+    std::cout << "\n--- Running Mapper Tests ---\n";
+    {   // NROM-128 is seen twice, the trainer must be skipped
+        auto nes = createMapperNES(0, 1, 1, true);
+        Memory& mem = nes->cpu.memory;
+        ckPassErr(mem.read(0x8000) == 0 && mem.read(0xA000) == 1 && mem.read(0xC000) == 0 && mem.read(0xE000) == 1, "NROM-128 is not mirrored");
+        ckPassErr(nes->ppu.vRamRead(0x1C00) == 7, "NROM chr rom is not mapped");
+        nes->ppu.vRamWrite(0x0000, 0x55);
+        ckPassErr(nes->ppu.vRamRead(0x0000) == 0, "NROM chr rom was written to");
+        // Horizontal mirroring, and palettes mirrored every 0x20 with the sprite backdrops mirroring the background's
+        nes->ppu.vRamWrite(0x2401, 0x11);
+        nes->ppu.vRamWrite(0x3F10, 0x22);
+        nes->ppu.vRamWrite(0x3F35, 0x33);
+        ckPassErr(nes->ppu.vRamRead(0x2001) == 0x11 && nes->ppu.vRamRead(0x3001) == 0x11 && nes->ppu.vRamRead(0x2801) == 0, "Horizontal mirroring failed");
+        ckPassErr(nes->ppu.vRamRead(0x3F00) == 0x22 && nes->ppu.vRamRead(0x3F15) == 0x33 && nes->ppu.vRamRead(0x7F00) == 0x22, "Palette mirroring failed");
+    }
+    {   // UxROM, switchable 16KB at 0x8000 and the last bank fixed, chr ram
+        auto nes = createMapperNES(2, 8, 0, false);
+        Memory& mem = nes->cpu.memory;
+        ckPassErr(mem.read(0x8000) == 0 && mem.read(0xC000) == 14 && mem.read(0xFFFF) == 15, "UxROM power up banks are wrong");
+        mem.write(0x8000, 5);
+        ckPassErr(mem.read(0x8000) == 10 && mem.read(0xBFFF) == 11 && mem.read(0xC000) == 14, "UxROM bank switch failed");
+        nes->ppu.vRamWrite(0x1234, 0x55);
+        ckPassErr(nes->ppu.vRamRead(0x1234) == 0x55, "UxROM chr ram cannot be written to");
+        // The decoded tile must see the write
+        ckPassErr(nes->ppu.getPatternTile(0x1230)[4] == Ppu::createLine(0x55, 0), "Tile cache was not invalidated by a chr ram write");
+    }
+    {   // CNROM, 8KB chr switching
+        auto nes = createMapperNES(3, 2, 4, false);
+        ckPassErr(nes->ppu.getPatternTile(0x0000)[0] == Ppu::createLine(0, 0), "Tile cache is wrong");
+        nes->cpu.memory.write(0xFFFF, 2);
+        ckPassErr(nes->ppu.getPatternTile(0x0000)[0] == Ppu::createLine(16, 16), "Tile cache was not invalidated by a bank switch");
+        ckPassErr(nes->ppu.vRamRead(0x0000) == 16 && nes->ppu.vRamRead(0x1C00) == 23, "CNROM chr bank switch failed");
+    }
+    {   // AxROM, 32KB switching and single screen mirroring
+        auto nes = createMapperNES(7, 8, 0, false);
+        nes->cpu.memory.write(0x8000, 0x12);
+        ckPassErr(nes->cpu.memory.read(0x8000) == 8 && nes->cpu.memory.read(0xE000) == 11, "AxROM prg bank switch failed");
+        ckPassErr(nes->gamepak.mirror == GamePak::SINGLE_UPPER, "AxROM did not set single screen mirroring");
+        nes->ppu.vRamWrite(0x2000, 0x42);
+        ckPassErr(nes->ppu.vRamRead(0x2C00) == 0x42, "Single screen nametables are not mirrored");
+    }
+    {   // MMC1, serial writes into its registers
+        auto nes = createMapperNES(1, 8, 4, false);
+        Memory& mem = nes->cpu.memory;
+        ckPassErr(mem.read(0xC000) == 14, "MMC1 does not power up with the last bank fixed");
+        mmc1Write(mem, 0xE000, 3);
+        ckPassErr(mem.read(0x8000) == 6 && mem.read(0xC000) == 14, "MMC1 prg bank switch failed");
+        mem.write(0x8000, 1); // partial write is discarded by a reset
+        mem.write(0x8000, 0x80);
+        mmc1Write(mem, 0x8000, 0x13); // 4KB chr, horizontal, 32KB prg
+        ckPassErr(nes->gamepak.mirror == GamePak::HORIZONTAL, "MMC1 mirroring control failed");
+        ckPassErr(mem.read(0x8000) == 4 && mem.read(0xE000) == 7, "MMC1 32KB prg mode failed");
+        mmc1Write(mem, 0xA000, 5);
+        mmc1Write(mem, 0xC000, 2);
+        ckPassErr(nes->ppu.vRamRead(0x0000) == 20 && nes->ppu.vRamRead(0x1000) == 8, "MMC1 4KB chr banks failed");
+        // Prg ram stays plain memory
+        mem.write(0x6000, 0x99);
+        ckPassErr(mem.read(0x6000) == 0x99, "Prg ram cannot be written to");
+    }
+    {   // MMC3, 8KB prg and 1KB/2KB chr banks that can be swapped around
+        auto nes = createMapperNES(4, 8, 8, false);
+        Memory& mem = nes->cpu.memory;
+        ckPassErr(mem.read(0xC000) == 14 && mem.read(0xE000) == 15, "MMC3 power up banks are wrong");
+        mem.write(0x8000, 6);
+        mem.write(0x8001, 3);
+        mem.write(0x8000, 7);
+        mem.write(0x8001, 4);
+        ckPassErr(mem.read(0x8000) == 3 && mem.read(0xA000) == 4 && mem.read(0xC000) == 14, "MMC3 prg bank switch failed");
+        mem.write(0x8000, 0x40 | 2);
+        mem.write(0x8001, 9);
+        ckPassErr(mem.read(0x8000) == 14 && mem.read(0xC000) == 3, "MMC3 prg mode failed");
+        ckPassErr(nes->ppu.vRamRead(0x1000) == 9, "MMC3 1KB chr bank switch failed");
+        mem.write(0x8000, 0x80);
+        mem.write(0x8001, 13); // low bit is ignored for the 2KB banks
+        ckPassErr(nes->ppu.vRamRead(0x1000) == 12 && nes->ppu.vRamRead(0x1400) == 13 && nes->ppu.vRamRead(0x0000) == 9,
+                  "MMC3 chr inversion failed");
+        mem.write(0xA000, 1);
+        ckPassErr(nes->gamepak.mirror == GamePak::HORIZONTAL, "MMC3 mirroring failed");
+    }
+    {   // MMC3 scanline irq, the handler counts irqs at 0x10
+        // The predicted irq must be taken at the same instruction as when the ppu is caught up every instruction,
+        // and at the same scanlines as when watching A12 (8x16 sprites)
+        auto predicted = createMapperNES(4, 2, 1, false, mmc3IrqProgram(0x08));
+        auto interleaved = createMapperNES(4, 2, 1, false, mmc3IrqProgram(0x08));
+        auto tracked = createMapperNES(4, 2, 1, false, mmc3IrqProgram(0x20));
+        interleaved->lazyPpu = false;
+        for (auto& nes : {predicted, interleaved, tracked})
+            nes->powerUp();
+        for (int frame = 0; frame != 20; ++frame) {
+            predicted->runFrame();
+            interleaved->runFrame();
+            tracked->runFrame();
+            const std::string at = " at frame " + std::to_string(frame);
+            ckPassFail(predicted->cpu.cycleCount == interleaved->cpu.cycleCount && predicted->cpu.pc == interleaved->cpu.pc
+                       && predicted->cpu.memory.read(0x10) == interleaved->cpu.memory.read(0x10), "Predicted irq was taken late" + at);
+            ckPassFail(predicted->cpu.memory.read(0x10) == tracked->cpu.memory.read(0x10), "A12 tracking irq count differs" + at);
+        }
+        ckPassErr(predicted->ppu.scanlineIrqDot == 260 && tracked->ppu.a12Tracking, "MMC3 irq clocking mode is wrong");
+        // 241 clocks per frame, an irq every 21 clocks
+        const int irqs = predicted->cpu.memory.read(0x10);
+        ckPassErr(std::abs(irqs - 20 * 241 / 21) <= 2, "MMC3 irq count is wrong " + std::to_string(irqs));
+    }
+    {   // Save states must bring back the banks, the chr ram and the irq counter mid frame
+        auto nes = createMapperNES(4, 2, 1, false, mmc3IrqProgram(0x08));
+        nes->powerUp();
+        for (int frame = 0; frame != 7; ++frame)
+            nes->runFrame();
+        nes->runCycles(10000);
+        const std::vector<uint8_t> state = nes->saveState();
+        auto runAhead = [](std::shared_ptr<NES> nes) {
+            for (int frame = 0; frame != 8; ++frame)
+                nes->runFrame();
+            return std::make_tuple(nes->cpu.cycleCount, nes->cpu.pc, nes->cpu.memory.read(0x10), nes->screen);
+        };
+        const auto expected = runAhead(nes);
+        nes->loadState(state);
+        ckPassFail(runAhead(nes) == expected, "MMC3 irqs differ after loading a state");
+
+        auto chrRam = createMapperNES(2, 8, 0, false);
+        chrRam->powerUp();
+        Memory& mem = chrRam->cpu.memory;
+        auto fillChr = [&mem](const uint8_t& val) {
+            mem.write(0x2006, 0x10);
+            mem.write(0x2006, 0x00);
+            for (int i = 0; i != 16; ++i)
+                mem.write(0x2007, val);
+        };
+        mem.write(0x8000, 3);
+        fillChr(0xAB);
+        const std::vector<uint8_t> chrState = chrRam->saveState();
+        mem.write(0x8000, 5);
+        fillChr(0xCD);
+        ckPassFail(chrRam->ppu.getPatternTile(0x1000)[0] == Ppu::createLine(0xCD, 0xCD), "Chr ram was not written");
+        chrRam->loadState(chrState);
+        ckPassErr(mem.read(0x8000) == 6, "UxROM bank was not restored");
+        ckPassErr(chrRam->ppu.vRamRead(0x1000) == 0xAB && chrRam->ppu.getPatternTile(0x1000)[0] == Ppu::createLine(0xAB, 0xAB),
+                  "Chr ram or its cached tiles were not restored");
+    }
+    {   // Clones have their own mapper registers, irq counter and chr ram
+        auto nes = createMapperNES(4, 2, 1, false, mmc3IrqProgram(0x08));
+        nes->powerUp();
+        for (int frame = 0; frame != 7; ++frame)
+            nes->runFrame();
+        nes->runCycles(10000);
+        std::shared_ptr<NES> clone = nes->clone();
+        auto runAhead = [](std::shared_ptr<NES> nes) {
+            for (int frame = 0; frame != 8; ++frame)
+                nes->runFrame();
+            return std::make_tuple(nes->cpu.cycleCount, nes->cpu.pc, nes->cpu.memory.read(0x10), nes->screen);
+        };
+        ckPassFail(runAhead(clone) == runAhead(nes), "MMC3 irqs differ in a clone");
+
+        auto chrRam = createMapperNES(2, 8, 0, false);
+        chrRam->powerUp();
+        chrRam->ppu.vRamWrite(0x1000, 0xAB);
+        clone = chrRam->clone();
+        clone->cpu.memory.write(0x8000, 5);
+        clone->ppu.vRamWrite(0x1000, 0xCD);
+        ckPassErr(clone->ppu.vRamRead(0x1000) == 0xCD && clone->ppu.getPatternTile(0x1000)[0] == Ppu::createLine(0xCD, 0),
+                  "Clone did not write its chr ram");
+        ckPassErr(chrRam->ppu.vRamRead(0x1000) == 0xAB && chrRam->ppu.getPatternTile(0x1000)[0] == Ppu::createLine(0xAB, 0),
+                  "Clone wrote into the chr ram it was cloned from");
+        ckPassErr(chrRam->cpu.memory.read(0x8000) == 0 && clone->cpu.memory.read(0x8000) == 10, "Clone switched the bank of the nes it was cloned from");
+    }
+    {   // Files smaller than their header says must be rejected before anything is mapped
+        const uint8_t header[16] = {'N', 'E', 'S', 0x1A, 2, 1, 0x04};
+        bool thrown = false;
+        try {
+            RomImage::parseHeader(header, 16 + 512 + 2 * memsize::KB16 + memsize::KB8 - 1);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        ckPassErr(thrown, "Truncated rom was accepted");
+        RomImage::Header parsed = RomImage::parseHeader(header, 16 + 512 + 2 * memsize::KB16 + memsize::KB8);
+        ckPassErr(parsed.trainer && parsed.prgBanks == 2 && parsed.chrBanks == 1, "Header was parsed wrong");
+    }
+    {   // Unsupported mapper numbers, including the high nibble in flags 7, must throw
+        bool thrown = false;
+        try {
+            createMapperNES(0x42, 1, 1, false);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        ckPassErr(thrown, "Unsupported mapper was loaded");
+    }
+}
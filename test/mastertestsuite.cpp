@@ -6,6 +6,8 @@ namespace po = boost::program_options;
 
 #define UNUSED(x) (void)(x)
 
+bool benchTargets = false;
+
 test_suite* createOpcodeTestSuite() {
     test_suite* opTests = BOOST_TEST_SUITE("opcode_test_suite");
     opTests->add(BOOST_TEST_CASE( &Tests::cpuMessage ));
@@ -22,6 +24,8 @@ test_suite* createOpcodeTestSuite() {
 test_suite* createCpuDiagTestSuite() {
     test_suite* cpuDiagTest = BOOST_TEST_SUITE("cpu diagnostic test");
     cpuDiagTest->add(BOOST_TEST_CASE( &Tests::nesCpuTest ));
+    cpuDiagTest->add(BOOST_TEST_CASE( &Tests::nesCpuTableTest ));
+    cpuDiagTest->add(BOOST_TEST_CASE( &Tests::nesTimingTest ));
     return cpuDiagTest;
 }
 
@@ -31,6 +35,71 @@ test_suite* createPpuTestSuite() {
     return ppuTest;
 }
 
+test_suite* createSchedulerTestSuite() {
+    test_suite* schedulerTest = BOOST_TEST_SUITE("scheduler tests");
+    schedulerTest->add(BOOST_TEST_CASE(&Tests::schedulerTest));
+    return schedulerTest;
+}
+
+test_suite* createRenderTestSuite() {
+    test_suite* renderTest = BOOST_TEST_SUITE("render tests");
+    renderTest->add(BOOST_TEST_CASE(&Tests::scanlineRendererTest));
+    renderTest->add(BOOST_TEST_CASE(&Tests::frameBufferTest));
+    return renderTest;
+}
+
+test_suite* createMapperTestSuite() {
+    test_suite* mapperTest = BOOST_TEST_SUITE("mapper tests");
+    mapperTest->add(BOOST_TEST_CASE(&Tests::mapperTest));
+    return mapperTest;
+}
+
+test_suite* createControllerTestSuite() {
+    test_suite* controllerTest = BOOST_TEST_SUITE("controller tests");
+    controllerTest->add(BOOST_TEST_CASE(&Tests::controllerTest));
+    return controllerTest;
+}
+
+test_suite* createSaveStateTestSuite() {
+    test_suite* saveStateTest = BOOST_TEST_SUITE("save state tests");
+    saveStateTest->add(BOOST_TEST_CASE(&Tests::saveStateTest));
+    saveStateTest->add(BOOST_TEST_CASE(&Tests::rewindTest));
+    saveStateTest->add(BOOST_TEST_CASE(&Tests::cloneTest));
+    saveStateTest->add(BOOST_TEST_CASE(&Tests::runAheadTest));
+    return saveStateTest;
+}
+
+test_suite* createMovieTestSuite() {
+    test_suite* movieTest = BOOST_TEST_SUITE("movie tests");
+    movieTest->add(BOOST_TEST_CASE(&Tests::movieTest));
+    return movieTest;
+}
+
+test_suite* createVecNESTestSuite() {
+    test_suite* vecNESTest = BOOST_TEST_SUITE("vecnes tests");
+    vecNESTest->add(BOOST_TEST_CASE(&Tests::vecNESTest));
+    return vecNESTest;
+}
+
+test_suite* createLockstepTestSuite() {
+    test_suite* lockstepTest = BOOST_TEST_SUITE("lockstep tests");
+    lockstepTest->add(BOOST_TEST_CASE(&Tests::lockstepCpuTest));
+    return lockstepTest;
+}
+
+test_suite* createFootprintTestSuite() {
+    test_suite* footprintTest = BOOST_TEST_SUITE("footprint tests");
+    footprintTest->add(BOOST_TEST_CASE(&Tests::footprintTest));
+    return footprintTest;
+}
+
+test_suite* createThreadTestSuite() {
+    test_suite* threadTest = BOOST_TEST_SUITE("thread tests");
+    threadTest->add(BOOST_TEST_CASE(&Tests::emulationThreadTest));
+    threadTest->add(BOOST_TEST_CASE(&Tests::framePacerTest));
+    return threadTest;
+}
+
 
 test_suite* init_unit_test_suite(int argc, char* argv[]) {
     po::options_description desc("Allowed options");
@@ -40,7 +109,18 @@ test_suite* init_unit_test_suite(int argc, char* argv[]) {
             ("opcode", "Performs opcode tests")
             ("nestest", "Peform nesTest cpu tests")
             ("ppureg", "Performs register tests for the ppu")
+            ("scheduler", "Compares the lazy ppu scheduler against the interleaved one")
+            ("render", "Compares the scanline renderer against the dot renderer, checks the ARGB frame buffer")
+            ("mapper", "Performs bank switching tests of the mappers")
+            ("controller", "Performs tests of the controller shift registers on $4016/$4017")
+            ("savestate", "Checks that running from a save state, a clone, rewinding or running ahead is the same as running on, and times them")
+            ("movie", "Checks that movie playback and seeking reproduce the recorded run, and times them")
+            ("vecnes", "Checks that a VecNES steps each nes like running it on its own, and times it against one nes")
+            ("lockstep", "Checks that the lockstep cpu runs every lane like a cpu of its own, and times it against them")
+            ("footprint", "Checks that every nes of a rom shares one rom image, and reports the bytes each nes holds")
+            ("thread", "Performs tests of the emulation thread, its lock free queue and triple buffer, and the frame pacer")
             ("all,a", "Performs all tests")
+            ("bench", "Also checks the timing targets of the timed tests, only meant for a quiet host")
     ;
 
     po::variables_map vm;
@@ -58,10 +138,22 @@ test_suite* init_unit_test_suite(int argc, char* argv[]) {
         return nullptr;
     }
 
+    benchTargets = vm.count("bench") != 0;
+
     if (vm.count("all") || vm.count("a")) {
         framework::master_test_suite().add(createOpcodeTestSuite());
         framework::master_test_suite().add(createCpuDiagTestSuite());
         framework::master_test_suite().add(createPpuTestSuite());
+        framework::master_test_suite().add(createSchedulerTestSuite());
+        framework::master_test_suite().add(createRenderTestSuite());
+        framework::master_test_suite().add(createMapperTestSuite());
+        framework::master_test_suite().add(createControllerTestSuite());
+        framework::master_test_suite().add(createSaveStateTestSuite());
+        framework::master_test_suite().add(createMovieTestSuite());
+        framework::master_test_suite().add(createVecNESTestSuite());
+        framework::master_test_suite().add(createLockstepTestSuite());
+        framework::master_test_suite().add(createFootprintTestSuite());
+        framework::master_test_suite().add(createThreadTestSuite());
         return nullptr;
     }
 
@@ -76,6 +168,36 @@ test_suite* init_unit_test_suite(int argc, char* argv[]) {
     if (vm.count("ppureg")) {
         framework::master_test_suite().add(createPpuTestSuite());
     }
+    if (vm.count("scheduler")) {
+        framework::master_test_suite().add(createSchedulerTestSuite());
+    }
+    if (vm.count("render")) {
+        framework::master_test_suite().add(createRenderTestSuite());
+    }
+    if (vm.count("mapper")) {
+        framework::master_test_suite().add(createMapperTestSuite());
+    }
+    if (vm.count("controller")) {
+        framework::master_test_suite().add(createControllerTestSuite());
+    }
+    if (vm.count("savestate")) {
+        framework::master_test_suite().add(createSaveStateTestSuite());
+    }
+    if (vm.count("movie")) {
+        framework::master_test_suite().add(createMovieTestSuite());
+    }
+    if (vm.count("vecnes")) {
+        framework::master_test_suite().add(createVecNESTestSuite());
+    }
+    if (vm.count("lockstep")) {
+        framework::master_test_suite().add(createLockstepTestSuite());
+    }
+    if (vm.count("footprint")) {
+        framework::master_test_suite().add(createFootprintTestSuite());
+    }
+    if (vm.count("thread")) {
+        framework::master_test_suite().add(createThreadTestSuite());
+    }
 
     return nullptr;
 }
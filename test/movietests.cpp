@@ -0,0 +1,138 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Movie.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+template<typename F>
+static bool throws(F f) {
+    try {
+        f();
+    }
+    catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Start held for a few frames then buttons that change every few frames, the same every run
+static uint8_t scriptedButtons(const uint64_t& frame, const uint8_t& player) {
+    if (player == 0 && frame >= 40 && frame < 46)
+        return Controller::START;
+    const uint64_t hash = ((frame / 7) * 0x9E3779B97F4A7C15ull + player) >> 56;
+    return static_cast<uint8_t>(hash & ~Controller::START);
+}
+
+void Tests::movieTest() {
+    std::cout << "\n--- Running Movie Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    const uint64_t frames = 1000;
+    const unsigned interval = 100;
+
+    // Record a run, keeping the state at the start of some frames to compare playback with
+    std::shared_ptr<NES> nes = createNES(donkeyKong);
+    Movie movie(interval);
+    movie.startRecording(*nes);
+    std::map<uint64_t, std::vector<uint8_t>> expected;
+    for (uint64_t frame = 0; frame != frames; ++frame) {
+        if (frame % 37 == 0)
+            expected[frame] = nes->saveState();
+        movie.recordFrame(*nes, scriptedButtons(frame, 0), scriptedButtons(frame, 1));
+    }
+    expected[frames] = nes->saveState();
+    ckPassFail(movie.frames() == frames && movie.position() == frames, "Movie did not record every frame");
+    ckPassFail(movie.keyframes() == frames / interval, "Movie has " + std::to_string(movie.keyframes()) + " keyframes");
+
+    std::vector<uint8_t> file;
+    movie.save(file);
+    std::cout << "Movie of " << frames << " frames: " << file.size() << " bytes\n";
+    Movie loaded;
+    loaded.load(file.data(), file.size());
+    ckPassFail(loaded.frames() == frames && loaded.keyframes() == movie.keyframes(), "Loaded movie differs from the saved one");
+
+    // Playing back from power on, on a nes that ran something else before, must be the same run
+    std::shared_ptr<NES> player = createNES(donkeyKong);
+    for (int i = 0; i != 50; ++i)
+        player->runFrame();
+    loaded.seek(*player, 0);
+    bool matches = true;
+    while (loaded.position() != frames) {
+        if (expected.count(loaded.position()))
+            matches &= player->saveState() == expected[loaded.position()];
+        loaded.playFrame(*player);
+    }
+    ckPassFail(matches && player->saveState() == expected[frames], "Movie playback differs from the recorded run");
+    ckPassFail(!loaded.playFrame(*player), "Movie played past its end");
+
+    // Keyframe 0 is just power on, feeding the same input to a fresh nes without the movie matches too
+    std::shared_ptr<NES> fresh = createNES(donkeyKong);
+    for (uint64_t frame = 0; frame != frames; ++frame) {
+        fresh->controllers[0].setButtons(scriptedButtons(frame, 0));
+        fresh->controllers[1].setButtons(scriptedButtons(frame, 1));
+        fresh->runFrame();
+    }
+    ckPassFail(fresh->saveState() == expected[frames], "Movie run differs from feeding its input to a powered up nes");
+
+    // Seeking anywhere, forwards and backwards, lands on the recorded state
+    matches = true;
+    for (const uint64_t& frame : {uint64_t(999), uint64_t(37), uint64_t(0), uint64_t(370), uint64_t(1000), uint64_t(111)}) {
+        loaded.seek(*player, frame);
+        matches &= loaded.position() == frame && player->saveState() == expected[frame];
+    }
+    ckPassFail(matches, "Seeking did not land on the recorded state");
+    loaded.seek(*player, 46);
+    // Donkey Kong keeps the buttons it read at $14, start is 0x10 there
+    ckPassFail(player->cpu.memory[0x14] == 0x10, "Donkey Kong did not read the start the movie held");
+    ckPassFail(throws([&]() { loaded.seek(*player, frames + 1); }), "Seeked past the end of the movie");
+
+    // Recording after seeking back branches off, the rest of the old run is dropped
+    loaded.seek(*player, 370);
+    loaded.recordFrame(*player, 0, 0);
+    ckPassFail(loaded.frames() == 371 && loaded.keyframes() == 4, "Recording after a seek did not drop the old future");
+    loaded.seek(*player, 0);
+    while (loaded.playFrame(*player)) {}
+    std::shared_ptr<NES> branch = createNES(donkeyKong);
+    for (uint64_t frame = 0; frame != 371; ++frame) {
+        branch->controllers[0].setButtons(frame == 370 ? 0 : scriptedButtons(frame, 0));
+        branch->controllers[1].setButtons(frame == 370 ? 0 : scriptedButtons(frame, 1));
+        branch->runFrame();
+    }
+    ckPassFail(player->saveState() == branch->saveState(), "Branched movie differs from its input");
+
+    // Files
+    const std::string fname = "movietest.ynm";
+    movie.save(fname);
+    Movie fromFile;
+    fromFile.load(fname);
+    std::remove(fname.c_str());
+    fromFile.seek(*player, frames);
+    ckPassFail(player->saveState() == expected[frames], "Movie loaded from a file differs");
+    ckPassFail(throws([&]() { fromFile.load("../rsc/roms/doesnotexist.ynm"); }), "Loaded a missing movie file");
+    ckPassFail(throws([&]() { fromFile.load(file.data(), file.size() - 1); }), "Loaded a truncated movie");
+    std::vector<uint8_t> damaged = file;
+    damaged[0] = 0;
+    ckPassFail(throws([&]() { fromFile.load(damaged.data(), damaged.size()); }), "Loaded a movie without the magic");
+    damaged = file;
+    damaged[4] = Movie::VERSION + 1;
+    ckPassFail(throws([&]() { fromFile.load(damaged.data(), damaged.size()); }), "Loaded a movie of another version");
+    ckPassFail(fromFile.frames() == frames, "A failed load changed the movie");
+    ckPassFail(throws([&]() { fromFile.seek(*createNES("../rsc/tests/nestest.nes"), 0); }), "Seeked a movie on another rom");
+
+    // Uncapped playback speed, and a seek to the end only runs what's after the last keyframe
+    loaded = movie;
+    loaded.seek(*player, 0);
+    auto start = std::chrono::steady_clock::now();
+    while (loaded.playFrame(*player)) {}
+    const double playTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    loaded.seek(*player, frames - 1);
+    const double seekTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Playback: " << frames / playTime * 1000 << " frames/s, seek to frame " << frames - 1 << ": " << seekTime
+              << " ms, a seek runs at most " << interval - 1 << " frames wherever it lands\n";
+    ckPassErr(seekTime < playTime / 2, "Seeking to the end took over half as long as playing the whole movie");
+}
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <sstream>
 #include <tuple>
+#include <algorithm>
 // 0->PC, 1->A, 2->X, 3->Y, 4->P, 5->SP, 6->Instruction Description
 using TupleState = std::tuple<uint16_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, std::string>;
 
@@ -58,6 +59,12 @@ TupleState getTestState(const std::string& line) {
     return tState;
 }
 
+// Cycle count of the line, given after CYC:
+uint64_t getTestCycle(const std::string& line) {
+    std::size_t pos = line.find("CYC:");
+    return std::stoull(line.substr(pos + 4));
+}
+
 inline bool currentTestsPass() {
     using namespace boost::unit_test;
     test_case::id_t id = framework::current_test_case().p_id;
@@ -65,26 +72,25 @@ inline bool currentTestsPass() {
     return res.passed();
 }
 
-void Tests::nesCpuTest() {
-
-    std::cout << "\n--- Running CPU Diagnostics, Nestest ---\n";
+// Runs nestest through either the compile time dispatcher or the opcode table
+void Tests::runNesTest(const bool& useOpcodeTable) {
 
     std::shared_ptr<NES> nes = std::make_shared<NES>();
     nes->init();
 
     Cpu6502& cpu = nes->cpu;
-    Memory& memory = nes->cpu.memory;
-    GamePak::load(memory, "../rsc/tests/nestest.nes");
+    nes->load("../rsc/tests/nestest.nes");
 
     std::ifstream ifsLog("../rsc/tests/nestest.log", std::ios_base::in);
     ckPassFail(ifsLog.good(), "Could not open log file to compare testsing");
 
     cpu.cpuAllowDec = false;
-    cpu.memory = memory;
+    cpu.useOpcodeTable = useOpcodeTable;
     cpu.pc = 0xC000;
     cpu.sp = 0xFD;
     cpu.a = cpu.x = cpu.y = 0;
     cpu.status.reset();
+    cpu.cycleCount = 7; // the log starts after the reset sequence
 
     std::string cycleResults;
     for (int i = 1; std::getline(ifsLog, cycleResults); ++i) {
@@ -98,6 +104,7 @@ void Tests::nesCpuTest() {
         ckPassErr(Statep == p, "(" + std::to_string(i) + ") Status failure detected at " + instrDesc);
         ckPassErr(cpu.sp == sp, "(" + std::to_string(i) +  ") Stack pointer failure detected at " + instrDesc);
         ckPassErr(cpu.pc == pc, "(" + std::to_string(i) + ") Program Counter failure detected at " + instrDesc);
+        ckPassErr(cpu.cycleCount == getTestCycle(cycleResults), "(" + std::to_string(i) + ") Cycle count failure detected at " + instrDesc);
         ckPassErr(cpu.memory.read(0x02) == 0 && cpu.memory.read(0x03) == 0, " CPU NesTest has triggered an error at " + instrDesc);
 
         if (!currentTestsPass()) {
@@ -112,3 +119,34 @@ void Tests::nesCpuTest() {
     }
 
 }
+
+void Tests::nesCpuTest() {
+    std::cout << "\n--- Running CPU Diagnostics, Nestest ---\n";
+    runNesTest(false);
+}
+
+void Tests::nesCpuTableTest() {
+    std::cout << "\n--- Running CPU Diagnostics through the opcode table, Nestest ---\n";
+    runNesTest(true);
+}
+
+// Frames must take the NTSC amount of cpu cycles, ~29780 cycles for 89341 ppu cycles
+void Tests::nesTimingTest() {
+    std::shared_ptr<NES> nes = createNES("../rsc/roms/Donkey Kong (World) (Rev A).nes");
+
+    nes->runFrame(); // align to the start of a frame
+    for (int frame = 0; frame != 60; ++frame) {
+        uint64_t start = nes->cpu.cycleCount;
+        nes->runFrame();
+        uint64_t cycles = nes->cpu.cycleCount - start;
+        ckPassErr(cycles > 29760 && cycles < 29800, "Frame took " + std::to_string(cycles) + " cpu cycles");
+        ckPassErr(nes->ppuCycleCount == nes->cpu.cycleCount * 3, "Ppu is not 3 cycles per cpu cycle");
+    }
+    // By now the title screen is drawn, a blank screen means the game never ran
+    const auto& row = nes->screen[40];
+    ckPassErr(std::any_of(row.cbegin(), row.cend(), [&row](const uint8_t& c) { return c != row[0]; }), "Title screen was not drawn");
+
+    uint64_t start = nes->cpu.cycleCount;
+    nes->runCycles(1000);
+    ckPassErr(nes->cpu.cycleCount - start >= 1000, "runCycles ran less cycles than requested");
+}
@@ -88,12 +88,12 @@ void Tests::ppuRegisterTests() {
     cpu.memory[8] = 0x20;
     cpu.runCycle();
 
-    ckPassErr(ppu.memory[0x2108] == 0xFD, "Data 0x2007 ppu register failure");
+    ckPassErr(ppu.vRamRead(0x2108) == 0xFD, "Data 0x2007 ppu register failure");
 
     nes->clear();
 
     // Check write to 0x4014
-    std::fill(cpu.memory.memory.begin() + 0x8000, cpu.memory.memory.begin() + 0x80FF, 0x50);
+    std::fill(&cpu.memory[0x8000], &cpu.memory[0x8000] + 0x100, 0x50); // the whole page
     cpu.a = 0x80;
     cpu.memory[0] = 0x8D; // STA ABS
     cpu.memory[1] = 0x14;
@@ -103,5 +103,15 @@ void Tests::ppuRegisterTests() {
         return val != 0x50;
      });
     ckPassErr(it == ppu.OAM.cend(), "OAM DMA failure");
+    ckPassErr(cpu.cycleCount == 4 + 513, "OAM DMA after an even length store took an alignment cycle");
+
+    // The alignment cycle depends on the cycle the write ended on, not the one its instruction started on
+    nes->clear();
+    cpu.x = 0x14;
+    cpu.memory[0] = 0x9D; // STA ABSX, 5 cycles
+    cpu.memory[1] = 0x00;
+    cpu.memory[2] = 0x40;
+    cpu.runCycle();
+    ckPassErr(cpu.cycleCount == 5 + 514, "OAM DMA after an odd length store is not aligned");
 
 }
@@ -0,0 +1,75 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Cpu6502.h"
+#include "Ppu.h"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Milliseconds taken per frame by running the given amount of frames
+static double timeFrames(std::shared_ptr<NES> nes, const int& frames) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i != frames; ++i)
+        nes->runFrame();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+// The scanline renderer must draw the exact same frames as the dot renderer
+void Tests::scanlineRendererTest() {
+    std::cout << "\n--- Running Scanline Renderer Tests ---\n";
+    NESOptions dotRenderer;
+    dotRenderer.scanlineRenderer = false;
+    for (const char* fname : {"../rsc/roms/Donkey Kong (World) (Rev A).nes", "../rsc/tests/nestest.nes"}) {
+        std::shared_ptr<NES> scanline = createNES(fname), dot = createNES(fname, dotRenderer);
+        for (int frame = 0; frame != 200; ++frame) {
+            scanline->runFrame();
+            dot->runFrame();
+            const std::string at = " at frame " + std::to_string(frame) + " of " + std::string(fname);
+            ckPassFail(scanline->screen == dot->screen, "Screen differs" + at);
+            ckPassFail(scanline->cpu.cycleCount == dot->cpu.cycleCount && scanline->cpu.pc == dot->cpu.pc, "Cpu differs" + at);
+            ckPassFail(scanline->ppu.vAdr == dot->ppu.vAdr && scanline->ppu.bkShift == dot->ppu.bkShift
+                       && scanline->ppu.attrShiftHigh == dot->ppu.attrShiftHigh, "Ppu differs" + at);
+        }
+        double scanlineTime = timeFrames(scanline, 300), dotTime = timeFrames(dot, 300);
+        std::cout << fname << "\nDot renderer: " << dotTime << " ms/frame, scanline renderer: " << scanlineTime << " ms/frame\n";
+    }
+}
+
+// The frame buffer must hold the ARGB colour of every chroma in screen, and leave the row padding alone
+void Tests::frameBufferTest() {
+    std::cout << "\n--- Running Frame Buffer Tests ---\n";
+    const size_t pitch = 300; // in pixels
+    const uint32_t padding = 0xDEADBEEF;
+    for (const bool scanlineRenderer : {true, false}) {
+        NESOptions options;
+        options.scanlineRenderer = scanlineRenderer;
+        std::shared_ptr<NES> nes = createNES("../rsc/roms/Donkey Kong (World) (Rev A).nes", options);
+        std::vector<uint32_t> buffer(pitch * 240, padding);
+        nes->setFrameBuffer(buffer.data(), pitch * sizeof(uint32_t));
+        runFrames(*nes, 100);
+        bool matches = true, paddingKept = true;
+        for (size_t y = 0; y != 240; ++y) {
+            for (size_t x = 0; x != 256; ++x)
+                matches &= buffer[y * pitch + x] == Ppu::ARGBPaletteTable[nes->screen[y][x] & 0x3F];
+            for (size_t x = 256; x != pitch; ++x)
+                paddingKept &= buffer[y * pitch + x] == padding;
+        }
+        const std::string renderer = scanlineRenderer ? " with the scanline renderer" : " with the dot renderer";
+        ckPassFail(matches, "Frame buffer does not match the screen" + renderer);
+        ckPassFail(paddingKept, "Frame buffer wrote past the end of a row" + renderer);
+    }
+    ckPassFail(Ppu::ARGBPaletteTable[0x20] == 0xFFECEEEC, "Chroma 0x20 is not 236,238,236 in ARGB");
+    bool thrown = false;
+    try {
+        std::shared_ptr<NES> nes = std::make_shared<NES>();
+        uint32_t small[255];
+        nes->setFrameBuffer(small, sizeof(small));
+    }
+    catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ckPassFail(thrown, "Frame buffer with a pitch under 256 pixels was accepted");
+}
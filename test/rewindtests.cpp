@@ -0,0 +1,85 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Rewind.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+void Tests::rewindTest() {
+    std::cout << "\n--- Running Rewind Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    {   // Deltas must turn one buffer back into the other, whatever the mix of equal and different bytes
+        std::mt19937 random(1);
+        for (const int changes : {0, 1, 5, 50, 500, 5000}) {
+            std::vector<uint8_t> from(5000), to, delta;
+            for (uint8_t& byte : from)
+                byte = static_cast<uint8_t>(random());
+            to = from;
+            for (int i = 0; i != changes; ++i)
+                to[random() % to.size()] ^= static_cast<uint8_t>(random() | 1);
+            Rewind::encodeDelta(from, to, delta);
+            std::vector<uint8_t> applied = to;
+            Rewind::applyDelta(delta, applied);
+            ckPassFail(applied == from, "Delta with " + std::to_string(changes) + " changes did not restore the buffer");
+        }
+    }
+    {   // Rewinding must bring back the exact state of each earlier frame, newest first
+        std::shared_ptr<NES> nes = createNES(donkeyKong);
+        Rewind rewind;
+        std::vector<std::vector<uint8_t>> states;
+        for (int frame = 0; frame != 600; ++frame) {
+            nes->runFrame();
+            rewind.frameDone(*nes);
+            states.push_back(nes->saveState());
+        }
+        const Rewind::Stats stats = rewind.stats();
+        std::cout << "600 frames: " << stats.bytes << " bytes, " << stats.rawBytes << " raw, ratio " << stats.ratio
+                  << ", a 64MB budget holds " << 64.0 * 1024 * 1024 / stats.bytes * stats.seconds / 60 << " minutes\n";
+        ckPassFail(stats.snapshots == 600, "Rewind did not keep every frame");
+        for (int frame = 599; frame != 540; --frame) {
+            ckPassFail(rewind.rewind(*nes), "Rewind ran out of snapshots early");
+            ckPassFail(nes->saveState() == states[frame], "Rewound state differs at frame " + std::to_string(frame));
+        }
+        // Playing on from frame 541 must record frame 542 again
+        nes->runFrame();
+        rewind.frameDone(*nes);
+        ckPassFail(rewind.rewind(*nes) && nes->saveState() == states[542], "Frame recorded after rewinding is wrong");
+        ckPassFail(rewind.rewind(*nes) && nes->saveState() == states[540], "Snapshot before rewinding was lost");
+    }
+    {   // The budget drops the oldest snapshots, every 4 frames keeps 4x the time
+        std::shared_ptr<NES> nes = createNES(donkeyKong);
+        const size_t budget = 64 * 1024;
+        Rewind rewind(budget, 4);
+        for (int frame = 0; frame != 2000; ++frame) {
+            nes->runFrame();
+            rewind.frameDone(*nes);
+        }
+        const Rewind::Stats stats = rewind.stats();
+        ckPassFail(stats.bytes <= budget, "Rewind went over its budget");
+        ckPassFail(stats.snapshots > 1 && stats.snapshots < 500, "Rewind did not drop the oldest snapshots");
+        int count = 0;
+        while (rewind.rewind(*nes))
+            ++count;
+        ckPassFail(count == static_cast<int>(stats.snapshots) && rewind.stats().bytes == 0, "Rewind lost snapshots");
+    }
+    {   // Per frame snapshots must stay under 2% of the frame time, both are timed in the same run
+        // but short stalls still skew it, so the default run allows 5%
+        std::shared_ptr<NES> nes = createNES(donkeyKong);
+        Rewind rewind;
+        double frameTime = 0, rewindTime = 0;
+        for (int frame = 0; frame != 900; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            nes->runFrame();
+            auto ran = std::chrono::steady_clock::now();
+            rewind.frameDone(*nes);
+            frameTime += std::chrono::duration<double, std::milli>(ran - start).count();
+            rewindTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ran).count();
+        }
+        const double overhead = 100 * rewindTime / frameTime;
+        std::cout << "Frame time: " << frameTime / 900 << " ms, snapshot: " << 1000 * rewindTime / 900 << " us, overhead " << overhead << "%\n";
+        ckPassErr(overhead < 5, "Rewind snapshots take over 5% of the frame time");
+        ckBench(overhead < 2, "Rewind snapshots take over 2% of the frame time");
+    }
+}
@@ -0,0 +1,101 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "RunAhead.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using ScreenT = std::array<std::array<uint8_t, 256>, 240>;
+
+// Start is held for a few frames to get from the title screen into the game
+static uint8_t buttonsAt(const int& frame) {
+    return frame >= 60 && frame < 70 ? Controller::START : 0;
+}
+
+// Microseconds per frame
+template<typename F>
+static double timeFrames(F runFrame, const int& frames) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame != frames; ++frame)
+        runFrame();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+void Tests::runAheadTest() {
+    std::cout << "\n--- Running Run-Ahead Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    const int frames = 300;
+    // The screens of running on without run-ahead, screens[i] is drawn by frame i
+    std::vector<ScreenT> screens;
+    std::shared_ptr<NES> reference = createNES(donkeyKong);
+    for (int frame = 0; frame != frames; ++frame) {
+        reference->controllers[0].setButtons(buttonsAt(frame));
+        reference->runFrame();
+        screens.push_back(reference->screen);
+    }
+    const std::vector<uint8_t> expected = reference->saveState();
+
+    for (unsigned ahead : {1u, 2u}) {
+        // The real frames run like they do without run-ahead, the screen is the one ahead of them whenever
+        // the input held over the frames ahead was what run-ahead guessed
+        std::shared_ptr<NES> nes = createNES(donkeyKong);
+        RunAhead runAhead(ahead);
+        bool shownAhead = true;
+        int guessed = 0, changed = 0;
+        for (int frame = 0; frame != frames; ++frame) {
+            nes->controllers[0].setButtons(buttonsAt(frame));
+            runAhead.runFrame(*nes);
+            const int shown = frame + static_cast<int>(ahead);
+            if (shown >= frames || buttonsAt(shown) != buttonsAt(frame))
+                continue;
+            ++guessed;
+            shownAhead &= nes->screen == screens[shown];
+            changed += screens[shown] != screens[frame];
+        }
+        const std::string name = std::to_string(ahead) + " frame run-ahead";
+        ckPassFail(nes->saveState() == expected, "Real frames differ with " + name);
+        ckPassFail(nes->videoOutput, "Video output was left off by " + name);
+        ckPassFail(guessed > frames / 2 && shownAhead, "Screen is not the one ahead with " + name);
+        ckPassFail(changed > 0, "Screens never moved, " + name + " was not checked");
+    }
+
+    // Without video output the ppu runs the same but draws nothing
+    std::shared_ptr<NES> nes = createNES(donkeyKong), drawn = createNES(donkeyKong);
+    std::vector<uint32_t> frameBuffer(256 * 240, 0);
+    nes->setFrameBuffer(frameBuffer.data(), 256 * sizeof(uint32_t));
+    const ScreenT blank = nes->screen;
+    nes->videoOutput = false;
+    for (int frame = 0; frame != 60; ++frame) {
+        nes->runFrame();
+        drawn->runFrame();
+    }
+    ckPassFail(nes->screen == blank && std::all_of(frameBuffer.begin(), frameBuffer.end(), [](const uint32_t& p) { return p == 0; }),
+               "Pixels were drawn with video output off");
+    ckPassFail(nes->saveState() == drawn->saveState(), "Turning video output off changed how the nes runs");
+    nes->setFrameBuffer(nullptr, 0);
+
+    // Cost of a shown frame in the game, with and without running ahead, and of a frame that isn't drawn
+    std::array<double, 3> times{};
+    double hidden = 0;
+    for (unsigned ahead = 0; ahead <= times.size(); ++ahead) {
+        std::shared_ptr<NES> timedNes = createNES(donkeyKong);
+        for (int frame = 0; frame != 120; ++frame) {
+            timedNes->controllers[0].setButtons(buttonsAt(frame));
+            timedNes->runFrame();
+        }
+        if (ahead == times.size()) {
+            timedNes->videoOutput = false;
+            hidden = timeFrames([&timedNes]() { timedNes->runFrame(); }, 600);
+        }
+        else {
+            RunAhead runAhead(ahead);
+            times[ahead] = timeFrames([&timedNes, &runAhead]() { runAhead.runFrame(*timedNes); }, 600);
+        }
+    }
+    std::cout << "Frame: " << times[0] << " us, without video output: " << hidden << " us, 1 frame ahead: " << times[1]
+              << " us, 2 frames ahead: " << times[2] << " us\n";
+    ckPassErr(times[1] < times[0] * 3 && times[2] < times[0] * 4, "Running ahead costs more than the extra frames");
+}
@@ -0,0 +1,79 @@
+#include "tests.hpp"
+#include "NES.h"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// What must come out the same when running from a loaded state
+struct Snapshot {
+    std::array<std::array<uint8_t, 256>, 240> screen;
+    std::vector<uint8_t> state; // has every register and counter
+    bool operator==(const Snapshot& other) const {
+        return screen == other.screen && state == other.state;
+    }
+};
+
+static Snapshot snapshotAfter(std::shared_ptr<NES> nes, const int& frames) {
+    runFrames(*nes, frames);
+    return Snapshot{nes->screen, nes->saveState()};
+}
+
+template<typename F>
+static bool throws(F f) {
+    try {
+        f();
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void Tests::saveStateTest() {
+    std::cout << "\n--- Running Save State Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes", nestest = "../rsc/tests/nestest.nes";
+    for (const std::string& fname : {donkeyKong, nestest}) {
+        std::shared_ptr<NES> nes = createNES(fname);
+        runFrames(*nes, 100);
+        nes->runCycles(12345); // mid frame
+        const std::vector<uint8_t> state = nes->saveState();
+        const Snapshot expected = snapshotAfter(nes, 100);
+
+        nes->loadState(state);
+        ckPassFail(snapshotAfter(nes, 100) == expected, "Running from a loaded state differs in " + fname);
+        // A machine that never ran must end up the same too
+        std::shared_ptr<NES> fresh = createNES(fname);
+        fresh->loadState(state);
+        ckPassFail(snapshotAfter(fresh, 100) == expected, "Running from a state loaded into a new nes differs in " + fname);
+    }
+
+    std::shared_ptr<NES> nes = createNES(donkeyKong);
+    runFrames(*nes, 60);
+    std::vector<uint8_t> state = nes->saveState();
+    std::cout << "State size: " << state.size() << " bytes\n";
+    ckPassFail(throws([&]() { createNES(nestest)->loadState(state); }), "State of another rom was loaded");
+    ckPassFail(throws([&]() { nes->loadState(state.data(), state.size() - 1); }), "Truncated state was loaded");
+    ckPassFail(throws([&]() { nes->loadState(state.data(), 6); }), "State without its header was loaded");
+    std::vector<uint8_t> newer = state;
+    newer[4] = NES::STATE_VERSION + 1;
+    ckPassFail(throws([&]() { nes->loadState(newer); }), "State of another version was loaded");
+    ckPassFail(throws([&]() { std::make_shared<NES>()->saveState(); }), "Saved a state without a cartridge");
+    nes->loadState(state);
+
+    // Search workloads save and load thousands of times a minute
+    const int runs = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i != runs; ++i)
+        nes->saveState(state);
+    const double saveTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i != runs; ++i)
+        nes->loadState(state);
+    const double loadTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+    std::cout << "Save: " << saveTime << " us, load: " << loadTime << " us\n";
+    ckPassErr(saveTime < 1000 && loadTime < 1000, "Saving or loading a state takes over 1 ms");
+    ckBench(saveTime < 100 && loadTime < 100, "Saving or loading a state takes over 100 us");
+}
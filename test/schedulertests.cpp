@@ -0,0 +1,39 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "Cpu6502.h"
+#include "Ppu.h"
+
+#include <chrono>
+#include <memory>
+
+// Milliseconds taken per frame by running the given amount of frames
+static double timeFrames(std::shared_ptr<NES> nes, const int& frames) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i != frames; ++i)
+        nes->runFrame();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / frames;
+}
+
+// The lazy ppu must give the exact same frames and cpu state as catching up the ppu every instruction
+void Tests::schedulerTest() {
+    std::cout << "\n--- Running Scheduler Tests ---\n";
+    NESOptions interleavedPpu;
+    interleavedPpu.lazyPpu = false;
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    std::shared_ptr<NES> lazy = createNES(donkeyKong), interleaved = createNES(donkeyKong, interleavedPpu);
+
+    for (int frame = 0; frame != 200; ++frame) {
+        lazy->runFrame();
+        interleaved->runFrame();
+        const std::string at = " at frame " + std::to_string(frame);
+        ckPassFail(lazy->screen == interleaved->screen, "Screen differs" + at);
+        ckPassFail(lazy->cpu.cycleCount == interleaved->cpu.cycleCount && lazy->cpu.pc == interleaved->cpu.pc,
+                   "Cpu differs" + at);
+        ckPassFail(lazy->ppuCycleCount == interleaved->ppuCycleCount, "Ppu cycles differ" + at);
+    }
+
+    // Benchmark of both, note the screen is already compared
+    double lazyTime = timeFrames(lazy, 300), interleavedTime = timeFrames(interleaved, 300);
+    std::cout << "Interleaved ppu: " << interleavedTime << " ms/frame, lazy ppu: " << lazyTime << " ms/frame\n";
+}
@@ -7,6 +7,22 @@
 #include "GamePak.h"
 #include "NES.h"
 
+std::shared_ptr<NES> createNES(const std::string& fname, const NESOptions& options) {
+    std::shared_ptr<NES> nes = std::make_shared<NES>();
+    nes->init();
+    nes->load(fname);
+    nes->powerUp();
+    nes->lazyPpu = options.lazyPpu;
+    nes->scanlineRenderer = options.scanlineRenderer;
+    return nes;
+}
+
+void runFrames(NES& nes, const int& frames, const uint8_t& buttons) {
+    nes.controllers[0].setButtons(buttons);
+    for (int frame = 0; frame != frames; ++frame)
+        nes.runFrame();
+}
+
 void Tests::testenv() {
 
 }
@@ -1,18 +1,41 @@
 TEMPLATE = app
-CONFIG += console c++14
+CONFIG += console c++14 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
         ../src/Cpu6502.cpp \
+        ../src/Controller.cpp \
         ../src/Memory.cpp \
         ../src/GamePak.cpp \
+        ../src/Mapper.cpp \
         ../src/Ppu.cpp \
+        ../src/RomImage.cpp \
         ../src/NES.cpp \
+        ../src/EmulationThread.cpp \
+        ../src/FramePacer.cpp \
+        ../src/Rewind.cpp \
+        ../src/Movie.cpp \
+        ../src/RunAhead.cpp \
+        ../src/VecNES.cpp \
+        ../src/LockstepCpu.cpp \
         nescputests.cpp \
         optests.cpp \
         mastertestsuite.cpp \
         ppuregistertests.cpp \
+        schedulertests.cpp \
+        rendertests.cpp \
+        mappertests.cpp \
+        controllertests.cpp \
+        savestatetests.cpp \
+        rewindtests.cpp \
+        clonetests.cpp \
+        runaheadtests.cpp \
+        movietests.cpp \
+        vecnestests.cpp \
+        lockstepcputests.cpp \
+        footprinttests.cpp \
+        threadtests.cpp \
         testenv.cpp
 
 
@@ -20,10 +43,24 @@ INCLUDEPATH += ../include/
 
 HEADERS += \
     ../include/Cpu6502.hpp \
+    ../include/Controller.hpp \
     ../include/Memory.hpp \
     ../include/GamePak.hpp \
+    ../include/Mapper.hpp \
     ../include/Ppu.hpp \
+    ../include/RomImage.hpp \
     ../include/NES.hpp \
+    ../include/EmulationThread.hpp \
+    ../include/FramePacer.hpp \
+    ../include/TripleBuffer.hpp \
+    ../include/SpscQueue.hpp \
+    ../include/SaveState.hpp \
+    ../include/CowPages.hpp \
+    ../include/Rewind.hpp \
+    ../include/Movie.hpp \
+    ../include/RunAhead.hpp \
+    ../include/VecNES.hpp \
+    ../include/LockstepCpu.hpp \
     tests.hpp
 
 # Include Boost Program Options linking
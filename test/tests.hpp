@@ -1,10 +1,14 @@
 #ifndef TESTS_HPP
 #define TESTS_HPP
 
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <memory>
 #include <boost/test/unit_test.hpp>
 
+class NES;
+
 inline constexpr void ckPassFail(const bool& b, const std::string& str) {
     if (!b) {
         BOOST_FAIL(str);
@@ -17,6 +21,27 @@ inline constexpr void ckPassErr(const bool& b, const std::string& str) noexcept
     }
 }
 
+// Set by --bench, the timed tests then also check the targets their requests named
+// Those only hold on a quiet host, so without it only bounds loose enough for any host are checked
+extern bool benchTargets;
+
+inline void ckBench(const bool& b, const std::string& str) noexcept {
+    if (benchTargets && !b) {
+        BOOST_ERROR(str);
+    }
+}
+
+// How createNES sets up a nes, the defaults are the ones the emulator runs with
+struct NESOptions {
+    bool lazyPpu = true;
+    bool scanlineRenderer = true;
+};
+
+// A nes with the rom loaded and powered up, defined in testenv.cpp
+std::shared_ptr<NES> createNES(const std::string& fname, const NESOptions& options = NESOptions());
+// Runs frames with player 1 holding buttons the whole time
+void runFrames(NES& nes, const int& frames, const uint8_t& buttons = 0);
+
 struct Tests {
     // ---- Cpu Test Opcode Functions ----
     // Functions are defined in optests.cpp
@@ -31,9 +56,36 @@ struct Tests {
 
     // ---- NesTest Functions ----
     static void nesCpuTest();
+    static void nesCpuTableTest();
+    static void runNesTest(const bool& useOpcodeTable);
+    static void nesTimingTest();
 
     static void ppuRegisterTests();
 
+    static void schedulerTest();
+    static void scanlineRendererTest();
+    static void frameBufferTest();
+
+    static void mapperTest();
+
+    static void controllerTest();
+
+    static void saveStateTest();
+    static void rewindTest();
+    static void cloneTest();
+    static void runAheadTest();
+
+    static void movieTest();
+
+    static void vecNESTest();
+
+    static void lockstepCpuTest();
+
+    static void footprintTest();
+
+    static void emulationThreadTest();
+    static void framePacerTest();
+
     static void testenv();
 
 };
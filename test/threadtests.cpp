@@ -0,0 +1,231 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "EmulationThread.h"
+#include "TripleBuffer.hpp"
+#include "SpscQueue.hpp"
+#include "FramePacer.h"
+#include "Movie.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <thread>
+
+static const char* const DONKEY_KONG = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+
+// Waits up to a few seconds for the check to pass
+template<typename F>
+static bool waitFor(F check) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!check()) {
+        if (std::chrono::steady_clock::now() > end)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+
+// Values must come out in order with none lost or duplicated while both threads hammer the queue
+static void spscQueueTest() {
+    SpscQueue<uint32_t, 64> queue;
+    const uint32_t count = 500000;
+    std::thread producer([&queue, count]() {
+        for (uint32_t i = 0; i != count; ++i) {
+            while (!queue.push(i))
+                std::this_thread::yield();
+        }
+    });
+    bool inOrder = true;
+    for (uint32_t expected = 0; expected != count;) {
+        uint32_t value;
+        if (queue.pop(value)) {
+            inOrder &= value == expected;
+            ++expected;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    uint32_t value;
+    ckPassFail(inOrder, "Spsc queue values came out of order");
+    ckPassFail(!queue.pop(value), "Spsc queue is not empty after every value was popped");
+}
+
+// The reader must only ever see whole buffers, and never go back to an older one
+static void tripleBufferTest() {
+    using BufferT = std::array<uint64_t, 128>;
+    TripleBuffer<BufferT> buffer;
+    const uint64_t count = 200000;
+    std::thread writer([&buffer, count]() {
+        for (uint64_t i = 1; i <= count; ++i) {
+            buffer.writeBuffer().fill(i);
+            buffer.publish();
+        }
+    });
+    bool torn = false, backwards = false;
+    uint64_t last = 0;
+    while (last != count) {
+        if (!buffer.update()) {
+            std::this_thread::yield();
+            continue;
+        }
+        const BufferT& read = buffer.readBuffer();
+        torn |= std::any_of(read.begin(), read.end(), [&read](const uint64_t& v) { return v != read[0]; });
+        backwards |= read[0] < last;
+        last = read[0];
+    }
+    writer.join();
+    ckPassFail(!torn, "Triple buffer reader saw a buffer while it was being written");
+    ckPassFail(!backwards, "Triple buffer reader went back to an older buffer");
+    ckPassFail(!buffer.update(), "Triple buffer had a new buffer after the last one was read");
+}
+
+// Frames published by the thread must be exactly what the nes draws when run directly
+static void emulationThreadFrameTest() {
+    EmulationThread emulator(std::make_shared<NES>(), false, false);
+    EmulationThread::Command load;
+    load.type = EmulationThread::Command::LOAD;
+    load.fname = DONKEY_KONG;
+    emulator.setVideoMemoryCopies(true);
+    ckPassFail(emulator.send(load), "Load command was not queued");
+    ckPassFail(waitFor([&emulator]() { return emulator.newFrame() && emulator.frame().number >= 60; }),
+               "Emulation thread never got to frame 60");
+    const EmulationThread::Frame frame = emulator.frame();
+
+    std::shared_ptr<NES> nes = createNES(DONKEY_KONG);
+    while (nes->ppu.frameCount != frame.number)
+        nes->runFrame();
+    bool matches = true;
+    for (size_t y = 0; y != 240; ++y)
+        for (size_t x = 0; x != 256; ++x)
+            matches &= frame.pixels[y * 256 + x] == Ppu::ARGBPaletteTable[nes->screen[y][x] & 0x3F];
+    ckPassFail(matches, "Frame " + std::to_string(frame.number) + " from the emulation thread differs from running the nes directly");
+
+    // So does the copy of vram the viewers draw from
+    Ppu::VideoMemory video;
+    nes->ppu.copyVideoMemory(video);
+    ckPassFail(frame.hasVideoMemory && frame.videoMemory.vram == video.vram, "Vram copied with the frame differs from running the nes directly");
+    bool decodes = true;
+    for (uint16_t tile = 0; tile != 0x2000; tile += 16)
+        decodes &= frame.videoMemory.getPatternTile(tile) == nes->ppu.getPatternTile(tile);
+    // Unaligned tiles are not in the cache
+    for (uint16_t adr = 3; adr < 0x1FF0; adr += 16)
+        decodes &= frame.videoMemory.getPatternTile(adr) == nes->ppu.getPatternTile(adr);
+    for (uint16_t rel = 0; rel != 0x3C0; ++rel)
+        decodes &= frame.videoMemory.getPaletteFromNameTable(rel, 0x23C0) == nes->ppu.getPaletteFromNameTable(rel, 0x23C0);
+    for (const uint16_t adr : {0x3F00, 0x3F01, 0x3F05, 0x3F09, 0x3F0D})
+        decodes &= frame.videoMemory.getColorSetFromAdr(adr) == nes->ppu.getColorSetFromAdr(adr);
+    ckPassFail(decodes, "Vram copied with the frame decodes differently from the ppu");
+
+    // Once paused and the frames in flight are picked up, no more may come
+    EmulationThread::Command command;
+    command.type = EmulationThread::Command::PAUSE;
+    emulator.send(command);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    emulator.newFrame();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ckPassFail(!emulator.newFrame(), "Emulation thread made frames while paused");
+    command.type = EmulationThread::Command::RESUME;
+    emulator.send(command);
+    ckPassFail(waitFor([&emulator]() { return emulator.newFrame(); }), "Emulation thread did not resume");
+
+    // Rewinding goes back through the frames it recorded, then carries on forward once stopped
+    const uint64_t beforeRewind = emulator.frame().number;
+    command.type = EmulationThread::Command::REWIND_START;
+    emulator.send(command);
+    ckPassFail(waitFor([&emulator, beforeRewind]() { return emulator.newFrame() && emulator.frame().number + 30 < beforeRewind; }),
+               "Emulation thread did not rewind");
+    command.type = EmulationThread::Command::REWIND_STOP;
+    emulator.send(command);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    emulator.newFrame();
+    const uint64_t afterRewind = emulator.frame().number;
+    ckPassFail(waitFor([&emulator, afterRewind]() { return emulator.newFrame() && emulator.frame().number > afterRewind + 10; }),
+               "Emulation thread did not run forward after rewinding");
+
+    // A movie recorded on the thread has the keys held, and plays back on it from power on
+    const std::string movieFile = "threadtest.ynm";
+    emulator.setButtons(0, Controller::START);
+    command.type = EmulationThread::Command::RECORD_MOVIE;
+    command.fname = movieFile;
+    emulator.send(command);
+    const uint64_t recordStart = emulator.frame().number;
+    ckPassFail(waitFor([&emulator, recordStart]() { return emulator.newFrame() && emulator.frame().number >= recordStart + 100; }),
+               "Movie recording did not run");
+    command.type = EmulationThread::Command::STOP_MOVIE;
+    emulator.send(command);
+    Movie movie;
+    ckPassFail(waitFor([&movie, &movieFile]() {
+        try {
+            movie.load(movieFile);
+            return true;
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }), "Movie recording was not saved");
+    movie.seek(*nes, movie.frames());
+    ckPassFail(movie.frames() >= 60 && nes->cpu.memory[0x14] == 0x10, "Movie recording does not have the start held");
+
+    // Playback goes back to the frame the recording started at, and runs on past the end
+    emulator.setButtons(0, 0);
+    emulator.newFrame();
+    const uint64_t playStart = emulator.frame().number;
+    command.type = EmulationThread::Command::PLAY_MOVIE;
+    emulator.send(command);
+    ckPassFail(waitFor([&emulator, playStart, &movie]() { return emulator.newFrame() && emulator.frame().number + movie.frames() / 2 < playStart; }),
+               "Movie playback did not start from the start of the recording");
+    ckPassFail(waitFor([&emulator, playStart]() { return emulator.newFrame() && emulator.frame().number > playStart + 10; }),
+               "Emulation thread did not carry on after the movie ended");
+    std::remove(movieFile.c_str());
+
+    // Failed loads come back as errors
+    load.fname = "../rsc/roms/doesnotexist.nes";
+    emulator.send(load);
+    std::string message;
+    ckPassFail(waitFor([&emulator, &message]() { return emulator.popError(message); }), "Failed load did not report an error");
+}
+
+void Tests::emulationThreadTest() {
+    std::cout << "\n--- Running Emulation Thread Tests ---\n";
+    spscQueueTest();
+    tripleBufferTest();
+    emulationThreadFrameTest();
+}
+
+// Frames must average the period, and waiting must mostly be sleeping instead of spinning
+// A stall of the host longer than a frame restarts the count, so without --bench a few frames of slack are allowed
+void Tests::framePacerTest() {
+    std::cout << "\n--- Running Frame Pacer Tests ---\n";
+    FramePacer pacer(120.0);
+    const double period = pacer.period();
+    const auto wallStart = std::chrono::steady_clock::now();
+    const std::clock_t cpuStart = std::clock();
+    for (int i = 0; i != 120; ++i)
+        pacer.wait();
+    const double cpu = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    const double wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    const FramePacer::Stats& stats = pacer.stats();
+    std::cout << "Period " << period << " ms, mean " << stats.mean << " ms, p99 " << stats.p99 << " ms, max jitter "
+              << stats.maxJitter << " ms, cpu " << cpu << " ms of " << wall << " ms\n";
+    ckPassFail(stats.frames == 120, "Frame pacer stats are not from every frame");
+    ckPassFail(stats.mean > period * 0.99 && stats.mean < period * 1.05, "Frame pacer mean frame time is off the period");
+    ckPassFail(wall > 119 * period && wall < 125 * period, "Frame pacer drifted from its deadlines");
+    ckBench(std::abs(stats.mean - period) < period * 0.01, "Frame pacer mean frame time is over 1% off the period");
+    ckBench(std::abs(wall - 120 * period) < period, "Frame pacer drifted over a frame from its deadlines");
+    ckPassFail(cpu < wall / 2, "Frame pacer spun instead of sleeping");
+
+    // A stall must not be followed by a burst of frames to catch up
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    pacer.wait();
+    const auto afterStall = std::chrono::steady_clock::now();
+    pacer.wait();
+    pacer.wait();
+    const double twoFrames = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - afterStall).count();
+    ckPassFail(twoFrames > period * 1.9, "Frame pacer ran a burst of frames after a stall");
+}
@@ -0,0 +1,113 @@
+#include "tests.hpp"
+#include "NES.h"
+#include "VecNES.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Every nes gets different input, start on the title screen and then moving around
+static uint8_t actionAt(const size_t& index, const int& frame) {
+    if (frame >= 60 && frame < 70)
+        return index % 2 ? Controller::START : 0;
+    return static_cast<uint8_t>(((frame / 16 + index) % 4 == 0 ? Controller::LEFT : 0) | (static_cast<size_t>(frame) % 7 == index % 7 ? Controller::A : 0));
+}
+
+static bool observes(const VecNES& vec, const size_t& index, const NES& nes) {
+    std::array<uint8_t, Memory::RAM_SIZE> ram;
+    nes.cpu.memory.copyRam(ram.data());
+    return std::memcmp(vec.screens() + index * VecNES::SCREEN_SIZE, nes.screen[0].data(), VecNES::SCREEN_SIZE) == 0 &&
+           std::memcmp(vec.ram() + index * Memory::RAM_SIZE, ram.data(), ram.size()) == 0;
+}
+
+void Tests::vecNESTest() {
+    std::cout << "\n--- Running VecNES Tests ---\n";
+    const std::string donkeyKong = "../rsc/roms/Donkey Kong (World) (Rev A).nes";
+    // Every nes of the batch runs exactly like a nes of its own, whichever thread ran it
+    const size_t count = 6;
+    VecNES vec(donkeyKong, count, VecNES::SCREEN | VecNES::RAM, 3);
+    std::vector<std::shared_ptr<NES>> references;
+    for (size_t index = 0; index != count; ++index)
+        references.push_back(createNES(donkeyKong));
+    const uint8_t* screens = vec.screens();
+    const uint8_t* ram = vec.ram();
+    std::vector<uint8_t> actions(count);
+    bool same = true;
+    for (int frame = 0; frame != 150; ++frame) {
+        for (size_t index = 0; index != count; ++index) {
+            actions[index] = actionAt(index, frame);
+            references[index]->controllers[0].setButtons(actions[index]);
+            references[index]->runFrame();
+        }
+        vec.step(actions);
+        for (size_t index = 0; index != count; ++index)
+            same &= observes(vec, index, *references[index]);
+    }
+    ckPassFail(same, "VecNES observations differ from running each nes on its own");
+    ckPassFail(vec.screens() == screens && vec.ram() == ram, "VecNES observation buffers moved");
+    for (size_t index = 0; index != count; ++index)
+        ckPassFail(vec[index].saveState() == references[index]->saveState(), "VecNES nes " + std::to_string(index) + " state differs");
+    ckPassFail(std::memcmp(ram, ram + Memory::RAM_SIZE, Memory::RAM_SIZE) != 0, "Nes given different input have the same ram");
+
+    // A reset nes runs like one that was just powered up, and the others carry on untouched
+    vec.reset(1);
+    std::shared_ptr<NES> fresh = createNES(donkeyKong);
+    ckPassFail(observes(vec, 1, *fresh), "Reset observation is not the power on one");
+    for (int frame = 0; frame != 100; ++frame) {
+        for (size_t index = 0; index != count; ++index) {
+            actions[index] = actionAt(index, frame + (index == 1 ? 0 : 150));
+            if (index != 1)
+                references[index]->controllers[0].setButtons(actions[index]);
+        }
+        fresh->controllers[0].setButtons(actions[1]);
+        fresh->runFrame();
+        for (size_t index = 0; index != count; ++index)
+            if (index != 1)
+                references[index]->runFrame();
+        vec.step(actions);
+    }
+    ckPassFail(vec[1].saveState() == fresh->saveState() && observes(vec, 1, *fresh), "Reset nes runs differently from a powered up one");
+    ckPassFail(observes(vec, 0, *references[0]) && observes(vec, 5, *references[5]), "Resetting a nes changed the others");
+
+    // Only the ram observed skips drawing, the ram still matches
+    VecNES ramOnly(donkeyKong, 2, VecNES::RAM, 2);
+    std::shared_ptr<NES> drawn = createNES(donkeyKong);
+    for (int frame = 0; frame != 60; ++frame) {
+        ramOnly.step(std::vector<uint8_t>(2, actionAt(0, frame)));
+        drawn->controllers[0].setButtons(actionAt(0, frame));
+        drawn->runFrame();
+    }
+    std::array<uint8_t, Memory::RAM_SIZE> drawnRam;
+    drawn->cpu.memory.copyRam(drawnRam.data());
+    ckPassFail(ramOnly.screens() == nullptr && std::equal(drawnRam.begin(), drawnRam.end(), ramOnly.ram() + Memory::RAM_SIZE),
+               "Ram only VecNES differs");
+
+    // Frames per second of a single nes against a batch of 16 over every core
+    const int frames = 300;
+    std::shared_ptr<NES> single = createNES(donkeyKong);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame != frames; ++frame) {
+        single->controllers[0].setButtons(actionAt(0, frame));
+        single->runFrame();
+    }
+    const double singleFps = frames / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const size_t batch = 16;
+    VecNES timed(donkeyKong, batch);
+    std::vector<uint8_t> batchActions(batch);
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame != frames; ++frame) {
+        for (size_t index = 0; index != batch; ++index)
+            batchActions[index] = actionAt(index, frame);
+        timed.step(batchActions);
+    }
+    const double batchFps = frames * batch / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Single nes: " << singleFps << " frames/s, " << batch << " nes on " << timed.threads() << " threads ("
+              << cores << " cores): " << batchFps << " frames/s, " << batchFps / singleFps << "x\n";
+    // Even on one core the pool must not make the batch slower than running each nes in turn
+    ckPassErr(batchFps > singleFps * 0.8, "VecNES runs under 0.8x of one nes");
+    ckBench(batchFps > singleFps * 0.5 * std::min<unsigned>(cores, batch), "VecNES scales under half of the cores");
+}